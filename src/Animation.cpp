@@ -0,0 +1,98 @@
+#include "Animation.h"
+#include "JobSystem.h"
+#include <math.h>
+
+// tracks per job, below this a track type is stepped on the calling thread
+static const size_t ANIMATION_JOB_GRAIN = 2048;
+
+void AnimationSystem::clear() {
+	spin_node.clear(); spin_axis.clear();
+	spin_base.clear(); spin_rate.clear();
+	spin_prev.clear(); spin_cur.clear();
+
+	path_node.clear(); path_base.clear();
+	path_start_offset.clear(); path_phase.clear(); path_speed.clear(); path_loop_height.clear();
+	path_prev.clear(); path_cur.clear();
+}
+
+void AnimationSystem::addSpin(int node, int axis, float base_angle, float rate) {
+	spin_node.push_back(node);
+	spin_axis.push_back(axis);
+	spin_base.push_back(base_angle);
+	spin_rate.push_back(rate);
+	spin_prev.push_back(base_angle);
+	spin_cur.push_back(base_angle);
+}
+
+void AnimationSystem::addFallingPath(int node, glm::vec3 base, int slot, int slot_count, float speed, float loop_height) {
+	path_node.push_back(node);
+	path_base.push_back(base);
+	path_start_offset.push_back(slot * (loop_height / speed / slot_count));	// total time per object
+	path_phase.push_back((float)slot);
+	path_speed.push_back(speed);
+	path_loop_height.push_back(loop_height);
+	path_prev.push_back(base);
+	path_cur.push_back(base);
+}
+
+void AnimationSystem::step(double sim_time, JobSystem* jobs) {
+	if (!jobs) {
+		stepSpins(sim_time, 0, spin_node.size());
+		stepPaths(sim_time, 0, path_node.size());
+		return;
+	}
+
+	// tracks are independent of each other, each range only touches its own slots
+	jobs->parallelFor(spin_node.size(), ANIMATION_JOB_GRAIN, [this, sim_time](size_t begin, size_t end) {
+		stepSpins(sim_time, begin, end);
+	});
+	jobs->parallelFor(path_node.size(), ANIMATION_JOB_GRAIN, [this, sim_time](size_t begin, size_t end) {
+		stepPaths(sim_time, begin, end);
+	});
+}
+
+void AnimationSystem::stepSpins(double sim_time, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		spin_prev[i] = spin_cur[i];
+		spin_cur[i] = spin_base[i] + (float)(spin_rate[i] * sim_time);
+	}
+}
+
+void AnimationSystem::stepPaths(double sim_time, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		float speed = path_speed[i];
+		float loop_height = path_loop_height[i];
+		float total_loop_time = loop_height / speed;
+
+		// current relative position
+		float elapsed_time = (float)fmod(sim_time - path_start_offset[i] + total_loop_time, (double)total_loop_time);
+		if (elapsed_time < 0) elapsed_time += total_loop_time; // no negative time
+
+		// downward motion
+		float y_offset = loop_height - fmodf(elapsed_time * speed, loop_height);
+
+		// horizontal zigzag motion
+		float x_offset = sinf(elapsed_time * speed / loop_height + path_phase[i]) * 2.0f;
+		float z_offset = cosf(elapsed_time * speed / loop_height + path_phase[i]) * 1.0f;
+
+		path_prev[i] = path_cur[i];
+		path_cur[i] = path_base[i] + glm::vec3(x_offset, y_offset, z_offset);
+	}
+}
+
+void AnimationSystem::apply(SceneGraph& graph, float alpha) {
+	for (size_t i = 0; i < spin_node.size(); i++) {
+		graph.editLocal(spin_node[i]).rotation[spin_axis[i]] = spin_prev[i] + (spin_cur[i] - spin_prev[i]) * alpha;
+	}
+
+	for (size_t i = 0; i < path_node.size(); i++) {
+		glm::vec3 prev = path_prev[i];
+		glm::vec3 cur = path_cur[i];
+
+		// wrapped from the bottom of the loop back to the top this step, don't blend across the jump
+		if (cur.y - prev.y > path_loop_height[i] * 0.5f)
+			prev = cur;
+
+		graph.editLocal(path_node[i]).translation = prev + (cur - prev) * alpha;
+	}
+}
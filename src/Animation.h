@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "SceneGraph.h"
+
+class JobSystem;
+
+// simulation rate, independent of how fast frames are drawn
+const float SIM_TIMESTEP = 1.0f / 60.0f;
+
+// ------------------------------------------------------------------------------------------
+// Declarative animation tracks evaluated in bulk at a fixed timestep.
+// Each track type keeps its parameters and its previous/current values in parallel arrays;
+// step() evaluates every track at the new simulation time, apply() writes values blended
+// between the last two steps into the scene graph so motion stays smooth at any frame rate.
+// ------------------------------------------------------------------------------------------
+class AnimationSystem {
+public:
+	void clear();
+
+	// rotation component `axis` (0 = x, 1 = y, 2 = z) = base_angle + rate * t, rate in radians per second
+	void addSpin(int node, int axis, float base_angle, float rate);
+
+	// the falling zigzag path: object `slot` of `slot_count` evenly spaced along a loop of
+	// `loop_height` travelled at `speed` units per second, offset from `base`
+	void addFallingPath(int node, glm::vec3 base, int slot, int slot_count, float speed, float loop_height);
+
+	// evaluate all tracks at sim_time, keeping the previous values for interpolation
+	// with jobs, large track arrays are split across worker threads
+	void step(double sim_time, JobSystem* jobs = NULL);
+
+	// alpha in [0, 1]: how far rendering is between the previous and the current step
+	void apply(SceneGraph& graph, float alpha);
+
+private:
+	void stepSpins(double sim_time, size_t begin, size_t end);
+	void stepPaths(double sim_time, size_t begin, size_t end);
+
+	// spin tracks
+	std::vector<int> spin_node;
+	std::vector<int> spin_axis;
+	std::vector<float> spin_base, spin_rate;
+	std::vector<float> spin_prev, spin_cur;
+
+	// falling path tracks
+	std::vector<int> path_node;
+	std::vector<glm::vec3> path_base;
+	std::vector<float> path_start_offset, path_phase, path_speed, path_loop_height;
+	std::vector<glm::vec3> path_prev, path_cur;
+};
@@ -0,0 +1,87 @@
+#include "AssetRegistry.h"
+#include "JobSystem.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// FNV-1a over the whole file, 0 when it can't be read
+static uint64_t hashFile(const std::string& path) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return 0;
+
+	uint64_t hash = 14695981039346656037ull;
+	unsigned char chunk[64 * 1024];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		for (size_t i = 0; i < read; i++) {
+			hash ^= chunk[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	fclose(file);
+	return hash;
+}
+
+AssetId AssetRegistry::add(const std::string& path) {
+	std::unordered_map<std::string, AssetId>::const_iterator found = ids.find(path);
+	if (found != ids.end())
+		return found->second;
+
+	AssetId id = (AssetId)entries.size();
+	entries.push_back(Entry());
+	entries.back().path = path;
+	ids[path] = id;
+	return id;
+}
+
+void AssetRegistry::refresh(std::vector<AssetId>& changed, JobSystem* jobs) {
+	// stat is cheap, do it for everything first
+	std::vector<AssetId> modified;
+	std::vector<int64_t> mtimes, sizes;
+	for (AssetId id = 0; id < entries.size(); id++) {
+		Entry& entry = entries[id];
+		struct stat info;
+		int64_t mtime = -1, size = -1;
+		if (stat(entry.path.c_str(), &info) == 0) {
+			mtime = (int64_t)info.st_mtime;
+			size = (int64_t)info.st_size;
+		}
+
+		// a file that is gone keeps its last version, one that never existed is imported once
+		// so the importer can report it
+		if (mtime == -1 && entry.generation > 0) continue;
+		if (entry.generation > 0 && mtime == entry.mtime && size == entry.size) continue;
+
+		modified.push_back(id);
+		mtimes.push_back(mtime);
+		sizes.push_back(size);
+	}
+
+	std::vector<uint64_t> hashes(modified.size());
+	std::function<void(size_t, size_t)> hash_range = [this, &modified, &hashes](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			hashes[i] = hashFile(entries[modified[i]].path);
+	};
+	if (jobs)
+		jobs->parallelFor(modified.size(), 1, hash_range);
+	else
+		hash_range(0, modified.size());
+
+	size_t first_changed = changed.size();
+	for (size_t i = 0; i < modified.size(); i++) {
+		Entry& entry = entries[modified[i]];
+		bool first = entry.generation == 0;
+		entry.mtime = mtimes[i];
+		entry.size = sizes[i];
+
+		// touched but identical: remember the new stat so it isn't hashed again
+		if (!first && hashes[i] == entry.hash) continue;
+
+		entry.hash = hashes[i];
+		entry.generation++;
+		changed.push_back(modified[i]);
+	}
+
+	if (changed.size() > first_changed)
+		registry_generation++;
+}
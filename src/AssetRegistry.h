@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+
+// index of a registered file, stable for the registry's lifetime
+typedef uint32_t AssetId;
+
+// ------------------------------------------------------------------------------------------
+// Every file the scene is built from, keyed by path. An entry remembers the modification time,
+// size and 64-bit content hash (FNV-1a) of the version last imported, and a generation that
+// goes up each time a new version is handed out, so a reload only re-imports what actually
+// changed on disk and anything derived from a file can tell whether it is stale.
+//
+// Files whose mtime and size are unchanged are not read at all; the rest are hashed and only
+// count as changed when the content differs (a save without edits, a checkout of the same
+// revision). A file that disappears keeps its last version.
+// ------------------------------------------------------------------------------------------
+class AssetRegistry {
+public:
+	// the path's entry, added on first use; nothing is read until refresh()
+	AssetId add(const std::string& path);
+
+	// checks every file and appends the ones with new content (all of them, the first time) to
+	// changed, in id order; hashing is spread over jobs when given
+	void refresh(std::vector<AssetId>& changed, JobSystem* jobs = NULL);
+
+	size_t size() const { return entries.size(); }
+	const std::string& path(AssetId id) const { return entries[id].path; }
+
+	// versions handed out for this file, 1 after the first import
+	uint32_t generation(AssetId id) const { return entries[id].generation; }
+
+	// content hash of the version last handed out, for caches derived from the file
+	uint64_t hash(AssetId id) const { return entries[id].hash; }
+
+	// refreshes that changed anything; work recorded against an older value may point at
+	// resources that have since been replaced
+	uint32_t generation() const { return registry_generation; }
+
+private:
+	struct Entry {
+		std::string path;
+		int64_t mtime = -1;			// -1: missing (or not looked at yet)
+		int64_t size = -1;
+		uint64_t hash = 0;
+		uint32_t generation = 0;
+	};
+
+	std::vector<Entry> entries;
+	std::unordered_map<std::string, AssetId> ids;
+	uint32_t registry_generation = 0;
+};
@@ -0,0 +1,42 @@
+#include "CameraLatch.h"
+
+// weight of each new frame in the average
+static const float LATENCY_SMOOTHING = 0.05f;
+
+void CameraLatch::publish(const CameraSample& sample) {
+	std::lock_guard<std::mutex> lock(mutex);
+	newest = sample;
+	published = true;
+}
+
+bool CameraLatch::latest(CameraSample& sample) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!published) return false;
+	sample = newest;
+	return true;
+}
+
+void CameraLatch::presented(double input_time, double swap_time) {
+	// the first frames can be swapped before any input was polled
+	if (input_time <= 0.0) return;
+
+	float ms = (float)((swap_time - input_time) * 1000.0);
+	std::lock_guard<std::mutex> lock(mutex);
+	average_ms = average_ms == 0.0f ? ms : average_ms + (ms - average_ms) * LATENCY_SMOOTHING;
+	if (ms > worst_ms) worst_ms = ms;
+}
+
+float CameraLatch::latency() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return average_ms;
+}
+
+float CameraLatch::worstLatency() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return worst_ms;
+}
+
+void CameraLatch::resetLatency() {
+	std::lock_guard<std::mutex> lock(mutex);
+	average_ms = worst_ms = 0.0f;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <mutex>
+
+// newest look direction and when the input behind it was read
+struct CameraSample {
+	glm::vec3 forward;		// unit length
+	double input_time;		// glfwGetTime() at the poll it was read after
+};
+
+// ------------------------------------------------------------------------------------------
+// Late latching of the camera's orientation. The main thread publishes the look direction each
+// time it polls input; the render thread takes the newest one right before it writes the frame's
+// view and starts drawing, instead of the one recorded with the frame a whole recording earlier.
+// Only the orientation is latched: the position moves with the fixed simulation steps, like
+// everything else in the recorded frame.
+//
+// Latency is measured per frame from the poll its direction came from to the return of its swap.
+// ------------------------------------------------------------------------------------------
+class CameraLatch {
+public:
+	// main thread, after polling input
+	void publish(const CameraSample& sample);
+
+	// render thread; false until something was published
+	bool latest(CameraSample& sample) const;
+
+	// render thread, after swapping a frame drawn from input polled at input_time
+	void presented(double input_time, double swap_time);
+
+	// input to swap in ms, smoothed and the worst since resetLatency(); 0 before the first frame
+	float latency() const;
+	float worstLatency() const;
+	void resetLatency();
+
+private:
+	mutable std::mutex mutex;
+	CameraSample newest = {};
+	bool published = false;
+	float average_ms = 0.0f;
+	float worst_ms = 0.0f;
+};
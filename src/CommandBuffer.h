@@ -0,0 +1,113 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+
+#include "LightGrid.h"			// PointLight, LightGrid
+#include "MeshPool.h"			// MeshRange
+#include "RenderQueue.h"		// RenderPass
+#include "TransformKernel.h"	// InstanceData
+
+// draw flags
+const uint32_t DRAW_FLAG_MULTITEXTURE = 1;	// normal, specular and night maps (earth)
+
+struct DrawMaterial {
+	glm::vec3 ambient, diffuse, specular;
+	float shininess, alpha;
+};
+
+// one mesh draw, self-contained so it can be replayed after the scene has moved on
+struct DrawCommand {
+	RenderPass pass;
+	uint32_t object_index;		// geometry
+	uint32_t pool_mesh;			// mesh pool entry drawn: the object's LOD for its size on screen
+	uint32_t first_cluster;		// visible meshlet ranges in RenderCommandBuffer::clusters,
+	uint32_t cluster_count;		// 0 = the whole pool_mesh
+	uint32_t texture_index;		// albedo texture
+	uint32_t flags;
+	DrawMaterial material;
+	InstanceData transform;
+	glm::vec4 bounds;			// world-space bounding sphere (center, radius), for gpu culling
+};
+
+// when the opaque pass lays down depth first, position only, and shades with GL_EQUAL
+enum DepthPrepassMode {
+	DEPTH_PREPASS_AUTO,		// from the measured overdraw
+	DEPTH_PREPASS_ON,
+	DEPTH_PREPASS_OFF
+};
+
+// per-frame values shared by every draw
+struct FrameConstants {
+	glm::mat4 view_matrix, projection_matrix;
+	glm::vec3 camera_pos;
+	glm::vec3 light;
+	float light_intensity;
+	glm::vec3 clear_color;
+	int viewport_width, viewport_height;	// window framebuffer size in pixels, the scene may be drawn smaller
+	bool dynamic_resolution;				// scene size follows the gpu frame time
+	int transparency_divisor;				// transparent draws and particles at 1 / this of the scene's size
+	bool weighted_transparency;				// blended in any order, weighted by depth, instead of sorted; the queue was keyed for it
+	bool deferred;							// opaque pass through the G-buffer when supported
+	bool sky_cubemap;						// skybox after the opaque pass, where nothing was drawn
+	DepthPrepassMode depth_prepass;
+	bool overdraw_view;						// opaque fragments added up instead of shaded
+	uint32_t asset_generation;				// asset_registry's when recorded, stale after a reload
+	bool late_latch;						// view turned to the newest input just before drawing
+	double input_time;						// glfwGetTime() at the poll the recorded view came from
+	glm::mat4 cluster_projection;			// light grid's and frustum culling's, wider when latching
+};
+
+// one particle, laid out as shader_particle.vert reads it from the vertex stream
+struct ParticleVertex {
+	glm::vec3 position;
+	float size;
+	glm::vec4 color;
+};
+
+// uniform block binding points, set on every program by name
+const uint32_t FRAME_DATA_BINDING = 0;
+const uint32_t DRAW_DATA_BINDING = 1;
+
+// DrawUniforms per DrawData page, DRAW_SLOTS in the shaders (16 KB minimum block size / 176 bytes, rounded down)
+const uint32_t DRAW_SLOTS_PER_BLOCK = 64;
+
+// std140 layout of the FrameData block, written once per frame
+struct FrameUniforms {
+	glm::mat4 view_matrix, projection_matrix;
+	glm::vec3 light;
+	float light_intensity;
+	glm::vec3 camera_pos;
+	float padding;
+	glm::mat4 cluster_view, cluster_projection;	// the light grid's; view_matrix may be latched after recording
+};
+
+// std140 layout of one DrawBlock in the DrawData array, written once per draw
+struct DrawUniforms {
+	InstanceData transform;		// u_model, u_normal_matrix
+	glm::vec3 ambient;
+	float shininess;
+	glm::vec3 diffuse;
+	float alpha;
+	glm::vec3 specular;
+	int32_t has_multitextures;
+	int32_t layers[4];			// texture array layers: albedo, normal, specular, night; albedo -1 = skybox
+};
+
+static_assert(sizeof(FrameUniforms) == 288, "FrameUniforms must match the std140 FrameData block");
+static_assert(sizeof(DrawUniforms) == 176, "DrawUniforms must match the std140 DrawBlock struct");
+
+// ------------------------------------------------------------------------------------------
+// Everything needed to draw one frame, recorded on the simulation side without touching the
+// graphics API. Draws are stored already sorted; the backend replays them in order.
+// ------------------------------------------------------------------------------------------
+struct RenderCommandBuffer {
+	FrameConstants frame;
+	std::vector<DrawCommand> draws;
+	std::vector<ParticleVertex> particles;	// live particles only
+	std::vector<MeshRange> clusters;		// index ranges of partly culled meshes
+	std::vector<PointLight> lights;
+	LightGrid light_grid;					// clusters of lights, rebuilt every frame
+
+	void clear() { draws.clear(); particles.clear(); clusters.clear(); lights.clear(); }
+};
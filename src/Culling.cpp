@@ -0,0 +1,167 @@
+#include "Culling.h"
+#include "JobSystem.h"
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define CULLING_USE_SSE 1
+#endif
+
+// spheres per job, below this a batch is tested on the calling thread
+static const size_t CULL_JOB_GRAIN = 4096;
+
+BoundingVolume computeBoundingVolume(const std::vector<float>& positions) {
+	BoundingVolume volume;
+	volume.box.min = glm::vec3(0.0f);
+	volume.box.max = glm::vec3(0.0f);
+	volume.sphere.center = glm::vec3(0.0f);
+	volume.sphere.radius = 0.0f;
+
+	size_t vertex_count = positions.size() / 3;
+	if (vertex_count == 0) return volume;
+
+	glm::vec3 lo(positions[0], positions[1], positions[2]);
+	glm::vec3 hi = lo;
+	for (size_t i = 1; i < vertex_count; i++) {
+		glm::vec3 p(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	volume.box.min = lo;
+	volume.box.max = hi;
+
+	// sphere around the box centre, radius from the farthest vertex rather than the box corner
+	glm::vec3 center = (lo + hi) * 0.5f;
+	float radius_sq = 0.0f;
+	for (size_t i = 0; i < vertex_count; i++) {
+		glm::vec3 d = glm::vec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]) - center;
+		float dist_sq = glm::dot(d, d);
+		if (dist_sq > radius_sq) radius_sq = dist_sq;
+	}
+	volume.sphere.center = center;
+	volume.sphere.radius = sqrtf(radius_sq);
+
+	return volume;
+}
+
+BoundingSphere transformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& model) {
+	BoundingSphere result;
+	result.center = glm::vec3(model * glm::vec4(sphere.center, 1.0f));
+
+	// largest axis scale keeps the sphere conservative under non-uniform scaling
+	float sx = glm::dot(glm::vec3(model[0]), glm::vec3(model[0]));
+	float sy = glm::dot(glm::vec3(model[1]), glm::vec3(model[1]));
+	float sz = glm::dot(glm::vec3(model[2]), glm::vec3(model[2]));
+	float max_scale_sq = sx > sy ? (sx > sz ? sx : sz) : (sy > sz ? sy : sz);
+	result.radius = sphere.radius * sqrtf(max_scale_sq);
+
+	return result;
+}
+
+// Gribb/Hartmann: each plane is the 4th row of the matrix plus or minus one of the others
+Frustum extractFrustumPlanes(const glm::mat4& m) {
+	Frustum frustum;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	frustum.planes[0] = row3 + row0;	// left
+	frustum.planes[1] = row3 - row0;	// right
+	frustum.planes[2] = row3 + row1;	// bottom
+	frustum.planes[3] = row3 - row1;	// top
+	frustum.planes[4] = row3 + row2;	// near
+	frustum.planes[5] = row3 - row2;	// far
+
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(frustum.planes[i]));
+		frustum.planes[i] = frustum.planes[i] / length;
+	}
+
+	return frustum;
+}
+
+void SphereCullBatch::clear() {
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	radius.clear();
+}
+
+void SphereCullBatch::add(const BoundingSphere& sphere) {
+	center_x.push_back(sphere.center.x);
+	center_y.push_back(sphere.center.y);
+	center_z.push_back(sphere.center.z);
+	radius.push_back(sphere.radius);
+}
+
+BoundingSphere SphereCullBatch::at(size_t i) const {
+	BoundingSphere sphere;
+	sphere.center = glm::vec3(center_x[i], center_y[i], center_z[i]);
+	sphere.radius = radius[i];
+	return sphere;
+}
+
+void SphereCullBatch::cull(const Frustum& frustum, std::vector<unsigned char>& visible, JobSystem* jobs) {
+	visible.resize(size());
+	cull(frustum, visible.data(), jobs);
+}
+
+void SphereCullBatch::cull(const Frustum& frustum, unsigned char* out, JobSystem* jobs) {
+	if (!jobs) {
+		cullRange(frustum, 0, size(), out);
+		return;
+	}
+	jobs->parallelFor(size(), CULL_JOB_GRAIN, [this, &frustum, out](size_t begin, size_t end) {
+		cullRange(frustum, begin, end, out);
+	});
+}
+
+void SphereCullBatch::cullRange(const Frustum& frustum, size_t begin, size_t end, unsigned char* visible) const {
+	size_t count = end;
+	size_t i = begin;
+
+#ifdef CULLING_USE_SSE
+	// broadcast each plane once, then test four spheres per iteration
+	__m128 plane_a[6], plane_b[6], plane_c[6], plane_d[6];
+	for (int p = 0; p < 6; p++) {
+		plane_a[p] = _mm_set1_ps(frustum.planes[p].x);
+		plane_b[p] = _mm_set1_ps(frustum.planes[p].y);
+		plane_c[p] = _mm_set1_ps(frustum.planes[p].z);
+		plane_d[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(&center_x[i]);
+		__m128 y = _mm_loadu_ps(&center_y[i]);
+		__m128 z = _mm_loadu_ps(&center_z[i]);
+		__m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+
+		// inside all planes: distance >= -radius for each of them
+		__m128 inside = _mm_cmpeq_ps(x, x);	// all lanes true
+		for (int p = 0; p < 6; p++) {
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(plane_a[p], x), _mm_mul_ps(plane_b[p], y)),
+				_mm_add_ps(_mm_mul_ps(plane_c[p], z), plane_d[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, neg_r));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		visible[i] = (mask & 1) ? 1 : 0;
+		visible[i + 1] = (mask & 2) ? 1 : 0;
+		visible[i + 2] = (mask & 4) ? 1 : 0;
+		visible[i + 3] = (mask & 8) ? 1 : 0;
+	}
+#endif
+
+	// remainder (or everything, without SSE)
+	for (; i < count; i++) {
+		unsigned char inside = 1;
+		for (int p = 0; p < 6 && inside; p++) {
+			const glm::vec4& plane = frustum.planes[p];
+			float dist = plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w;
+			if (dist < -radius[i]) inside = 0;
+		}
+		visible[i] = inside;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+class JobSystem;
+
+struct BoundingSphere {
+	glm::vec3 center;
+	float radius;
+};
+
+struct AABB {
+	glm::vec3 min, max;
+};
+
+// object-space bounds of one loaded obj, computed once at load time
+struct BoundingVolume {
+	AABB box;
+	BoundingSphere sphere;
+};
+
+// planes are (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside, normals unit length
+// order: left, right, bottom, top, near, far
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+BoundingVolume computeBoundingVolume(const std::vector<float>& positions);
+BoundingSphere transformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& model);
+Frustum extractFrustumPlanes(const glm::mat4& view_projection);
+
+// world-space spheres stored as SoA so they can be tested four at a time with SSE
+class SphereCullBatch {
+public:
+	void clear();
+	void add(const BoundingSphere& sphere);
+	size_t size() const { return center_x.size(); }
+	BoundingSphere at(size_t i) const;
+
+	// visible[i] is set to 1 if sphere i intersects the frustum, 0 if it is fully outside
+	// with jobs, large batches are split across worker threads
+	void cull(const Frustum& frustum, std::vector<unsigned char>& visible, JobSystem* jobs = NULL);
+
+	// same, into size() entries the caller provides
+	void cull(const Frustum& frustum, unsigned char* visible, JobSystem* jobs = NULL);
+
+	// spheres [begin, end) only, visible must already hold size() entries
+	void cullRange(const Frustum& frustum, size_t begin, size_t end, unsigned char* visible) const;
+
+private:
+	std::vector<float> center_x, center_y, center_z, radius;
+};
@@ -0,0 +1,216 @@
+#include "Deferred.h"
+#include "Shader.h"
+#include "Log.h"
+
+// texture units of the G-buffer while lighting, 0 and 1 belong to the scene shaders, 2 to gpu culling
+static const GLint GBUFFER_UNIT = 3;		// diffuse, normal, specular, emissive, then depth
+static const GLsizei LIGHT_VOLUME_VERTICES = 36;	// cube in deferred_light.vert
+
+static bool linked(GLuint program) {
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+// points a lighting program's samplers at the G-buffer units and its FrameData block at the shared binding
+static void bindGBufferInputs(GLuint program) {
+	static const char* const samplers[] = { "u_gbuffer_diffuse", "u_gbuffer_normal", "u_gbuffer_specular", "u_gbuffer_emissive", "u_gbuffer_depth" };
+
+	glUseProgram(program);
+	for (GLint i = 0; i < 5; i++)
+		glUniform1i(glGetUniformLocation(program, samplers[i]), GBUFFER_UNIT + i);
+
+	GLuint frame_block = glGetUniformBlockIndex(program, "FrameData");
+	if (frame_block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame_block, FRAME_DATA_BINDING);
+}
+
+bool DeferredRenderer::create(GLuint scene_program) {
+	destroy();
+
+	Shader geometry_shader("src/shader.vert", "src/shader_gbuffer.frag");
+	Shader sun_shader("src/hiz.vert", "src/deferred_sun.frag");
+	Shader light_shader("src/deferred_light.vert", "src/deferred_light.frag");
+
+	// the geometry pass draws from the mesh pool's vao, which was set up with the scene program's locations
+	static const char* const attributes[] = { "a_vertex", "a_uv", "a_normal", "a_draw_id" };
+	for (int i = 0; i < 4; i++) {
+		GLint location = glGetAttribLocation(scene_program, attributes[i]);
+		if (location >= 0)
+			glBindAttribLocation(geometry_shader.program, location, attributes[i]);
+	}
+	glLinkProgram(geometry_shader.program);
+
+	if (!linked(geometry_shader.program) || !linked(sun_shader.program) || !linked(light_shader.program)) {
+		LOG_WARNING("deferred shading: off (shaders failed)");
+		glDeleteProgram(geometry_shader.program);
+		glDeleteProgram(sun_shader.program);
+		glDeleteProgram(light_shader.program);
+		return false;
+	}
+	geometry_program = geometry_shader.program;
+	sun_program = sun_shader.program;
+	light_program = light_shader.program;
+
+	glUseProgram(geometry_program);
+	glUniform1i(glGetUniformLocation(geometry_program, "u_texture"), 0);
+	glUniform1i(glGetUniformLocation(geometry_program, "u_texture_array"), 1);
+	GLuint frame_block = glGetUniformBlockIndex(geometry_program, "FrameData");
+	if (frame_block != GL_INVALID_INDEX)
+		glUniformBlockBinding(geometry_program, frame_block, FRAME_DATA_BINDING);
+	GLuint draw_block = glGetUniformBlockIndex(geometry_program, "DrawData");
+	if (draw_block != GL_INVALID_INDEX)
+		glUniformBlockBinding(geometry_program, draw_block, DRAW_DATA_BINDING);
+	draw_offset_loc = glGetUniformLocation(geometry_program, "u_draw_offset");
+
+	bindGBufferInputs(sun_program);
+	bindGBufferInputs(light_program);
+	sun_inverse_loc = glGetUniformLocation(sun_program, "u_inverse_view_projection");
+	light_inverse_loc = glGetUniformLocation(light_program, "u_inverse_view_projection");
+	light_sphere_loc = glGetAttribLocation(light_program, "a_light_sphere");
+	light_color_loc = glGetAttribLocation(light_program, "a_light_color");
+	glUseProgram(0);
+
+	glGenVertexArrays(1, &light_vao);
+	glGenVertexArrays(1, &empty_vao);
+	glGenFramebuffers(1, &framebuffer);
+
+	LOG_INFO("deferred shading: 4 G-buffer targets, light volumes");
+	return true;
+}
+
+void DeferredRenderer::destroy() {
+	if (geometry_program) glDeleteProgram(geometry_program);
+	if (sun_program) glDeleteProgram(sun_program);
+	if (light_program) glDeleteProgram(light_program);
+	if (light_vao) glDeleteVertexArrays(1, &light_vao);
+	if (empty_vao) glDeleteVertexArrays(1, &empty_vao);
+	if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+	if (targets[0]) glDeleteTextures(4, targets);
+	if (depth) glDeleteTextures(1, &depth);
+
+	geometry_program = sun_program = light_program = 0;
+	draw_offset_loc = -1;
+	light_vao = empty_vao = 0;
+	framebuffer = 0;
+	targets[0] = targets[1] = targets[2] = targets[3] = 0;
+	depth = 0;
+	gbuffer_width = gbuffer_height = 0;
+}
+
+void DeferredRenderer::resize(int width, int height) {
+	gbuffer_width = width;
+	gbuffer_height = height;
+
+	if (targets[0]) glDeleteTextures(4, targets);
+	if (depth) glDeleteTextures(1, &depth);
+
+	// normals need the sign and more than 8 bits, the colors don't
+	static const GLenum formats[4] = { GL_RGBA8, GL_RGBA16F, GL_RGBA8, GL_RGBA8 };
+	glGenTextures(4, targets);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	for (int i = 0; i < 4; i++) {
+		glBindTexture(GL_TEXTURE_2D, targets[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets[i], 0);
+	}
+
+	// same format as the scene target's, so it can be blitted there
+	glGenTextures(1, &depth);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	static const GLenum draw_buffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	glDrawBuffers(4, draw_buffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		LOG_WARNING("deferred shading: G-buffer {}x{} is incomplete", width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::beginGeometry(int width, int height) {
+	if (width != gbuffer_width || height != gbuffer_height)
+		resize(width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	// zero everywhere nothing is drawn; the lighting passes skip those pixels by their depth
+	GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (GLint i = 0; i < 4; i++)
+		glClearBufferfv(GL_COLOR, i, zero);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glUseProgram(geometry_program);
+}
+
+void DeferredRenderer::resolve(GLuint target, const glm::mat4& view_projection, GLuint light_buffer, GLintptr light_offset, GLsizei light_count) {
+	// opaque depth for the forward passes (and the depth pyramid) that follow
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glBlitFramebuffer(0, 0, gbuffer_width, gbuffer_height, 0, 0, gbuffer_width, gbuffer_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+	for (int i = 0; i < 4; i++) {
+		glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, targets[i]);
+	}
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT + 4);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glActiveTexture(GL_TEXTURE0);
+
+	// pixel positions come back from depth, nothing here is depth tested
+	glm::mat4 inverse_view_projection = glm::inverse(view_projection);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+
+	// scene light and ambient (night map on earth's dark side) replace the skybox where there is geometry
+	glUseProgram(sun_program);
+	glUniformMatrix4fv(sun_inverse_loc, 1, GL_FALSE, &inverse_view_projection[0][0]);
+	glBindVertexArray(empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// point lights add up; back faces of each volume so it still covers the pixels with the camera
+	// inside it, and depth clamp so the far plane doesn't cut it open
+	if (light_count > 0) {
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glEnable(GL_DEPTH_CLAMP);
+
+		glUseProgram(light_program);
+		glUniformMatrix4fv(light_inverse_loc, 1, GL_FALSE, &inverse_view_projection[0][0]);
+
+		// the lights' place in the stream moves every frame, so the pointers are set every frame
+		glBindVertexArray(light_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, light_buffer);
+		glEnableVertexAttribArray(light_sphere_loc);
+		glVertexAttribPointer(light_sphere_loc, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)(light_offset + offsetof(PointLight, position)));
+		glVertexAttribDivisor(light_sphere_loc, 1);
+		glEnableVertexAttribArray(light_color_loc);
+		glVertexAttribPointer(light_color_loc, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)(light_offset + offsetof(PointLight, color)));
+		glVertexAttribDivisor(light_color_loc, 1);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glDrawArraysInstanced(GL_TRIANGLES, 0, LIGHT_VOLUME_VERTICES, light_count);
+
+		glDisable(GL_DEPTH_CLAMP);
+		glCullFace(GL_BACK);
+		glDisable(GL_BLEND);
+	}
+
+	glBindVertexArray(0);
+	glEnable(GL_CULL_FACE);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
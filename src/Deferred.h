@@ -0,0 +1,59 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stddef.h>
+
+#include "CommandBuffer.h"	// PointLight
+
+// ------------------------------------------------------------------------------------------
+// Deferred shading of the opaque pass. Opaque draws write their material terms to a G-buffer
+// (diffuse, normal + shininess, specular, ambient or emissive night map) instead of lighting
+// every fragment they cover, overdrawn or not; each pixel is then lit once: a full-screen pass
+// for the scene light, plus one light volume per point light that only touches the pixels the
+// light can reach. Transparent draws and particles stay on the forward path on top.
+//
+// Everything is written straight into the scene's framebuffer (over the sky sphere, or under the
+// cube map sky drawn after), so no extra lighting target is needed; the G-buffer's depth is
+// copied back there for the forward passes.
+// ------------------------------------------------------------------------------------------
+class DeferredRenderer {
+public:
+	// scene_program's attribute locations are reused, the geometry pass draws from its vao
+	// false (and ready() stays false) when a shader fails, the forward path then draws everything
+	bool create(GLuint scene_program);
+	void destroy();
+
+	bool ready() const { return geometry_program != 0; }
+
+	// binds and clears the G-buffer (resized to width x height) and the geometry program,
+	// whose u_draw_offset is drawOffsetLocation(); opaque draws go in until resolve()
+	void beginGeometry(int width, int height);
+	GLint drawOffsetLocation() const { return draw_offset_loc; }
+	GLuint geometryProgram() const { return geometry_program; }
+
+	// lights the G-buffer into target (a framebuffer of the G-buffer's size with a depth-stencil
+	// buffer), which is left bound, and copies its depth there; lights are light_count PointLights
+	// at light_offset in light_buffer, bound as an array buffer
+	// changes program, vao, blend / cull state and texture units 3 to 7
+	void resolve(GLuint target, const glm::mat4& view_projection, GLuint light_buffer, GLintptr light_offset, GLsizei light_count);
+
+private:
+	void resize(int width, int height);
+
+	GLuint geometry_program = 0;	// shader.vert + shader_gbuffer.frag
+	GLuint sun_program = 0;			// full-screen, scene light and ambient / night map
+	GLuint light_program = 0;		// one volume per point light, added on top
+	GLint draw_offset_loc = -1;
+	GLint sun_inverse_loc = -1;
+	GLint light_inverse_loc = -1;
+	GLint light_sphere_loc = -1;
+	GLint light_color_loc = -1;
+
+	GLuint light_vao = 0;			// instanced lights from the stream, set per frame
+	GLuint empty_vao = 0;			// for the full-screen triangle
+
+	GLuint framebuffer = 0;
+	GLuint targets[4] = {};			// diffuse, normal, specular, emissive
+	GLuint depth = 0;
+	int gbuffer_width = 0, gbuffer_height = 0;
+};
@@ -0,0 +1,215 @@
+#include "DynamicResolution.h"
+#include "Shader.h"
+#include <math.h>
+
+static const GLint UPSCALE_UNIT = 12;		// clear of every unit the scene binds
+
+// 60 fps with room for the swap and frame-to-frame noise
+static const float TARGET_FRAME_MS = 15.0f;
+
+// scale = MIN_SCALE + level * SCALE_STEP, level 0 to SCALE_STEPS (full resolution)
+static const float MIN_SCALE = 0.5f;
+static const int SCALE_STEPS = 8;
+static const float SCALE_STEP = (1.0f - MIN_SCALE) / SCALE_STEPS;
+
+// a step up has to fit this much of the budget (cost goes with the pixel count, scale squared),
+// for this many timed frames in a row
+static const float RAISE_BUDGET = 0.85f;
+static const int RAISE_FRAMES = 30;
+
+// sharpening at MIN_SCALE, less the closer the scale is to 1
+static const float MAX_SHARPNESS = 0.8f;
+
+static float levelScale(int level) {
+	return MIN_SCALE + level * SCALE_STEP;
+}
+
+bool DynamicResolution::create() {
+	if (!vao) {
+		glGenVertexArrays(1, &vao);
+		glGenQueries(FRAMES, queries);
+		glGenFramebuffers(1, &target_framebuffer);
+	}
+
+	Shader shader("src/hiz.vert", "src/upscale.frag");
+	GLint status = GL_FALSE;
+	glGetProgramiv(shader.program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		glDeleteProgram(shader.program);
+		return false;
+	}
+
+	if (program)
+		glDeleteProgram(program);
+	program = shader.program;
+	output_size_loc = glGetUniformLocation(program, "u_output_size");
+	sharpness_loc = glGetUniformLocation(program, "u_sharpness");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "u_scene"), UPSCALE_UNIT);
+	glUseProgram(0);
+	return true;
+}
+
+void DynamicResolution::destroy() {
+	if (program) glDeleteProgram(program);
+	if (vao) {
+		glDeleteVertexArrays(1, &vao);
+		glDeleteQueries(FRAMES, queries);
+		glDeleteFramebuffers(1, &target_framebuffer);
+	}
+	if (color) glDeleteTextures(1, &color);
+	if (depth) glDeleteTextures(1, &depth);
+	program = 0;
+	output_size_loc = sharpness_loc = -1;
+	vao = 0;
+	target_framebuffer = color = depth = 0;
+	target_width = target_height = 0;
+	for (int i = 0; i < FRAMES; i++) {
+		queries[i] = 0;
+		pending[i] = false;
+	}
+	timing = false;
+	level = -1;
+	current_scale = 1.0f;
+	frames_under = 0;
+	gpu_ms = 0.0f;
+}
+
+void DynamicResolution::resize(int width, int height) {
+	target_width = width;
+	target_height = height;
+
+	if (color) glDeleteTextures(1, &color);
+	if (depth) glDeleteTextures(1, &depth);
+
+	glGenTextures(1, &color);
+	glBindTexture(GL_TEXTURE_2D, color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	glGenTextures(1, &depth);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::readTimes() {
+	// oldest first; queries finish in order, so stop at the first one still running
+	for (int k = 1; k <= FRAMES; k++) {
+		int i = (current + k) % FRAMES;
+		if (!pending[i]) continue;
+
+		GLuint available = 0;
+		glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+		pending[i] = false;
+
+		float ms = elapsed / 1000000.0f;
+		gpu_ms = gpu_ms == 0.0f ? ms : gpu_ms + (ms - gpu_ms) * 0.1f;
+
+		// frames drawn before the last step still show the old cost, it has been acted on
+		if (query_level[i] != level) continue;
+
+		float scale = levelScale(level);
+		if (ms > TARGET_FRAME_MS) {
+			// straight down to the step that would have fit, at least one
+			float fit = scale * sqrtf(TARGET_FRAME_MS / ms);
+			int fit_level = (int)floorf((fit - MIN_SCALE) / SCALE_STEP);
+			if (fit_level >= level) fit_level = level - 1;
+			level = fit_level > 0 ? fit_level : 0;
+			frames_under = 0;
+		}
+		else if (level < SCALE_STEPS) {
+			float next = levelScale(level + 1) / scale;
+			frames_under = ms * next * next < TARGET_FRAME_MS * RAISE_BUDGET ? frames_under + 1 : 0;
+			if (frames_under >= RAISE_FRAMES) {
+				level++;
+				frames_under = 0;
+			}
+		}
+	}
+}
+
+void DynamicResolution::beginFrame(int width, int height, bool enabled) {
+	readTimes();
+	if (!enabled || level < 0) {
+		level = SCALE_STEPS;
+		frames_under = 0;
+	}
+	current_scale = levelScale(level);
+
+	output_width = width;
+	output_height = height;
+	render_width = (int)(width * current_scale + 0.5f);
+	render_height = (int)(height * current_scale + 0.5f);
+	if (render_width < 1) render_width = 1;
+	if (render_height < 1) render_height = 1;
+	if (render_width != target_width || render_height != target_height)
+		resize(render_width, render_height);
+
+	// skip timing while the gpu is more than FRAMES behind
+	current = (current + 1) % FRAMES;
+	timing = !pending[current];
+	if (timing) {
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+		query_level[current] = level;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+	glViewport(0, 0, render_width, render_height);
+}
+
+void DynamicResolution::endFrame() {
+	bool scaled = render_width != output_width || render_height != output_height;
+
+	if (!scaled || !program) {
+		// same size, or no upscale program: a copy does
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, target_framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, output_width, output_height, GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	else {
+		// covers every pixel, nothing to clear or depth test
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, output_width, output_height);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+
+		glActiveTexture(GL_TEXTURE0 + UPSCALE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, color);
+		glActiveTexture(GL_TEXTURE0);
+
+		glUseProgram(program);
+		glUniform2f(output_size_loc, (GLfloat)output_width, (GLfloat)output_height);
+		glUniform1f(sharpness_loc, MAX_SHARPNESS * (1.0f - current_scale) / (1.0f - MIN_SCALE));
+		glBindVertexArray(vao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+	}
+
+	if (timing) {
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[current] = true;
+		timing = false;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <GL/glew.h>
+
+// ------------------------------------------------------------------------------------------
+// Dynamic resolution: the scene is drawn into an offscreen target whose size follows the gpu's
+// frame time, then scaled up to the window (bilinear, sharpened). The frame is timed with
+// GL_TIME_ELAPSED queries read back a few frames later, never waiting on the gpu; a frame over
+// budget drops the scale right away to what would have fit, one under budget for a while raises
+// it a step. Scales are quantized so the targets sized from it (G-buffer, depth pyramid) are
+// reallocated only when a step is taken.
+// ------------------------------------------------------------------------------------------
+class DynamicResolution {
+public:
+	// creates the queries and target framebuffer once, then builds the upscale program
+	// (hiz.vert / upscale.frag), again on a shader reload; false when the shaders fail, frames are
+	// then stretched with a plain blit
+	bool create();
+	void destroy();
+
+	// picks the render size for an output of width x height (not empty; the full size when
+	// !enabled), binds the scene target at that size with its viewport and starts timing
+	void beginFrame(int width, int height, bool enabled);
+
+	// stops timing after scaling the scene target up into the default framebuffer; changes
+	// program, vao, framebuffer, viewport and texture unit 12, leaves depth test and culling on
+	void endFrame();
+
+	GLuint framebuffer() const { return target_framebuffer; }
+	GLuint colorTexture() const { return color; }
+	GLuint depthTexture() const { return depth; }
+	int renderWidth() const { return render_width; }
+	int renderHeight() const { return render_height; }
+	float scale() const { return current_scale; }
+	float gpuTime() const { return gpu_ms; }		// ms, smoothed; 0 until the first frame is read back
+
+private:
+	void resize(int width, int height);
+	void readTimes();
+
+	static const int FRAMES = 4;	// in flight before a query is reused
+
+	GLuint program = 0;
+	GLint output_size_loc = -1;
+	GLint sharpness_loc = -1;
+	GLuint vao = 0;					// empty, the triangle comes from gl_VertexID
+
+	GLuint target_framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;				// same format as the G-buffer's so it can be blitted, sampled by later passes
+	int target_width = 0, target_height = 0;
+	int output_width = 0, output_height = 0;
+	int render_width = 0, render_height = 0;
+
+	GLuint queries[FRAMES] = {};
+	int query_level[FRAMES] = {};	// scale step each timed frame was drawn at
+	bool pending[FRAMES] = {};
+	int current = 0;
+	bool timing = false;
+
+	int level = -1;					// scale step, -1 before the first frame
+	float current_scale = 1.0f;
+	int frames_under = 0;			// timed frames in a row with room for the next step up
+	float gpu_ms = 0.0f;
+};
@@ -0,0 +1,97 @@
+#include "FramePipeline.h"
+
+void FramePipeline::start(GLFWwindow* target_window, ExecuteFunction execute_function, PresentFunction present_function) {
+	window = target_window;
+	execute = execute_function;
+	present = present_function;
+	quit = false;
+	render_thread = std::thread(&FramePipeline::renderLoop, this);
+}
+
+void FramePipeline::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake_render.notify_one();
+	if (render_thread.joinable())
+		render_thread.join();
+}
+
+RenderCommandBuffer& FramePipeline::beginFrame() {
+	std::unique_lock<std::mutex> lock(mutex);
+	wake_main.wait(lock, [this] { return !buffer_in_use[write_index]; });
+
+	RenderCommandBuffer& buffer = buffers[write_index];
+	buffer.clear();
+	return buffer;
+}
+
+void FramePipeline::submitFrame() {
+	{
+		// one pending slot: the frame submitted before has to be taken first, or it would be
+		// overwritten and its buffer never released
+		std::unique_lock<std::mutex> lock(mutex);
+		wake_main.wait(lock, [this] { return pending_index == -1; });
+		buffer_in_use[write_index] = true;
+		pending_index = write_index;
+		write_index ^= 1;
+	}
+	wake_render.notify_one();
+}
+
+void FramePipeline::runOnRenderThread(const std::function<void()>& task) {
+	bool done = false;
+	std::unique_lock<std::mutex> lock(mutex);
+	Task entry;
+	entry.function = task;
+	entry.done = &done;
+	tasks.push_back(entry);
+	wake_render.notify_one();
+	wake_main.wait(lock, [&done] { return done; });
+}
+
+void FramePipeline::renderLoop() {
+	glfwMakeContextCurrent(window);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake_render.wait(lock, [this] { return quit || pending_index != -1 || !tasks.empty(); });
+
+		// tasks first so a reload is visible in the very next frame
+		if (!tasks.empty()) {
+			Task task = tasks.front();
+			tasks.pop_front();
+
+			lock.unlock();
+			task.function();
+			lock.lock();
+
+			*task.done = true;
+			wake_main.notify_all();
+			continue;
+		}
+
+		if (pending_index != -1) {
+			int index = pending_index;
+			pending_index = -1;
+			wake_main.notify_all();
+
+			lock.unlock();
+			if (execute(buffers[index])) {
+				glfwSwapBuffers(window);
+				if (present) present();
+			}
+			lock.lock();
+
+			buffer_in_use[index] = false;
+			wake_main.notify_all();
+			continue;
+		}
+
+		if (quit) break;
+	}
+	lock.unlock();
+
+	glfwMakeContextCurrent(NULL);
+}
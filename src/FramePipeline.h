@@ -0,0 +1,66 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "CommandBuffer.h"
+
+// ------------------------------------------------------------------------------------------
+// Two-stage frame pipeline. The calling thread records frame N+1 into one command buffer
+// while a dedicated render thread, which owns the GL context, replays frame N from the
+// other and swaps. Frame time becomes max(cpu, gpu driver) instead of their sum.
+//
+// Anything else that needs GL (loading, reloading, swap interval) must go through
+// runOnRenderThread(). A frame recorded before such a task may be handed to the render thread
+// after it; execute returns false to drop it (nothing drawn, no swap). present, when given,
+// runs on the render thread right after each swap.
+// ------------------------------------------------------------------------------------------
+class FramePipeline {
+public:
+	typedef std::function<bool(const RenderCommandBuffer&)> ExecuteFunction;
+	typedef std::function<void()> PresentFunction;
+
+	// the window's context must not be current on the calling thread
+	void start(GLFWwindow* window, ExecuteFunction execute, PresentFunction present = PresentFunction());
+	void stop();
+
+	// buffer to record the next frame into, waits while the render thread still reads it
+	RenderCommandBuffer& beginFrame();
+
+	// hands the buffer from beginFrame() to the render thread, waits while the one submitted
+	// before it hasn't been taken yet
+	void submitFrame();
+
+	// runs task on the render thread between frames and waits for it to finish
+	void runOnRenderThread(const std::function<void()>& task);
+
+private:
+	struct Task {
+		std::function<void()> function;
+		bool* done;
+	};
+
+	void renderLoop();
+
+	GLFWwindow* window = NULL;
+	ExecuteFunction execute;
+	PresentFunction present;
+
+	std::thread render_thread;
+	std::mutex mutex;
+	std::condition_variable wake_render;	// signalled when there is a frame, a task, or quit
+	std::condition_variable wake_main;		// signalled when a frame is taken, a buffer released or a task finishes
+
+	RenderCommandBuffer buffers[2];
+	bool buffer_in_use[2] = { false, false };	// submitted and not yet replayed
+	int write_index = 0;
+	int pending_index = -1;						// submitted, waiting for the render thread
+
+	std::deque<Task> tasks;
+	bool quit = false;
+};
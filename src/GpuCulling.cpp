@@ -0,0 +1,310 @@
+#include "GpuCulling.h"
+#include "MeshPool.h"	// DrawElementsIndirectCommand
+#include "Shader.h"		// readFile
+#include "Log.h"
+#include <iostream>
+#include <string>
+
+// texture unit the depth pyramid is sampled from, 0 and 1 belong to the scene shaders
+static const GLint PYRAMID_UNIT = 2;
+static const GLuint CULL_GROUP_SIZE = 64;	// local_size_x in cull.comp
+
+// compiles "#version ..." + the shared culling functions (optional) + the stage's own file
+static GLuint compileStage(GLenum stage, const char* version, const char* common_file, const char* file) {
+	char* common = common_file ? Shader::readFile(common_file) : NULL;
+	char* body = Shader::readFile(file);
+
+	const GLchar* sources[3];
+	GLsizei count = 0;
+	sources[count++] = version;
+	if (common)
+		sources[count++] = common;
+	sources[count++] = body;
+
+	GLuint shader = glCreateShader(stage);
+	glShaderSource(shader, count, sources, NULL);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		char log[2048] = "";
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		std::cout << "gpu culling: " << file << " failed to compile\n" << log << "\n";
+	}
+
+	delete[] common;
+	delete[] body;
+	return shader;
+}
+
+// links the stages, varyings (optional) are captured interleaved with transform feedback
+static GLuint linkProgram(GLuint first, GLuint second, const char* const* varyings, GLsizei varying_count) {
+	GLuint program = glCreateProgram();
+	glAttachShader(program, first);
+	if (second)
+		glAttachShader(program, second);
+	if (varyings)
+		glTransformFeedbackVaryings(program, varying_count, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(program);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[2048] = "";
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "gpu culling: link failed\n" << log << "\n";
+		glDeleteProgram(program);
+		program = 0;
+	}
+
+	glDeleteShader(first);
+	if (second)
+		glDeleteShader(second);
+	return program;
+}
+
+GpuCullMode GpuCuller::create(bool indirect_drawing, GLuint max_draws, GLuint max_runs) {
+	destroy();
+
+	// without indirect draws the cpu has to know the visible set anyway
+	if (!indirect_drawing) {
+		LOG_INFO("gpu culling: off (needs indirect drawing)");
+		return cull_mode;
+	}
+
+	max_draw_count = max_draws;
+	max_run_count = max_runs;
+
+	if (GLEW_VERSION_4_3) {
+		cull_program = linkProgram(compileStage(GL_COMPUTE_SHADER, "#version 430\n", "src/cull_common.glsl", "src/cull.comp"), 0, NULL, 0);
+		if (cull_program)
+			cull_mode = GPU_CULL_COMPUTE;
+	}
+	if (cull_mode == GPU_CULL_NONE) {
+		static const char* const varyings[] = { "f_count", "f_instance_count", "f_first_index", "f_base_vertex", "f_base_instance" };
+		cull_program = linkProgram(compileStage(GL_VERTEX_SHADER, "#version 330\n", "src/cull_common.glsl", "src/cull_feedback.vert"), 0, varyings, 5);
+		if (cull_program)
+			cull_mode = GPU_CULL_TRANSFORM_FEEDBACK;
+	}
+	pyramid_program = linkProgram(compileStage(GL_VERTEX_SHADER, "", NULL, "src/hiz.vert"), compileStage(GL_FRAGMENT_SHADER, "", NULL, "src/hiz.frag"), NULL, 0);
+
+	if (cull_mode == GPU_CULL_NONE || !pyramid_program) {
+		LOG_WARNING("gpu culling: off (shaders failed)");
+		destroy();
+		return cull_mode;
+	}
+
+	// appending survivors needs the count read back by the GPU, not the CPU
+	compaction = cull_mode == GPU_CULL_COMPUTE && GLEW_ARB_indirect_parameters;
+
+	glGenBuffers(1, &commands);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, max_draws * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	if (compaction) {
+		glGenBuffers(1, &counts);
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, counts);
+		glBufferData(GL_PARAMETER_BUFFER_ARB, max_runs * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	}
+
+	if (cull_mode == GPU_CULL_TRANSFORM_FEEDBACK) {
+		glGenVertexArrays(1, &feedback_vao);
+		glBindVertexArray(feedback_vao);
+		GLint sphere_loc = glGetAttribLocation(cull_program, "a_sphere");
+		GLint command_loc = glGetAttribLocation(cull_program, "a_command");
+		glEnableVertexAttribArray(sphere_loc);
+		glEnableVertexAttribArray(command_loc);
+		glBindVertexArray(0);
+	}
+	glGenVertexArrays(1, &empty_vao);
+	glGenFramebuffers(2, framebuffers);
+
+	glUseProgram(cull_program);
+	glUniform1i(glGetUniformLocation(cull_program, "u_depth_pyramid"), PYRAMID_UNIT);
+	glUseProgram(pyramid_program);
+	glUniform1i(glGetUniformLocation(pyramid_program, "u_source"), PYRAMID_UNIT);
+	glUseProgram(0);
+
+	LOG_INFO("gpu culling: {}{}", (cull_mode == GPU_CULL_COMPUTE ? "compute shader" : "transform feedback"), (compaction ? ", compacted opaque draws" : ""));
+	return cull_mode;
+}
+
+void GpuCuller::destroy() {
+	if (cull_program) glDeleteProgram(cull_program);
+	if (pyramid_program) glDeleteProgram(pyramid_program);
+	if (commands) glDeleteBuffers(1, &commands);
+	if (counts) glDeleteBuffers(1, &counts);
+	if (feedback_vao) glDeleteVertexArrays(1, &feedback_vao);
+	if (empty_vao) glDeleteVertexArrays(1, &empty_vao);
+	if (framebuffers[0]) glDeleteFramebuffers(2, framebuffers);
+	if (depth_copy) glDeleteTextures(1, &depth_copy);
+	if (pyramid) glDeleteTextures(1, &pyramid);
+
+	cull_program = pyramid_program = 0;
+	commands = counts = 0;
+	feedback_vao = empty_vao = 0;
+	framebuffers[0] = framebuffers[1] = 0;
+	depth_copy = pyramid = 0;
+	screen_width = screen_height = 0;
+	pyramid_levels = 0;
+	pyramid_valid = false;
+	cull_mode = GPU_CULL_NONE;
+	compaction = false;
+}
+
+void GpuCuller::cull(GLuint input_buffer, GLintptr input_offset, GLuint input_count, GLuint run_count, const Frustum& frustum) {
+	if (cull_mode == GPU_CULL_NONE || input_count == 0)
+		return;
+	if (input_count > max_draw_count)
+		input_count = max_draw_count;
+
+	glUseProgram(cull_program);
+	glUniform4fv(glGetUniformLocation(cull_program, "u_frustum"), 6, &frustum.planes[0].x);
+	glUniformMatrix4fv(glGetUniformLocation(cull_program, "u_prev_view_projection"), 1, GL_FALSE, &pyramid_view_projection[0][0]);
+	glUniform2f(glGetUniformLocation(cull_program, "u_pyramid_size"), (float)pyramid_width, (float)pyramid_height);
+	glUniform1i(glGetUniformLocation(cull_program, "u_pyramid_levels"), pyramid_valid ? pyramid_levels : 0);
+
+	glActiveTexture(GL_TEXTURE0 + PYRAMID_UNIT);
+	glBindTexture(GL_TEXTURE_2D, pyramid_valid ? pyramid : 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	if (cull_mode == GPU_CULL_COMPUTE) {
+		if (compaction) {
+			GLuint zero = 0;
+			if (run_count > max_run_count)
+				run_count = max_run_count;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts);
+			glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, run_count * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counts);
+		}
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, input_buffer, input_offset, input_count * sizeof(CullInput));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commands);
+		glUniform1ui(glGetUniformLocation(cull_program, "u_input_count"), input_count);
+
+		glDispatchCompute((input_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+		// the commands and counts are read by the draw calls, not by shaders
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+	}
+	else {
+		glBindVertexArray(feedback_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, input_buffer);
+		glVertexAttribPointer(glGetAttribLocation(cull_program, "a_sphere"), 4, GL_FLOAT, GL_FALSE, sizeof(CullInput), (void*)(input_offset + offsetof(CullInput, sphere)));
+		glVertexAttribIPointer(glGetAttribLocation(cull_program, "a_command"), 4, GL_UNSIGNED_INT, sizeof(CullInput), (void*)(input_offset + offsetof(CullInput, count)));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, commands);
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, input_count);
+		glEndTransformFeedback();
+		glDisable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	}
+}
+
+void GpuCuller::resizePyramid(int width, int height) {
+	screen_width = width;
+	screen_height = height;
+	pyramid_width = width / 2 > 0 ? width / 2 : 1;
+	pyramid_height = height / 2 > 0 ? height / 2 : 1;
+
+	pyramid_levels = 1;
+	for (int size = pyramid_width > pyramid_height ? pyramid_width : pyramid_height; size > 1; size /= 2)
+		pyramid_levels++;
+
+	if (depth_copy) glDeleteTextures(1, &depth_copy);
+	if (pyramid) glDeleteTextures(1, &pyramid);
+
+	glGenTextures(1, &depth_copy);
+	glBindTexture(GL_TEXTURE_2D, depth_copy);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	glGenTextures(1, &pyramid);
+	glBindTexture(GL_TEXTURE_2D, pyramid);
+	for (int level = 0, w = pyramid_width, h = pyramid_height; level < pyramid_levels; level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, NULL);
+		w = w / 2 > 0 ? w / 2 : 1;
+		h = h / 2 > 0 ? h / 2 : 1;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_copy, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	pyramid_valid = false;
+}
+
+void GpuCuller::buildDepthPyramid(GLuint framebuffer, int width, int height, const glm::mat4& view_projection) {
+	if (cull_mode == GPU_CULL_NONE || width <= 0 || height <= 0)
+		return;
+	if (width != screen_width || height != screen_height)
+		resizePyramid(width, height);
+
+	// copy the scene's depth into the texture level 0 is built from
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[0]);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	glUseProgram(pyramid_program);
+	GLint size_loc = glGetUniformLocation(pyramid_program, "u_source_size");
+
+	glBindVertexArray(empty_vao);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_BLEND);
+	glActiveTexture(GL_TEXTURE0 + PYRAMID_UNIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+
+	// each level reads the one below it; base/max level keep the level being written out of the
+	// sampled range so the texture is never read and written in the same pass, and make the
+	// source level the shader's lod 0
+	int source_width = width, source_height = height;
+	for (int level = 0; level < pyramid_levels; level++) {
+		int target_width = source_width / 2 > 0 ? source_width / 2 : 1;
+		int target_height = source_height / 2 > 0 ? source_height / 2 : 1;
+
+		if (level == 0) {
+			glBindTexture(GL_TEXTURE_2D, depth_copy);
+		}
+		else {
+			glBindTexture(GL_TEXTURE_2D, pyramid);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+		glUniform2i(size_loc, source_width, source_height);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+		glViewport(0, 0, target_width, target_height);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		source_width = target_width;
+		source_height = target_height;
+	}
+
+	// whole chain visible again for cull()
+	glBindTexture(GL_TEXTURE_2D, pyramid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramid_levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+
+	pyramid_view_projection = view_projection;
+	pyramid_valid = true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stddef.h>
+
+#include "Culling.h"	// Frustum
+
+// one draw to be culled, std430 for cull.comp and vertex attributes for cull_feedback.vert
+struct CullInput {
+	glm::vec4 sphere;			// world-space center, radius
+	GLuint count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+	GLuint out_index;			// command slot, or the run's first slot when compacting
+	GLuint run;					// counter slot when compacting
+	GLuint compact;				// 1: survivors are appended (order not kept), 0: culled draws keep their slot with 0 instances
+	GLuint padding;
+};
+
+static_assert(sizeof(CullInput) == 48, "CullInput must match the std430 struct in cull.comp");
+
+enum GpuCullMode {
+	GPU_CULL_NONE,					// no indirect drawing, culling stays on the cpu
+	GPU_CULL_COMPUTE,				// GL 4.3 compute shader
+	GPU_CULL_TRANSFORM_FEEDBACK		// GL 3.3 vertex shader + transform feedback
+};
+
+// ------------------------------------------------------------------------------------------
+// Frustum and occlusion culling on the GPU. Every candidate draw is tested against the view
+// frustum and against a hierarchical-Z pyramid (max depth per texel, mip chain) built from
+// the previous frame's opaque depth; the result is written as DrawElementsIndirectCommands
+// the indirect draw calls read directly, so the CPU never sees which draws survived.
+//
+// The compute path can compact survivors of order-independent runs and report how many there
+// are (with ARB_indirect_parameters); otherwise, and always on the transform feedback path,
+// culled draws stay in place with an instance count of 0.
+//
+// Occlusion uses last frame's depth, so an object coming out from behind another one shows up
+// one frame late.
+// ------------------------------------------------------------------------------------------
+class GpuCuller {
+public:
+	// picks the best mode the context supports, GPU_CULL_NONE without indirect drawing
+	GpuCullMode create(bool indirect_drawing, GLuint max_draws, GLuint max_runs);
+	void destroy();
+
+	GpuCullMode mode() const { return cull_mode; }
+	bool compacts() const { return compaction; }
+
+	// inputs are input_count CullInputs at input_offset in input_buffer (a shader storage buffer
+	// for compute, an array buffer for transform feedback); commands land in commandBuffer()
+	void cull(GLuint input_buffer, GLintptr input_offset, GLuint input_count, GLuint run_count, const Frustum& frustum);
+
+	GLuint commandBuffer() const { return commands; }
+	GLuint countBuffer() const { return counts; }		// one GLuint per run, compacted runs only
+
+	// copies the depth of framebuffer (width x height, left bound) into the pyramid for the next
+	// frame's cull(); changes program, vao, viewport and texture unit 2 bindings
+	void buildDepthPyramid(GLuint framebuffer, int width, int height, const glm::mat4& view_projection);
+
+private:
+	void resizePyramid(int width, int height);
+
+	GpuCullMode cull_mode = GPU_CULL_NONE;
+	bool compaction = false;
+	GLuint max_draw_count = 0;
+	GLuint max_run_count = 0;
+
+	GLuint cull_program = 0;
+	GLuint pyramid_program = 0;
+	GLuint commands = 0;			// DrawElementsIndirectCommand per draw
+	GLuint counts = 0;				// survivors per compacted run
+	GLuint feedback_vao = 0;		// attribute layout of the inputs, transform feedback path
+	GLuint empty_vao = 0;			// for the full-screen triangle
+
+	// depth pyramid
+	GLuint depth_copy = 0;			// depth texture the framebuffer's depth is blitted into
+	GLuint pyramid = 0;				// R32F, level 0 is half the screen
+	GLuint framebuffers[2] = {};	// blit target / pyramid level being written
+	int screen_width = 0, screen_height = 0;
+	int pyramid_width = 0, pyramid_height = 0, pyramid_levels = 0;
+	bool pyramid_valid = false;		// a pyramid has been built since the last resize
+	glm::mat4 pyramid_view_projection = glm::mat4(1.0f);
+};
@@ -0,0 +1,162 @@
+#include "JobBenchmark.h"
+#include "JobSystem.h"
+#include "Memory.h"
+#include "Animation.h"
+#include "Culling.h"
+#include "LightGrid.h"
+#include "Particles.h"
+#include "SceneGraph.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// sizes of the synthetic workloads, the real scene is far too small to measure
+static const int BENCH_NODES = 65536;
+static const int BENCH_SPHERES = 262144;
+static const int BENCH_PARTICLES = 262144;
+static const int BENCH_LIGHTS = 4096;
+static const int BENCH_RUNS = 50;
+
+enum BenchStage {
+	BENCH_ANIMATION,
+	BENCH_TRANSFORMS,
+	BENCH_CULLING,
+	BENCH_PARTICLES_UPDATE,
+	BENCH_LIGHT_BINNING,
+	BENCH_STAGE_COUNT
+};
+
+static const char* bench_stage_names[BENCH_STAGE_COUNT] = { "animation", "transforms", "culling", "particles", "light binning" };
+
+struct BenchScene {
+	SceneGraph graph;
+	AnimationSystem animation;
+	SphereCullBatch spheres;
+	std::vector<unsigned char> visible;
+	Frustum frustum;
+	std::vector<Particle> particles;
+	std::vector<PointLight> lights;
+	LightGrid light_grid;
+	glm::mat4 view, projection;
+};
+
+static float randomRange(float min, float max) {
+	return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static void buildBenchScene(BenchScene& scene) {
+	srand(1234);
+
+	// one root per 64 nodes, the rest hang off it, each with a spin and a falling path
+	for (int i = 0; i < BENCH_NODES; i++) {
+		int parent = (i % 64) == 0 ? SCENE_NODE_NONE : i - (i % 64);
+		glm::vec3 position(randomRange(-20.0f, 20.0f), randomRange(0.0f, 15.0f), randomRange(-20.0f, 20.0f));
+		int node = scene.graph.addNode(parent, TransformationValues(position, glm::vec3(0.0f), glm::vec3(0.5f)));
+
+		scene.animation.addSpin(node, i % 3, 0.0f, randomRange(-2.0f, 2.0f));
+		scene.animation.addFallingPath(node, position, i % 15, 15, 1.5f, 15.0f);
+	}
+
+	for (int i = 0; i < BENCH_SPHERES; i++) {
+		BoundingSphere sphere;
+		sphere.center = glm::vec3(randomRange(-50.0f, 50.0f), randomRange(-50.0f, 50.0f), randomRange(-50.0f, 50.0f));
+		sphere.radius = randomRange(0.1f, 2.0f);
+		scene.spheres.add(sphere);
+	}
+
+	// the scene's default camera
+	scene.view = glm::lookAt(glm::vec3(0.0f, 5.0f, 5.0f), glm::vec3(0.0f, 9.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	scene.projection = glm::perspective(90.0f, 1.0f, 0.1f, 50.0f);
+	scene.frustum = extractFrustumPlanes(scene.projection * scene.view);
+
+	for (int i = 0; i < BENCH_LIGHTS; i++) {
+		PointLight light;
+		light.position = glm::vec3(randomRange(-20.0f, 20.0f), randomRange(0.0f, 15.0f), randomRange(-20.0f, 20.0f));
+		light.radius = randomRange(0.5f, 3.0f);
+		light.color = glm::vec3(1.0f);
+		light.intensity = 1.0f;
+		scene.lights.push_back(light);
+	}
+
+	initializeParticles(scene.particles, BENCH_PARTICLES);
+}
+
+// average ms of one run of the stage; allocations made by the runs after the first (warm-up,
+// where scratch buffers and queues grow) are added to steady_allocations
+static double timeStage(BenchScene& scene, BenchStage stage, JobSystem& jobs, uint64_t& steady_allocations) {
+	typedef std::chrono::high_resolution_clock Clock;
+	double total = 0.0;
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		// untimed setup so every run does the same amount of work
+		if (stage == BENCH_TRANSFORMS) {
+			for (size_t node = 0; node < scene.graph.size(); node++)
+				scene.graph.editLocal((int)node);
+		}
+		if (stage == BENCH_PARTICLES_UPDATE)
+			respawnParticles(scene.particles, 5.0f);
+
+		AllocationScope allocations;
+		Clock::time_point start = Clock::now();
+		switch (stage) {
+		case BENCH_ANIMATION: scene.animation.step(run / 60.0, &jobs); break;
+		case BENCH_TRANSFORMS: scene.graph.update(&jobs); break;
+		case BENCH_CULLING: scene.spheres.cull(scene.frustum, scene.visible, &jobs); break;
+		case BENCH_PARTICLES_UPDATE: updateParticles(scene.particles, 1.0f / 60.0f, 0.0f, &jobs); break;
+		case BENCH_LIGHT_BINNING: scene.light_grid.build(scene.lights, scene.view, scene.projection, &jobs); break;
+		default: break;
+		}
+		total += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (run > 0)
+			steady_allocations += allocations.count();
+	}
+
+	return total / BENCH_RUNS;
+}
+
+bool runJobBenchmark(unsigned max_threads) {
+	if (max_threads == 0)
+		max_threads = 1;
+
+	BenchScene scene;
+	buildBenchScene(scene);
+
+	printf("job system scaling, %d runs per stage (%d nodes, %d spheres, %d particles, %d lights)\n", BENCH_RUNS, BENCH_NODES, BENCH_SPHERES, BENCH_PARTICLES, BENCH_LIGHTS);
+	printf("%8s", "threads");
+	for (int s = 0; s < BENCH_STAGE_COUNT; s++)
+		printf(" %20s", bench_stage_names[s]);
+	printf("\n");
+
+	double baseline[BENCH_STAGE_COUNT] = {};
+	uint64_t steady_allocations[BENCH_STAGE_COUNT] = {};
+	for (unsigned threads = 1; threads <= max_threads; threads++) {
+		// the calling thread helps while it waits, so n threads is n - 1 workers
+		JobSystem jobs;
+		jobs.start(threads - 1);
+
+		printf("%8u", threads);
+		for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+			double ms = timeStage(scene, (BenchStage)s, jobs, steady_allocations[s]);
+			if (threads == 1)
+				baseline[s] = ms;
+			printf(" %9.3f ms (x%5.2f)", ms, baseline[s] / ms);
+		}
+		printf("\n");
+
+		jobs.stop();
+	}
+
+	bool allocation_free = true;
+	for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+		if (steady_allocations[s] == 0)
+			continue;
+		printf("FAILED: %s allocated %llu times after warm-up\n", bench_stage_names[s], (unsigned long long)steady_allocations[s]);
+		allocation_free = false;
+	}
+	if (allocation_free)
+		printf("no allocations after warm-up\n");
+	return allocation_free;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// ------------------------------------------------------------------------------------------
+// Times the per-frame CPU stages (animation step, transform rebuild, frustum culling,
+// particle update) on synthetic scenes big enough to be worth splitting, once per thread
+// count from 1 to max_threads, and prints ms per run and speedup over one thread.
+// Runs after the first of each stage must not allocate; false (after printing the offenders)
+// if any did.
+// ------------------------------------------------------------------------------------------
+bool runJobBenchmark(unsigned max_threads);
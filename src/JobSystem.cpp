@@ -0,0 +1,233 @@
+#include "JobSystem.h"
+
+// jobs each queue holds before its first growth
+static const size_t QUEUE_INITIAL_CAPACITY = 256;
+
+// which job system the current thread works for, and which queue it owns there
+static thread_local JobSystem* tls_system = NULL;
+static thread_local int tls_queue = -1;
+
+void JobSystem::start(unsigned worker_count) {
+	stop();
+
+	quit = false;
+	queues.clear();
+	for (unsigned i = 0; i < worker_count + 1; i++) {
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+		queues.back()->ring.resize(QUEUE_INITIAL_CAPACITY);
+	}
+
+	for (unsigned i = 0; i < worker_count; i++)
+		threads.push_back(std::thread(&JobSystem::workerLoop, this, (int)i));
+}
+
+void JobSystem::stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	threads.clear();
+}
+
+void JobSystem::run(const Job& job, JobCounter* counter) {
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	QueuedJob entry;
+	entry.job = job;
+	entry.counter = counter;
+	push(entry);
+}
+
+void JobSystem::runAfter(JobCounter& dependency, const Job& job, JobCounter* counter) {
+	{
+		// checked under the lock that finish() takes before releasing continuations,
+		// so the job is either parked here or queued right away, never lost in between
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (!dependency.done()) {
+			if (counter)
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+			JobCounter::Continuation continuation;
+			continuation.job = job;
+			continuation.counter = counter;
+			dependency.continuations.push_back(continuation);
+			return;
+		}
+	}
+	run(job, counter);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	while (!counter.done()) {
+		if (!tryRunOne())
+			std::this_thread::yield();
+	}
+
+	// the last finish() may still be releasing continuations, don't let the caller free the counter under it
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::parallelRanges(size_t count, size_t grain, RangeFunction function, const void* body) {
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	if (count <= grain || threads.empty()) {
+		function(body, 0, count);
+		return;
+	}
+
+	// a few chunks per thread so stealing can even out uneven chunks, never smaller than grain
+	size_t thread_count = threads.size() + 1;
+	struct Ranges {
+		RangeFunction function;
+		const void* body;
+		size_t count, chunk;
+	} ranges;
+	ranges.function = function;
+	ranges.body = body;
+	ranges.count = count;
+	ranges.chunk = (count + thread_count * 4 - 1) / (thread_count * 4);
+	if (ranges.chunk < grain)
+		ranges.chunk = grain;
+
+	// two words per job, small enough for std::function to keep without allocating
+	JobCounter counter;
+	const Ranges* shared = &ranges;
+	for (size_t begin = 0; begin < count; begin += ranges.chunk) {
+		run([shared, begin] {
+			size_t end = begin + shared->chunk < shared->count ? begin + shared->chunk : shared->count;
+			shared->function(shared->body, begin, end);
+		}, &counter);
+	}
+	wait(counter);
+}
+
+unsigned JobSystem::defaultWorkerCount() {
+	unsigned hardware = std::thread::hardware_concurrency();
+	return hardware > 3 ? hardware - 2 : 1;
+}
+
+void JobSystem::workerLoop(int index) {
+	tls_system = this;
+	tls_queue = index;
+
+	for (;;) {
+		if (tryRunOne())
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this] { return quit || queued.load(std::memory_order_acquire) > 0; });
+		if (quit)
+			break;
+	}
+
+	tls_system = NULL;
+	tls_queue = -1;
+}
+
+void JobSystem::push(const QueuedJob& entry) {
+	int index = tls_system == this ? tls_queue : (int)queues.size() - 1;
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->pushBack(entry);
+	}
+	queued.fetch_add(1, std::memory_order_release);
+
+	// empty critical section so a worker between its check and its wait can't miss the signal
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::tryRunOne() {
+	int queue_count = (int)queues.size();
+	int self = tls_system == this ? tls_queue : queue_count - 1;
+	QueuedJob entry;
+	bool found = false;
+
+	// own queue from the back
+	{
+		std::lock_guard<std::mutex> lock(queues[self]->mutex);
+		found = queues[self]->popBack(entry);
+	}
+
+	// steal from the front of the others
+	for (int k = 1; k < queue_count && !found; k++) {
+		WorkQueue& victim = *queues[(self + k) % queue_count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		found = victim.popFront(entry);
+	}
+
+	if (!found)
+		return false;
+
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	entry.job();
+	finish(entry.counter);
+	return true;
+}
+
+void JobSystem::finish(JobCounter* counter) {
+	if (!counter)
+		return;
+
+	// last job of the counter releases everything that was waiting on it
+	std::vector<JobCounter::Continuation> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(counter->continuations);
+	}
+
+	// their counters were already incremented by runAfter()
+	for (size_t i = 0; i < ready.size(); i++) {
+		QueuedJob entry;
+		entry.job = ready[i].job;
+		entry.counter = ready[i].counter;
+		push(entry);
+	}
+}
+
+void JobSystem::WorkQueue::pushBack(const QueuedJob& entry) {
+	size_t capacity = ring.size();
+	if (count == capacity) {
+		// unwrapped into a ring twice the size
+		std::vector<QueuedJob> grown(capacity > 0 ? capacity * 2 : QUEUE_INITIAL_CAPACITY);
+		for (size_t i = 0; i < count; i++)
+			grown[i] = std::move(ring[(first + i) & (capacity - 1)]);
+		ring.swap(grown);
+		first = 0;
+		capacity = ring.size();
+	}
+	ring[(first + count) & (capacity - 1)] = entry;
+	count++;
+}
+
+bool JobSystem::WorkQueue::popBack(QueuedJob& entry) {
+	if (count == 0)
+		return false;
+	count--;
+	QueuedJob& slot = ring[(first + count) & (ring.size() - 1)];
+	entry = std::move(slot);
+	slot.job = nullptr;
+	return true;
+}
+
+bool JobSystem::WorkQueue::popFront(QueuedJob& entry) {
+	if (count == 0)
+		return false;
+	QueuedJob& slot = ring[first];
+	entry = std::move(slot);
+	slot.job = nullptr;
+	first = (first + 1) & (ring.size() - 1);
+	count--;
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> Job;
+
+class JobSystem;
+
+// number of unfinished jobs attached to it; jobs queued to run after it start once it reaches zero
+class JobCounter {
+public:
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation {
+		Job job;
+		JobCounter* counter;
+	};
+
+	std::atomic<int> pending{ 0 };
+	std::mutex mutex;							// guards continuations
+	std::vector<Continuation> continuations;
+};
+
+// ------------------------------------------------------------------------------------------
+// Work-stealing job system. Every worker owns a deque: it pushes and pops its own jobs at the
+// back (newest first, still warm in cache) and, when empty, steals the oldest job from the
+// front of another worker's deque. Threads that are not workers (main, render) submit into a
+// shared queue and help run jobs while they wait on a counter, so with zero workers
+// everything simply runs inline on the caller. Queues only ever grow and small jobs fit in
+// std::function's own storage, so a steady frame schedules without allocating.
+// ------------------------------------------------------------------------------------------
+class JobSystem {
+public:
+	~JobSystem() { stop(); }
+
+	void start(unsigned worker_count);
+	void stop();
+	unsigned workerCount() const { return (unsigned)threads.size(); }
+
+	// counter (optional) is incremented now and decremented when the job has finished
+	void run(const Job& job, JobCounter* counter = NULL);
+
+	// like run(), but the job is only queued once dependency has reached zero
+	void runAfter(JobCounter& dependency, const Job& job, JobCounter* counter = NULL);
+
+	// runs queued jobs on the calling thread until counter reaches zero
+	void wait(JobCounter& counter);
+
+	// body(begin, end) over [0, count) in chunks of at least grain items, returns when all are done
+	// a range no bigger than grain runs inline with no scheduling cost; body is called in place,
+	// never copied, whatever it captures
+	template <typename Body>
+	void parallelFor(size_t count, size_t grain, const Body& body) {
+		parallelRanges(count, grain, &callRange<Body>, &body);
+	}
+
+	// hardware threads left over after the main and render threads, at least one
+	static unsigned defaultWorkerCount();
+
+private:
+	struct QueuedJob {
+		Job job;
+		JobCounter* counter;
+	};
+
+	// ring of jobs, doubled when full and never shrunk
+	struct WorkQueue {
+		std::mutex mutex;
+		std::vector<QueuedJob> ring;		// size a power of two
+		size_t first = 0;
+		size_t count = 0;
+
+		void pushBack(const QueuedJob& entry);
+		bool popBack(QueuedJob& entry);
+		bool popFront(QueuedJob& entry);
+	};
+
+	typedef void (*RangeFunction)(const void* body, size_t begin, size_t end);
+
+	template <typename Body>
+	static void callRange(const void* body, size_t begin, size_t end) {
+		(*(const Body*)body)(begin, end);
+	}
+
+	void parallelRanges(size_t count, size_t grain, RangeFunction function, const void* body);
+
+	void workerLoop(int index);
+	void push(const QueuedJob& entry);
+	bool tryRunOne();
+	void finish(JobCounter* counter);
+
+	// queues[0..workers-1] belong to the workers, the last one takes submissions from other threads
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> threads;
+
+	std::atomic<int> queued{ 0 };		// jobs sitting in any queue, lets idle workers sleep
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool quit = false;					// guarded by sleep_mutex
+};
@@ -0,0 +1,233 @@
+#include "LightGrid.h"
+#include "JobSystem.h"
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define LIGHT_GRID_USE_SSE 1
+#endif
+
+// lights per job, below this the whole grid is built on the calling thread
+static const size_t LIGHT_JOB_GRAIN = 256;
+
+// first and last tile between consecutive boundary planes that a sphere reaches, first > last for none
+static void tileRange(const glm::vec4* planes, int tile_count, const glm::vec3& center, float radius, int& first, int& last) {
+	first = tile_count;
+	last = -1;
+
+	float previous = glm::dot(glm::vec3(planes[0]), center) + planes[0].w;
+	for (int k = 0; k < tile_count; k++) {
+		float next = glm::dot(glm::vec3(planes[k + 1]), center) + planes[k + 1].w;
+		if (previous > -radius && next < radius) {
+			if (k < first) first = k;
+			last = k;
+		}
+		previous = next;
+	}
+}
+
+#ifdef LIGHT_GRID_USE_SSE
+// tileRange() for four spheres, first / last come back as floats
+static void tileRange4(const glm::vec4* planes, int tile_count, __m128 x, __m128 y, __m128 z, __m128 r, __m128& first, __m128& last) {
+	__m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), r);
+	__m128 none_first = _mm_set1_ps((float)tile_count);
+	__m128 none_last = _mm_set1_ps(-1.0f);
+	first = none_first;
+	last = none_last;
+
+	__m128 previous = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[0].x), x), _mm_mul_ps(_mm_set1_ps(planes[0].y), y)),
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[0].z), z), _mm_set1_ps(planes[0].w)));
+	for (int k = 0; k < tile_count; k++) {
+		const glm::vec4& plane = planes[k + 1];
+		__m128 next = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w)));
+
+		__m128 overlap = _mm_and_ps(_mm_cmpgt_ps(previous, neg_r), _mm_cmplt_ps(next, r));
+		__m128 tile = _mm_set1_ps((float)k);
+		first = _mm_min_ps(first, _mm_or_ps(_mm_and_ps(overlap, tile), _mm_andnot_ps(overlap, none_first)));
+		last = _mm_max_ps(last, _mm_or_ps(_mm_and_ps(overlap, tile), _mm_andnot_ps(overlap, none_last)));
+		previous = next;
+	}
+}
+#endif
+
+void LightGrid::build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, JobSystem* jobs) {
+	// near / far back out of the projection: glm's perspective has -1 in [2][3], ortho 0
+	bool perspective = projection[2][3] != 0.0f;
+	if (perspective) {
+		near_depth = projection[3][2] / (projection[2][2] - 1.0f);
+		far_depth = projection[3][2] / (projection[2][2] + 1.0f);
+		float log_ratio = logf(far_depth / near_depth);
+		slicing = glm::vec4(LIGHT_GRID_Z / log_ratio, -LIGHT_GRID_Z * logf(near_depth) / log_ratio, 1.0f, 0.0f);
+	}
+	else {
+		near_depth = (projection[3][2] + 1.0f) / projection[2][2];
+		far_depth = (projection[3][2] - 1.0f) / projection[2][2];
+		float scale = LIGHT_GRID_Z / (far_depth - near_depth);
+		slicing = glm::vec4(scale, -near_depth * scale, 0.0f, 0.0f);
+	}
+
+	// x_ndc >= t  <=>  (row0 - t * row3) . p >= 0, in world space through the view-projection
+	glm::mat4 m = projection * view;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	for (int k = 0; k <= LIGHT_GRID_X; k++) {
+		planes_x[k] = row0 - (-1.0f + 2.0f * k / LIGHT_GRID_X) * row3;
+		planes_x[k] = planes_x[k] / glm::length(glm::vec3(planes_x[k]));
+	}
+	for (int k = 0; k <= LIGHT_GRID_Y; k++) {
+		planes_y[k] = row1 - (-1.0f + 2.0f * k / LIGHT_GRID_Y) * row3;
+		planes_y[k] = planes_y[k] / glm::length(glm::vec3(planes_y[k]));
+	}
+	depth_plane = glm::vec4(-view[0][2], -view[1][2], -view[2][2], -view[3][2]);
+
+	size_t light_count = lights.size();
+	center_x.resize(light_count);
+	center_y.resize(light_count);
+	center_z.resize(light_count);
+	radius.resize(light_count);
+	for (size_t i = 0; i < light_count; i++) {
+		center_x[i] = lights[i].position.x;
+		center_y[i] = lights[i].position.y;
+		center_z[i] = lights[i].position.z;
+		radius[i] = lights[i].radius;
+	}
+	boxes.resize(light_count);
+	ranges.resize(LIGHT_GRID_CLUSTERS * 2);
+
+	// a handful of lights isn't worth waking the workers
+	if (light_count < LIGHT_JOB_GRAIN)
+		jobs = NULL;
+
+	if (jobs) {
+		jobs->parallelFor(light_count, LIGHT_JOB_GRAIN, [this](size_t begin, size_t end) { boxLights(begin, end); });
+		jobs->parallelFor(LIGHT_GRID_Z, 1, [this](size_t begin, size_t end) { countSlices(begin, end); });
+	}
+	else {
+		boxLights(0, light_count);
+		countSlices(0, LIGHT_GRID_Z);
+	}
+
+	// counts become offsets; past the budget the remaining clusters keep what still fits
+	uint32_t offset = 0;
+	for (int c = 0; c < LIGHT_GRID_CLUSTERS; c++) {
+		uint32_t count = ranges[c * 2 + 1];
+		if (offset + count > LIGHT_GRID_MAX_INDICES)
+			count = (uint32_t)LIGHT_GRID_MAX_INDICES - offset;
+		ranges[c * 2] = offset;
+		ranges[c * 2 + 1] = count;
+		offset += count;
+	}
+	indices.resize(offset);
+
+	if (jobs)
+		jobs->parallelFor(LIGHT_GRID_Z, 1, [this](size_t begin, size_t end) { fillSlices(begin, end); });
+	else
+		fillSlices(0, LIGHT_GRID_Z);
+}
+
+int LightGrid::slice(float depth) const {
+	if (slicing.z > 0.5f)
+		depth = logf(depth > near_depth ? depth : near_depth);
+
+	int s = (int)floorf(depth * slicing.x + slicing.y);
+	return s < 0 ? 0 : (s >= LIGHT_GRID_Z ? LIGHT_GRID_Z - 1 : s);
+}
+
+void LightGrid::boxLights(size_t begin, size_t end) {
+	size_t i = begin;
+
+#ifdef LIGHT_GRID_USE_SSE
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&center_x[i]);
+		__m128 y = _mm_loadu_ps(&center_y[i]);
+		__m128 z = _mm_loadu_ps(&center_z[i]);
+		__m128 r = _mm_loadu_ps(&radius[i]);
+
+		float x0[4], x1[4], y0[4], y1[4];
+		__m128 first, last;
+		tileRange4(planes_x, LIGHT_GRID_X, x, y, z, r, first, last);
+		_mm_storeu_ps(x0, first);
+		_mm_storeu_ps(x1, last);
+		tileRange4(planes_y, LIGHT_GRID_Y, x, y, z, r, first, last);
+		_mm_storeu_ps(y0, first);
+		_mm_storeu_ps(y1, last);
+
+		for (int k = 0; k < 4; k++) {
+			boxes[i + k].x0 = (int16_t)x0[k];
+			boxes[i + k].x1 = (int16_t)x1[k];
+			boxes[i + k].y0 = (int16_t)y0[k];
+			boxes[i + k].y1 = (int16_t)y1[k];
+		}
+	}
+#endif
+
+	// remainder (or everything, without SSE)
+	for (; i < end; i++) {
+		glm::vec3 center(center_x[i], center_y[i], center_z[i]);
+		int first, last;
+		tileRange(planes_x, LIGHT_GRID_X, center, radius[i], first, last);
+		boxes[i].x0 = (int16_t)first;
+		boxes[i].x1 = (int16_t)last;
+		tileRange(planes_y, LIGHT_GRID_Y, center, radius[i], first, last);
+		boxes[i].y0 = (int16_t)first;
+		boxes[i].y1 = (int16_t)last;
+	}
+
+	// slices from the view depth range, nothing for lights wholly in front of near or past far
+	for (i = begin; i < end; i++) {
+		float depth = depth_plane.x * center_x[i] + depth_plane.y * center_y[i] + depth_plane.z * center_z[i] + depth_plane.w;
+		if (depth + radius[i] < near_depth || depth - radius[i] > far_depth) {
+			boxes[i].x0 = 1;
+			boxes[i].x1 = 0;
+		}
+		boxes[i].z0 = (int16_t)slice(depth - radius[i]);
+		boxes[i].z1 = (int16_t)slice(depth + radius[i]);
+	}
+}
+
+void LightGrid::countSlices(size_t begin, size_t end) {
+	const int slice_clusters = LIGHT_GRID_X * LIGHT_GRID_Y;
+
+	for (size_t s = begin; s < end; s++) {
+		uint32_t* counts = &ranges[s * slice_clusters * 2];
+		for (int c = 0; c < slice_clusters; c++)
+			counts[c * 2 + 1] = 0;
+
+		for (size_t i = 0; i < boxes.size(); i++) {
+			const LightBox& box = boxes[i];
+			if (box.x0 > box.x1 || box.y0 > box.y1 || (int)s < box.z0 || (int)s > box.z1) continue;
+
+			for (int y = box.y0; y <= box.y1; y++)
+				for (int x = box.x0; x <= box.x1; x++)
+					counts[(y * LIGHT_GRID_X + x) * 2 + 1]++;
+		}
+	}
+}
+
+void LightGrid::fillSlices(size_t begin, size_t end) {
+	const int slice_clusters = LIGHT_GRID_X * LIGHT_GRID_Y;
+	uint32_t filled[LIGHT_GRID_X * LIGHT_GRID_Y];
+
+	for (size_t s = begin; s < end; s++) {
+		const uint32_t* slice_ranges = &ranges[s * slice_clusters * 2];
+		for (int c = 0; c < slice_clusters; c++)
+			filled[c] = 0;
+
+		for (size_t i = 0; i < boxes.size(); i++) {
+			const LightBox& box = boxes[i];
+			if (box.x0 > box.x1 || box.y0 > box.y1 || (int)s < box.z0 || (int)s > box.z1) continue;
+
+			for (int y = box.y0; y <= box.y1; y++) {
+				for (int x = box.x0; x <= box.x1; x++) {
+					int c = y * LIGHT_GRID_X + x;
+					if (filled[c] < slice_ranges[c * 2 + 1])
+						indices[slice_ranges[c * 2] + filled[c]++] = (uint16_t)i;
+				}
+			}
+		}
+	}
+}
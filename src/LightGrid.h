@@ -0,0 +1,70 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+
+class JobSystem;
+
+// one point light, laid out as shader.frag reads it from u_lights (two RGBA32F texels) and
+// deferred_light.vert from its instanced attributes
+struct PointLight {
+	glm::vec3 position;
+	float radius;			// no light past this distance
+	glm::vec3 color;
+	float intensity;
+};
+
+// froxel grid: screen tiles across, tiles up, depth slices (LIGHT_GRID_X/Y/Z in shader.frag)
+const int LIGHT_GRID_X = 16;
+const int LIGHT_GRID_Y = 16;
+const int LIGHT_GRID_Z = 24;
+const int LIGHT_GRID_CLUSTERS = LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z;
+
+// light indices per frame over all clusters, the farthest clusters lose lights past this
+const size_t LIGHT_GRID_MAX_INDICES = 65536;
+
+// ------------------------------------------------------------------------------------------
+// Clustered light lists. The view frustum is cut into LIGHT_GRID_X x LIGHT_GRID_Y tiles in NDC
+// and LIGHT_GRID_Z depth slices (logarithmic in view depth for perspective, linear for
+// orthographic), and every cluster gets the indices of the lights whose sphere reaches it, so
+// a fragment only loops over the lights near it.
+//
+// Binning is conservative: a light's tile range comes from the tile planes (four lights at a
+// time with SSE), its slice range from its depth, and it is added to the whole box of clusters.
+// Lights are spread over the job system, the per-slice counting and filling too.
+// ------------------------------------------------------------------------------------------
+class LightGrid {
+public:
+	// projection may be perspective or orthographic, lights are in world space
+	void build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, JobSystem* jobs = NULL);
+
+	// per cluster (x fastest, then y, then slice): first index into lightIndices(), count
+	const std::vector<uint32_t>& clusterRanges() const { return ranges; }
+	const std::vector<uint16_t>& lightIndices() const { return indices; }
+
+	// slice = floor((log) view depth * x + y), z = 1 for logarithmic slices
+	const glm::vec4& depthSlicing() const { return slicing; }
+
+private:
+	struct LightBox {
+		int16_t x0, x1, y0, y1, z0, z1;		// inclusive cluster ranges, x0 > x1 when off screen
+	};
+
+	void boxLights(size_t begin, size_t end);
+	int slice(float depth) const;
+	void countSlices(size_t begin, size_t end);
+	void fillSlices(size_t begin, size_t end);
+
+	// this build's frustum: unit-length planes of the tile boundaries (x = -1 + 2k / LIGHT_GRID_X
+	// in NDC, >= 0 on the +x side, same for y), view depth as a plane, depth range
+	glm::vec4 planes_x[LIGHT_GRID_X + 1];
+	glm::vec4 planes_y[LIGHT_GRID_Y + 1];
+	glm::vec4 depth_plane;
+	float near_depth = 0.0f, far_depth = 0.0f;
+
+	std::vector<float> center_x, center_y, center_z, radius;	// SoA copy of the lights for SSE
+	std::vector<LightBox> boxes;
+	std::vector<uint32_t> ranges;
+	std::vector<uint16_t> indices;
+	glm::vec4 slicing = glm::vec4(0.0f);
+};
@@ -0,0 +1,201 @@
+#include "Log.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+// records per thread, a power of two; a thread that logs faster than the writer drains loses the rest
+static const uint32_t RING_RECORDS = 256;
+
+// how long the writer sleeps when every ring is empty
+static const int WRITER_IDLE_MS = 5;
+
+static_assert(sizeof(LogRecord) == LOG_RECORD_SIZE, "LogRecord must fill LOG_RECORD_SIZE");
+
+// single producer (the owning thread), single consumer (the writer)
+struct LogRing {
+	LogRecord records[RING_RECORDS];
+	std::atomic<uint32_t> head{ 0 };	// next record to write, owning thread
+	std::atomic<uint32_t> tail{ 0 };	// next record to read, writer thread
+	LogRing* next = NULL;				// all rings, newest first
+};
+
+// rings are never freed: a thread's ring outlives it until the writer has drained it
+static std::atomic<LogRing*> rings(NULL);
+static thread_local LogRing* tls_ring = NULL;
+
+static std::atomic<uint64_t> next_sequence(0);
+static std::atomic<uint64_t> dropped(0);
+static std::atomic<int> runtime_level(LOG_LEVEL_DEBUG);
+
+static std::thread writer;
+static std::atomic<bool> writer_quit(false);
+
+static LogRing* threadRing() {
+	if (!tls_ring) {
+		// once per thread, pushed with a compare-exchange so registering never locks
+		LogRing* ring = new LogRing();
+		ring->next = rings.load(std::memory_order_relaxed);
+		while (!rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed)) {}
+		tls_ring = ring;
+	}
+	return tls_ring;
+}
+
+LogRecord* logBegin(LogLevel level, const char* format) {
+	if (level < runtime_level.load(std::memory_order_relaxed))
+		return NULL;
+
+	LogRing* ring = threadRing();
+	uint32_t head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) == RING_RECORDS) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	LogRecord& record = ring->records[head & (RING_RECORDS - 1)];
+	record.header.format = format;
+	record.header.sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+	record.header.level = (uint8_t)level;
+	record.header.arg_count = 0;
+	record.header.size = 0;
+	return &record;
+}
+
+void logCommit() {
+	LogRing* ring = tls_ring;
+	ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void setLogLevel(LogLevel level) {
+	runtime_level.store(level, std::memory_order_relaxed);
+}
+
+// appends at most capacity - 1 characters and keeps the line terminated
+struct LineBuffer {
+	char text[1024];
+	size_t length = 0;
+
+	void append(const char* chars, size_t count) {
+		if (count > sizeof(text) - 1 - length)
+			count = sizeof(text) - 1 - length;
+		memcpy(text + length, chars, count);
+		length += count;
+	}
+};
+
+static void formatRecord(const LogRecord& record, LineBuffer& line) {
+	static const char* const prefixes[4] = { "", "", "warning: ", "error: " };
+	const char* prefix = prefixes[record.header.level & 3];
+	line.append(prefix, strlen(prefix));
+
+	const unsigned char* payload = record.payload;
+	int arg = 0;
+	for (const char* c = record.header.format; *c; c++) {
+		if (c[0] != '{' || c[1] != '}' || arg == record.header.arg_count) {
+			line.append(c, 1);
+			continue;
+		}
+		c++;
+
+		char number[32];
+		int count = 0;
+		switch (record.header.types[arg++]) {
+		case LOG_ARG_INT: {
+			int64_t value;
+			memcpy(&value, payload, sizeof(value));
+			payload += sizeof(value);
+			count = snprintf(number, sizeof(number), "%lld", (long long)value);
+			break;
+		}
+		case LOG_ARG_UINT: {
+			uint64_t value;
+			memcpy(&value, payload, sizeof(value));
+			payload += sizeof(value);
+			count = snprintf(number, sizeof(number), "%llu", (unsigned long long)value);
+			break;
+		}
+		case LOG_ARG_DOUBLE: {
+			double value;
+			memcpy(&value, payload, sizeof(value));
+			payload += sizeof(value);
+			count = snprintf(number, sizeof(number), "%g", value);
+			break;
+		}
+		default: {
+			uint16_t length;
+			memcpy(&length, payload, sizeof(length));
+			line.append((const char*)payload + sizeof(length), length);
+			payload += sizeof(length) + length;
+			break;
+		}
+		}
+		if (count > 0)
+			line.append(number, (size_t)count < sizeof(number) ? count : sizeof(number) - 1);
+	}
+	line.append("\n", 1);
+}
+
+// writes every committed record, oldest sequence first across the rings; false if there were none
+static bool drainRings() {
+	bool wrote = false;
+	for (;;) {
+		// the ring whose next record is the oldest
+		LogRing* oldest = NULL;
+		uint64_t oldest_sequence = 0;
+		for (LogRing* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+			uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+			if (tail == ring->head.load(std::memory_order_acquire))
+				continue;
+			uint64_t sequence = ring->records[tail & (RING_RECORDS - 1)].header.sequence;
+			if (!oldest || sequence < oldest_sequence) {
+				oldest = ring;
+				oldest_sequence = sequence;
+			}
+		}
+		if (!oldest)
+			break;
+
+		uint32_t tail = oldest->tail.load(std::memory_order_relaxed);
+		LineBuffer line;
+		formatRecord(oldest->records[tail & (RING_RECORDS - 1)], line);
+		oldest->tail.store(tail + 1, std::memory_order_release);
+
+		fwrite(line.text, 1, line.length, stdout);
+		wrote = true;
+	}
+
+	uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+	if (lost > 0) {
+		fprintf(stdout, "log: %llu records dropped, ring full\n", (unsigned long long)lost);
+		wrote = true;
+	}
+
+	// one flush for the whole batch
+	if (wrote)
+		fflush(stdout);
+	return wrote;
+}
+
+static void writerLoop() {
+	while (!writer_quit.load(std::memory_order_acquire)) {
+		if (!drainRings())
+			std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_IDLE_MS));
+	}
+	drainRings();
+}
+
+void startLogging() {
+	if (writer.joinable())
+		return;
+	writer_quit.store(false, std::memory_order_relaxed);
+	writer = std::thread(writerLoop);
+}
+
+void stopLogging() {
+	if (!writer.joinable())
+		return;
+	writer_quit.store(true, std::memory_order_release);
+	writer.join();
+}
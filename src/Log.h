@@ -0,0 +1,144 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+// ------------------------------------------------------------------------------------------
+// Asynchronous logging. A log call copies its format string pointer and arguments into a
+// fixed-size binary record in a ring owned by the calling thread and returns; a writer thread
+// formats the records and writes them in batches, one flush per batch. Nothing on the
+// logging side locks or waits: a full ring drops the record and counts it.
+//
+//	LOG_INFO("texture array: {} layers of {}x{}", count, size, size);
+//
+// {} is replaced by the next argument, printed as cout would: integers, bool (0 / 1),
+// floating point (6 significant digits), const char* and std::string (copied, truncated to
+// what fits in the record). The format must be a string literal, only its pointer is kept.
+// ------------------------------------------------------------------------------------------
+
+enum LogLevel {
+	LOG_LEVEL_DEBUG,		// key presses and other chatter
+	LOG_LEVEL_INFO,			// what was loaded and chosen
+	LOG_LEVEL_WARNING,		// something fell back to a slower or simpler path
+	LOG_LEVEL_ERROR
+};
+
+// records below this level compile to nothing: set it with /D LOG_COMPILE_LEVEL=...
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_AT(level, ...) do { if ((level) >= LOG_COMPILE_LEVEL) logRecord((level), __VA_ARGS__); } while (0)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// starts the writer thread; records logged before are kept until it runs (as many as fit)
+void startLogging();
+
+// writes out everything logged so far and stops the writer thread
+void stopLogging();
+
+// records below level are dropped when logged, on top of LOG_COMPILE_LEVEL
+void setLogLevel(LogLevel level);
+
+// ------------------------------------------------------------------------------------------
+// record encoding, used by the macros
+// ------------------------------------------------------------------------------------------
+
+const int LOG_MAX_ARGS = 12;
+const int LOG_RECORD_SIZE = 256;
+
+enum LogArgType {
+	LOG_ARG_INT,			// int64_t
+	LOG_ARG_UINT,			// uint64_t
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STRING			// uint16_t length, then the characters
+};
+
+struct LogRecordHeader {
+	const char* format;
+	uint64_t sequence;		// order across threads
+	uint8_t level;
+	uint8_t arg_count;
+	uint16_t size;			// payload bytes used
+	uint8_t types[LOG_MAX_ARGS];
+};
+
+struct LogRecord {
+	LogRecordHeader header;
+	unsigned char payload[LOG_RECORD_SIZE - sizeof(LogRecordHeader)];
+};
+
+// a record in the calling thread's ring, NULL when the level is filtered out or the ring is full
+LogRecord* logBegin(LogLevel level, const char* format);
+
+// hands the record from logBegin() to the writer thread
+void logCommit();
+
+inline void logAppend(LogRecord& record, LogArgType type, const void* data, size_t size) {
+	if (record.header.arg_count == LOG_MAX_ARGS || record.header.size + size > sizeof(record.payload))
+		return;
+	record.header.types[record.header.arg_count++] = (uint8_t)type;
+	memcpy(record.payload + record.header.size, data, size);
+	record.header.size = (uint16_t)(record.header.size + size);
+}
+
+inline void logAppendString(LogRecord& record, const char* text, size_t length) {
+	size_t room = sizeof(record.payload) - record.header.size;
+	if (record.header.arg_count == LOG_MAX_ARGS || room < sizeof(uint16_t))
+		return;
+	if (length > room - sizeof(uint16_t))
+		length = room - sizeof(uint16_t);
+	uint16_t stored = (uint16_t)length;
+	record.header.types[record.header.arg_count++] = (uint8_t)LOG_ARG_STRING;
+	memcpy(record.payload + record.header.size, &stored, sizeof(stored));
+	memcpy(record.payload + record.header.size + sizeof(stored), text, length);
+	record.header.size = (uint16_t)(record.header.size + sizeof(stored) + length);
+}
+
+inline void logArg(LogRecord& record, const char* text) { logAppendString(record, text ? text : "(null)", text ? strlen(text) : 6); }
+inline void logArg(LogRecord& record, const std::string& text) { logAppendString(record, text.data(), text.size()); }
+inline void logArg(LogRecord& record, bool value) { int64_t v = value ? 1 : 0; logAppend(record, LOG_ARG_INT, &v, sizeof(v)); }
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type logArg(LogRecord& record, T value) {
+	double v = value;
+	logAppend(record, LOG_ARG_DOUBLE, &v, sizeof(v));
+}
+
+template <typename T>
+typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value) || std::is_enum<T>::value>::type logArg(LogRecord& record, T value) {
+	int64_t v = (int64_t)value;
+	logAppend(record, LOG_ARG_INT, &v, sizeof(v));
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T, bool>::value>::type logArg(LogRecord& record, T value) {
+	uint64_t v = value;
+	logAppend(record, LOG_ARG_UINT, &v, sizeof(v));
+}
+
+inline void logArgs(LogRecord&) {}
+
+template <typename T, typename... Rest>
+void logArgs(LogRecord& record, const T& first, const Rest&... rest) {
+	logArg(record, first);
+	logArgs(record, rest...);
+}
+
+template <typename... Args>
+void logRecord(LogLevel level, const char* format, const Args&... args) {
+	static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+	LogRecord* record = logBegin(level, format);
+	if (!record)
+		return;
+	logArgs(*record, args...);
+	logCommit();
+}
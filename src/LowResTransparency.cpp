@@ -0,0 +1,185 @@
+#include "LowResTransparency.h"
+#include "CommandBuffer.h"	// FRAME_DATA_BINDING
+#include "Shader.h"
+
+// low-res color, low-res depth, scene depth, weights; clear of the scene's, the G-buffer's and the upscale's
+static const GLint LOWRES_UNIT = 13;
+
+static bool linked(GLuint program) {
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+bool LowResTransparency::create() {
+	Shader depth_shader("src/hiz.vert", "src/lowres_depth.frag");
+	Shader composite_shader("src/hiz.vert", "src/lowres_composite.frag");
+	if (!linked(depth_shader.program) || !linked(composite_shader.program)) {
+		glDeleteProgram(depth_shader.program);
+		glDeleteProgram(composite_shader.program);
+		return false;
+	}
+
+	if (depth_program) glDeleteProgram(depth_program);
+	if (composite_program) glDeleteProgram(composite_program);
+	depth_program = depth_shader.program;
+	composite_program = composite_shader.program;
+
+	glUseProgram(depth_program);
+	glUniform1i(glGetUniformLocation(depth_program, "u_depth"), LOWRES_UNIT + 2);
+	factor_loc = glGetUniformLocation(depth_program, "u_factor");
+
+	glUseProgram(composite_program);
+	glUniform1i(glGetUniformLocation(composite_program, "u_color"), LOWRES_UNIT);
+	glUniform1i(glGetUniformLocation(composite_program, "u_low_depth"), LOWRES_UNIT + 1);
+	glUniform1i(glGetUniformLocation(composite_program, "u_depth"), LOWRES_UNIT + 2);
+	glUniform1i(glGetUniformLocation(composite_program, "u_weights"), LOWRES_UNIT + 3);
+	weighted_loc = glGetUniformLocation(composite_program, "u_weighted");
+	GLuint frame_block = glGetUniformBlockIndex(composite_program, "FrameData");
+	if (frame_block != GL_INVALID_INDEX)
+		glUniformBlockBinding(composite_program, frame_block, FRAME_DATA_BINDING);
+	glUseProgram(0);
+
+	if (!vao) {
+		glGenVertexArrays(1, &vao);
+		glGenFramebuffers(1, &framebuffer);
+		glGenFramebuffers(1, &composite_framebuffer);
+	}
+	return true;
+}
+
+void LowResTransparency::destroy() {
+	if (depth_program) glDeleteProgram(depth_program);
+	if (composite_program) glDeleteProgram(composite_program);
+	if (vao) {
+		glDeleteVertexArrays(1, &vao);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteFramebuffers(1, &composite_framebuffer);
+	}
+	if (color) glDeleteTextures(1, &color);
+	if (weights) glDeleteTextures(1, &weights);
+	if (depth) glDeleteTextures(1, &depth);
+	depth_program = composite_program = 0;
+	factor_loc = weighted_loc = -1;
+	vao = framebuffer = composite_framebuffer = color = weights = depth = 0;
+	target_width = target_height = 0;
+}
+
+void LowResTransparency::resize(int width, int height) {
+	target_width = width;
+	target_height = height;
+
+	if (color) glDeleteTextures(1, &color);
+	if (weights) glDeleteTextures(1, &weights);
+	if (depth) glDeleteTextures(1, &depth);
+
+	// filtered for the bilinear composite
+	GLuint* targets[2] = { &color, &weights };
+	static const GLenum formats[2] = { GL_RGBA16F, GL_R16F };
+	for (int i = 0; i < 2; i++) {
+		glGenTextures(1, targets[i]);
+		glBindTexture(GL_TEXTURE_2D, *targets[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	}
+
+	glGenTextures(1, &depth);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weights, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+}
+
+void LowResTransparency::setBlending(bool weighted) {
+	glEnable(GL_BLEND);
+	if (weighted)
+		glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+	else
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void LowResTransparency::begin(GLuint scene_depth, int width, int height, int divisor, bool weighted) {
+	scene_width = width;
+	scene_height = height;
+	weighted_pass = weighted;
+	int low_width = (width + divisor - 1) / divisor;
+	int low_height = (height + divisor - 1) / divisor;
+	if (low_width != target_width || low_height != target_height)
+		resize(low_width, low_height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, target_width, target_height);
+	static const GLenum draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(weighted ? 2 : 1, draw_buffers);
+
+	glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT + 2);
+	glBindTexture(GL_TEXTURE_2D, scene_depth);
+	glActiveTexture(GL_TEXTURE0);
+
+	// every texel written, the depth test passes everything
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDisable(GL_BLEND);
+	glUseProgram(depth_program);
+	glUniform1i(factor_loc, divisor);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	// the composite matches against this depth, so the blended draws leave it alone
+	glDepthMask(GL_FALSE);
+
+	// nothing covered: no color, revealage 1 when weighted
+	GLfloat clear[4] = { 0.0f, 0.0f, 0.0f, weighted ? 1.0f : 0.0f };
+	GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, clear);
+	if (weighted)
+		glClearBufferfv(GL_COLOR, 1, zero);
+}
+
+void LowResTransparency::composite(GLuint scene_color, GLuint scene) {
+	// attached every time, the scene's color is reallocated whenever its size changes
+	glBindFramebuffer(GL_FRAMEBUFFER, composite_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scene_color, 0);
+	glViewport(0, 0, scene_width, scene_height);
+
+	glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT);
+	glBindTexture(GL_TEXTURE_2D, color);
+	glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT + 1);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glActiveTexture(GL_TEXTURE0 + LOWRES_UNIT + 3);
+	glBindTexture(GL_TEXTURE_2D, weights);
+	glActiveTexture(GL_TEXTURE0);
+
+	// premultiplied over the scene, every pixel once; no depth attached, nothing to test
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(composite_program);
+	glUniform1i(weighted_loc, weighted_pass ? 1 : 0);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, scene);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <GL/glew.h>
+
+// ------------------------------------------------------------------------------------------
+// Transparent draws and particles at a half or a quarter of the scene's resolution: the scene's
+// depth is reduced to the smaller size (farthest of each block, so nothing behind an edge is
+// lost), blended draws go into a premultiplied color target tested against it, and the result is
+// composited over the scene. The composite blends bilinearly where the four low-res depths around
+// a pixel match its own, and across depth edges takes the one nearest to it, so the soft target
+// doesn't bleed over the sharp opaque silhouettes in front of it.
+//
+// With weighted blending (McGuire and Bavoil 2013) the draws need no order: the color target
+// accumulates weighted premultiplied color with the revealage (product of 1 - alpha) in its alpha,
+// a second target sums the weights, and the composite divides them out. Divisor 1 is then
+// allowed, for order-independent transparency at the scene's size.
+// ------------------------------------------------------------------------------------------
+class LowResTransparency {
+public:
+	// builds the programs (hiz.vert with lowres_depth.frag / lowres_composite.frag); again on a
+	// shader reload, false when the shaders fail (ready() stays false, the passes stay full size)
+	bool create();
+	void destroy();
+
+	bool ready() const { return depth_program != 0 && composite_program != 0; }
+
+	// reduces scene_depth (a depth texture of width x height) by divisor (1, 2 or 4), then binds
+	// and clears the low-res target with its viewport; blended draws go in until composite() with
+	// depth writes off, and with the blending of setBlending(weighted)
+	// changes program, vao, depth / blend state and texture unit 13 to 16
+	void begin(GLuint scene_depth, int width, int height, int divisor, bool weighted);
+
+	// blending for the draws into the target: premultiplied alpha, or the weighted sums (the
+	// shaders' u_weighted_blend writes the weights to the second output)
+	static void setBlending(bool weighted);
+
+	// blends the low-res target over scene_color, through a framebuffer of its own so the scene's
+	// depth isn't attached while it is sampled; then scene (the framebuffer both belong to) is left
+	// bound with its viewport, depth test, depth writes and culling on, blending off
+	void composite(GLuint scene_color, GLuint scene);
+
+	int width() const { return target_width; }
+	int height() const { return target_height; }
+
+private:
+	void resize(int width, int height);
+
+	GLuint depth_program = 0;
+	GLint factor_loc = -1;
+	GLuint composite_program = 0;
+	GLint weighted_loc = -1;
+	GLuint vao = 0;					// empty, the triangles come from gl_VertexID
+
+	GLuint framebuffer = 0;
+	GLuint composite_framebuffer = 0;	// the scene's color only, attached per composite
+	GLuint color = 0;				// RGBA16F, premultiplied; weighted: revealage in alpha
+	GLuint weights = 0;				// R16F, summed weights, weighted blending only
+	GLuint depth = 0;				// farthest scene depth of each block
+	int target_width = 0, target_height = 0;
+	int scene_width = 0, scene_height = 0;
+	bool weighted_pass = false;
+};
@@ -0,0 +1,122 @@
+#include "Memory.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+static std::atomic<uint64_t> allocation_count(0);
+static std::atomic<AllocationHook> allocation_hook(NULL);
+
+uint64_t allocationCount() {
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+void setAllocationHook(AllocationHook hook) {
+	allocation_hook.store(hook, std::memory_order_relaxed);
+}
+
+static void* countedAllocate(size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	AllocationHook hook = allocation_hook.load(std::memory_order_relaxed);
+	if (hook)
+		hook(size);
+	return malloc(size > 0 ? size : 1);
+}
+
+// the replaceable global operators, over malloc / free
+
+void* operator new(size_t size) {
+	void* memory = countedAllocate(size);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	void* memory = countedAllocate(size);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return countedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+// spills and regrowth round up to this, so a frame a little bigger than the last doesn't regrow again
+static const size_t ARENA_GRANULE = 64 * 1024;
+
+static size_t roundToGranule(size_t size) {
+	return (size + ARENA_GRANULE - 1) / ARENA_GRANULE * ARENA_GRANULE;
+}
+
+FrameArena::FrameArena(size_t capacity) : block(NULL), block_size(0), offset(0), used_bytes(0) {
+	if (capacity > 0) {
+		block_size = roundToGranule(capacity);
+		block = (char*)::operator new(block_size);
+	}
+}
+
+FrameArena::~FrameArena() {
+	for (size_t i = 0; i < spills.size(); i++)
+		::operator delete(spills[i]);
+	::operator delete(block);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+	size_t start = (offset + alignment - 1) & ~(alignment - 1);
+	if (start + size <= block_size) {
+		used_bytes += start + size - offset;
+		offset = start + size;
+		return block + start;
+	}
+
+	// operator new is aligned for any fundamental type
+	void* memory = ::operator new(size > 0 ? size : 1);
+	spills.push_back(memory);
+	used_bytes += size + alignment;
+	return memory;
+}
+
+void FrameArena::reset() {
+	if (!spills.empty()) {
+		for (size_t i = 0; i < spills.size(); i++)
+			::operator delete(spills[i]);
+		spills.clear();
+
+		// the whole frame fits in one block from now on
+		::operator delete(block);
+		block_size = roundToGranule(used_bytes);
+		block = (char*)::operator new(block_size);
+	}
+	offset = 0;
+	used_bytes = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------
+// Allocation tracking. Memory.cpp replaces the global operator new / delete, so every heap
+// allocation made through them, on any thread, is counted. The steady state of a frame is
+// meant to allocate nothing: the benchmark checks it, C prints the last frame's count.
+// ------------------------------------------------------------------------------------------
+
+// called on every counted allocation with its size, from the allocating thread; it must not
+// allocate itself (a place for a breakpoint while hunting down an allocation)
+typedef void (*AllocationHook)(size_t size);
+
+// allocations since the program started, all threads
+uint64_t allocationCount();
+
+// NULL to remove it
+void setAllocationHook(AllocationHook hook);
+
+// allocations made on any thread since it was constructed
+class AllocationScope {
+public:
+	AllocationScope() : start(allocationCount()) {}
+	uint64_t count() const { return allocationCount() - start; }
+
+private:
+	uint64_t start;
+};
+
+// ------------------------------------------------------------------------------------------
+// Linear allocator for one frame's transient data: allocations bump an offset into one block
+// and are all released by reset(), nothing is destroyed. A frame that doesn't fit spills into
+// the heap, and the next reset() regrows the block to the frame's size, so allocations stop
+// after the first few frames. One thread only; each thread that builds frame data owns one.
+// ------------------------------------------------------------------------------------------
+class FrameArena {
+public:
+	explicit FrameArena(size_t capacity = 0);
+	~FrameArena();
+
+	// size bytes, aligned to alignment (a power of two up to alignof(max_align_t)), valid until reset()
+	void* allocate(size_t size, size_t alignment);
+
+	// count uninitialized elements, valid until reset()
+	template <typename T>
+	T* allocateArray(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+		return (T*)allocate(count * sizeof(T), alignof(T));
+	}
+
+	// releases everything allocated since the last reset
+	void reset();
+
+	size_t used() const { return used_bytes; }		// since the last reset, spills included
+	size_t capacity() const { return block_size; }
+
+private:
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	char* block;
+	size_t block_size;
+	size_t offset;
+	size_t used_bytes;
+	std::vector<void*> spills;		// heap allocations that didn't fit, freed by reset()
+};
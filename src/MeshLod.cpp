@@ -0,0 +1,281 @@
+#include "MeshLod.h"
+#include "MeshOptimizer.h"	// weldVertices
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <unordered_set>
+
+// meshes with fewer triangles than this are drawn as they are at any size
+static const size_t LOD_MIN_TRIANGLES = 128;
+
+// LOD 1 may move the surface by this fraction of the bounding radius, doubling per level;
+// with the pixel sizes below that stays under a pixel on screen
+static const float LOD_BASE_ERROR = 0.01f;
+
+// screen diameters (pixels) under which LOD 1, 2, 3 take over, and the hysteresis margin
+static const float LOD_PIXEL_SIZES[MAX_LODS - 1] = { 160.0f, 80.0f, 40.0f };
+static const float LOD_HYSTERESIS = 0.15f;
+
+// plane quadric, symmetric 4x4 stored as its upper triangle
+struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+	void clear() { a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0.0; }
+
+	void addPlane(double a, double b, double c, double d) {
+		a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+		b2 += b * b; bc += b * c; bd += b * d;
+		c2 += c * c; cd += c * d;
+		d2 += d * d;
+	}
+
+	void add(const Quadric& q) {
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+	}
+
+	// sum of squared distances from p to the accumulated planes
+	double evaluate(double x, double y, double z) const {
+		return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+			+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+			+ c2 * z * z + 2.0 * cd * z
+			+ d2;
+	}
+};
+
+struct Collapse {
+	unsigned int from, to;
+	double cost;
+
+	bool operator<(const Collapse& other) const { return cost < other.cost; }
+};
+
+static glm::vec3 vertexAt(const std::vector<float>& positions, unsigned int v) {
+	return glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+}
+
+static uint64_t edgeKey(unsigned int a, unsigned int b) {
+	return ((uint64_t)a << 32) | b;
+}
+
+static bool collapseFlips(const std::vector<float>& positions, const std::vector<unsigned int>& indices,
+	const std::vector<unsigned int>& triangles, unsigned int from, unsigned int to) {
+	glm::vec3 target = vertexAt(positions, to);
+
+	for (size_t t = 0; t < triangles.size(); t++) {
+		const unsigned int* tri = &indices[triangles[t] * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			continue;	// degenerates and is removed
+
+		glm::vec3 p[3], q[3];
+		for (int k = 0; k < 3; k++) {
+			p[k] = vertexAt(positions, tri[k]);
+			q[k] = tri[k] == from ? target : p[k];
+		}
+		glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+		glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+
+		// flipped, or squashed to almost nothing
+		if (glm::dot(before, after) <= 1e-3f * glm::dot(before, before))
+			return true;
+	}
+	return false;
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<float>& positions, const std::vector<float>& texcoords,
+	const std::vector<unsigned int>& source_indices, size_t target_index_count, float max_error) {
+	size_t vertex_count = positions.size() / 3;
+	double max_cost = (double)max_error * max_error;
+
+	// copies of a vertex that differ only in their normal (flat shading) become one: coarse levels
+	// are only seen from afar, where the shading difference is below a pixel
+	std::vector<unsigned int> wedge = weldVertices(positions, texcoords, true);
+	std::vector<unsigned int> indices(source_indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		indices[i] = wedge[source_indices[i]];
+
+	// topology works on positions: vertex v sits at corner[v], the first vertex at its position
+	std::vector<unsigned int> corner = weldVertices(positions, texcoords, false);
+
+	// corners on an open border, or where copies with different uvs meet (seams), never move
+	std::vector<unsigned char> locked(vertex_count, 0);
+	std::vector<unsigned int> corner_wedge(vertex_count, ~0u);
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int c = corner[indices[i]];
+		if (corner_wedge[c] == ~0u)
+			corner_wedge[c] = indices[i];
+		else if (corner_wedge[c] != indices[i])
+			locked[c] = 1;
+	}
+
+	std::unordered_set<uint64_t> edges;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (int k = 0; k < 3; k++)
+			edges.insert(edgeKey(corner[indices[i + k]], corner[indices[i + (k + 1) % 3]]));
+	}
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			unsigned int a = corner[indices[i + k]], b = corner[indices[i + (k + 1) % 3]];
+			if (!edges.count(edgeKey(b, a)))
+				locked[a] = locked[b] = 1;
+		}
+	}
+
+	// every corner starts with the planes of its triangles
+	std::vector<Quadric> quadrics(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		quadrics[v].clear();
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		glm::vec3 p0 = vertexAt(positions, indices[i]);
+		glm::vec3 normal = glm::cross(vertexAt(positions, indices[i + 1]) - p0, vertexAt(positions, indices[i + 2]) - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normal = normal / length;
+		double d = -glm::dot(normal, p0);
+		for (int k = 0; k < 3; k++)
+			quadrics[corner[indices[i + k]]].addPlane(normal.x, normal.y, normal.z, d);
+	}
+
+	std::vector<unsigned int> remap(vertex_count);
+	std::vector<unsigned char> touched(vertex_count);
+	std::vector<unsigned int> triangle_offsets(vertex_count + 1), triangle_lists;
+	std::vector<Collapse> collapses;
+
+	// passes of independent collapses, cheapest first, until the target or the error bound is hit
+	while (indices.size() > target_index_count) {
+		// triangles around each vertex
+		std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+		for (size_t i = 0; i < indices.size(); i++)
+			triangle_offsets[indices[i] + 1]++;
+		for (size_t v = 0; v < vertex_count; v++)
+			triangle_offsets[v + 1] += triangle_offsets[v];
+		triangle_lists.resize(indices.size());
+		std::vector<unsigned int> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			triangle_lists[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+		collapses.clear();
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+				for (int direction = 0; direction < 2; direction++) {
+					unsigned int from = direction ? b : a, to = direction ? a : b;
+					if (locked[corner[from]])
+						continue;
+
+					Quadric q = quadrics[corner[from]];
+					q.add(quadrics[corner[to]]);
+					glm::vec3 p = vertexAt(positions, to);
+
+					Collapse collapse;
+					collapse.from = from;
+					collapse.to = to;
+					collapse.cost = q.evaluate(p.x, p.y, p.z);
+					if (collapse.cost <= max_cost)
+						collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		for (size_t v = 0; v < vertex_count; v++) {
+			remap[v] = (unsigned int)v;
+			touched[v] = 0;
+		}
+
+		// each collapse removes about two triangles; stop taking them once that reaches the target
+		size_t triangles_left = indices.size() / 3;
+		size_t target_triangles = target_index_count / 3;
+		size_t applied = 0;
+		for (size_t c = 0; c < collapses.size() && triangles_left > target_triangles; c++) {
+			const Collapse& collapse = collapses[c];
+			if (touched[corner[collapse.from]] || touched[corner[collapse.to]])
+				continue;
+
+			std::vector<unsigned int> around(triangle_lists.begin() + triangle_offsets[collapse.from], triangle_lists.begin() + triangle_offsets[collapse.from + 1]);
+			if (collapseFlips(positions, indices, around, collapse.from, collapse.to))
+				continue;
+
+			// from is not on a seam, so it is the only copy at its corner
+			remap[collapse.from] = collapse.to;
+			quadrics[corner[collapse.to]].add(quadrics[corner[collapse.from]]);
+
+			// the ring around from changes shape, leave it alone until the next pass
+			for (size_t t = 0; t < around.size(); t++) {
+				for (int k = 0; k < 3; k++)
+					touched[corner[indices[around[t] * 3 + k]]] = 1;
+			}
+			triangles_left = triangles_left > 2 ? triangles_left - 2 : 0;
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		// apply, dropping triangles that lost an edge
+		size_t write = 0;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	return indices;
+}
+
+void generateLods(const std::vector<float>& positions, const std::vector<float>& texcoords, const std::vector<unsigned int>& indices, float radius,
+	std::vector<std::vector<unsigned int>>& lods) {
+	lods.clear();
+	if (indices.size() / 3 < LOD_MIN_TRIANGLES)
+		return;
+
+	size_t previous_size = indices.size();
+	for (int level = 1; level < MAX_LODS; level++) {
+		// always from the full mesh, so errors don't build up level over level
+		size_t target = (indices.size() >> level) / 3 * 3;
+		float max_error = radius * LOD_BASE_ERROR * (float)(1 << (level - 1));
+		std::vector<unsigned int> lod = simplifyMesh(positions, texcoords, indices, target, max_error);
+
+		// not worth a level of its own, and coarser ones won't do better
+		if (lod.size() > previous_size * 9 / 10)
+			break;
+
+		previous_size = lod.size();
+		lods.push_back(lod);
+	}
+}
+
+float projectedDiameter(const BoundingSphere& sphere, const glm::mat4& view, const glm::mat4& projection, int viewport_height) {
+	// clip w of the centre: view depth for perspective, 1 for orthographic
+	glm::vec4 view_position = view * glm::vec4(sphere.center, 1.0f);
+	float w = projection[0][3] * view_position.x + projection[1][3] * view_position.y + projection[2][3] * view_position.z + projection[3][3];
+	if (w <= sphere.radius * 0.01f)
+		return 1e9f;	// camera inside or very close, finest level
+
+	return 2.0f * sphere.radius * projection[1][1] * 0.5f * (float)viewport_height / w;
+}
+
+int selectLod(float pixel_diameter, int lod_count, int current) {
+	if (lod_count <= 1)
+		return 0;
+	if (current >= lod_count)
+		current = lod_count - 1;
+
+	// coarser while smaller than the next level's threshold less the margin
+	while (current + 1 < lod_count && pixel_diameter < LOD_PIXEL_SIZES[current] * (1.0f - LOD_HYSTERESIS))
+		current++;
+
+	// finer while bigger than this level's threshold plus the margin
+	while (current > 0 && pixel_diameter > LOD_PIXEL_SIZES[current - 1] * (1.0f + LOD_HYSTERESIS))
+		current--;
+
+	return current;
+}
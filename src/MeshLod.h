@@ -0,0 +1,40 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <vector>
+
+#include "Culling.h"	// BoundingSphere
+
+// levels per object, LOD 0 is the mesh as loaded
+const int MAX_LODS = 4;
+
+// mesh pool entries of one object's LODs, finest first
+struct MeshLodChain {
+	int count;
+	GLuint pool_mesh[MAX_LODS];
+};
+
+// ------------------------------------------------------------------------------------------
+// Quadric error metric edge collapse (Garland & Heckbert). Each vertex collapses onto one of
+// its neighbours, so the result is a new index list over the same vertex buffer and every LOD
+// of a mesh can share one vertex range in the mesh pool. Vertices on open borders and uv seams
+// never move; copies of a vertex that only differ in their normal are merged first.
+//
+// Stops at target_index_count or when the next collapse would move the surface by more than
+// max_error (object units), whichever comes first.
+// ------------------------------------------------------------------------------------------
+std::vector<unsigned int> simplifyMesh(const std::vector<float>& positions, const std::vector<float>& texcoords,
+	const std::vector<unsigned int>& indices, size_t target_index_count, float max_error);
+
+// index lists for LOD 1.. of one mesh, each about half the triangles of the one before;
+// fewer (or none) when the mesh is already small or cannot be reduced within the error bound
+void generateLods(const std::vector<float>& positions, const std::vector<float>& texcoords, const std::vector<unsigned int>& indices, float radius,
+	std::vector<std::vector<unsigned int>>& lods);
+
+// diameter of a world-space sphere on screen, in pixels
+float projectedDiameter(const BoundingSphere& sphere, const glm::mat4& view, const glm::mat4& projection, int viewport_height);
+
+// LOD for an object covering pixel_diameter pixels; current is last frame's LOD, an object has
+// to move a margin past a threshold before it switches back, so it doesn't flicker on the edge
+int selectLod(float pixel_diameter, int lod_count, int current);
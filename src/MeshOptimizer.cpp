@@ -0,0 +1,311 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+// Forsyth's scoring: an LRU cache of this many entries, recently used and rarely used vertices
+// score higher so triangles finishing off a vertex are preferred
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_DECAY_POWER = 1.5f;
+static const float FORSYTH_VALENCE_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_POWER = 0.5f;
+
+float computeAcmr(const std::vector<unsigned int>& indices, size_t vertex_count, unsigned int cache_size) {
+	if (indices.size() < 3)
+		return 0.0f;
+
+	// a vertex is in the FIFO if fewer than cache_size misses happened since it was loaded
+	std::vector<unsigned int> loaded_at(vertex_count, 0);
+	unsigned int time = cache_size + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int v = indices[i];
+		if (time - loaded_at[v] > cache_size) {
+			loaded_at[v] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+static float vertexScore(int cache_position, unsigned int remaining) {
+	if (remaining == 0)
+		return -1.0f;	// nothing left to draw with it
+
+	float score = 0.0f;
+	if (cache_position >= 0) {
+		// the last triangle's vertices get a fixed score so it isn't just reused in a strip
+		if (cache_position < 3)
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (float)(cache_position - 3) / (float)(FORSYTH_CACHE_SIZE - 3), FORSYTH_DECAY_POWER);
+	}
+	return score + FORSYTH_VALENCE_SCALE * powf((float)remaining, -FORSYTH_VALENCE_POWER);
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count) {
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	// triangles around each vertex; the first remaining[v] entries are the ones not drawn yet
+	std::vector<unsigned int> remaining(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		remaining[indices[i]]++;
+	std::vector<unsigned int> offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(triangle_count * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> vertex_scores(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		vertex_scores[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> triangle_scores(triangle_count);
+	std::vector<unsigned char> emitted(triangle_count, 0);
+	int best = 0;
+	for (size_t t = 0; t < triangle_count; t++) {
+		triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+		if (triangle_scores[t] > triangle_scores[best])
+			best = (int)t;
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(triangle_count * 3);
+	std::vector<unsigned int> cache, new_cache;
+	size_t cursor = 0;	// everything before it has been emitted
+
+	for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+		// nothing in the cache has triangles left: continue with the next unused one in input order
+		if (best < 0) {
+			while (emitted[cursor])
+				cursor++;
+			best = (int)cursor;
+		}
+
+		const unsigned int* triangle = &indices[best * 3];
+		result.push_back(triangle[0]);
+		result.push_back(triangle[1]);
+		result.push_back(triangle[2]);
+		emitted[best] = 1;
+
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = triangle[k];
+			unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++) {
+				if (list[j] == (unsigned int)best) {
+					list[j] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// the triangle's vertices move to the front, the rest shift back, the oldest fall out
+		new_cache.assign(triangle, triangle + 3);
+		for (size_t j = 0; j < cache.size(); j++) {
+			if (cache[j] != triangle[0] && cache[j] != triangle[1] && cache[j] != triangle[2])
+				new_cache.push_back(cache[j]);
+		}
+
+		// rescore everything that moved (evicted ones included), and the triangles around them
+		for (size_t j = 0; j < new_cache.size(); j++) {
+			unsigned int v = new_cache[j];
+			cache_position[v] = j < (size_t)FORSYTH_CACHE_SIZE ? (int)j : -1;
+			float score = vertexScore(cache_position[v], remaining[v]);
+			float delta = score - vertex_scores[v];
+			vertex_scores[v] = score;
+			for (unsigned int k = 0; k < remaining[v]; k++)
+				triangle_scores[adjacency[offsets[v] + k]] += delta;
+		}
+		if (new_cache.size() > (size_t)FORSYTH_CACHE_SIZE)
+			new_cache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(new_cache);
+
+		// next: the best triangle touching the cache
+		best = -1;
+		float best_score = -1.0f;
+		for (size_t j = 0; j < cache.size(); j++) {
+			unsigned int v = cache[j];
+			for (unsigned int k = 0; k < remaining[v]; k++) {
+				unsigned int t = adjacency[offsets[v] + k];
+				if (triangle_scores[t] > best_score) {
+					best_score = triangle_scores[t];
+					best = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& positions, float threshold) {
+	size_t triangle_count = indices.size() / 3;
+	size_t vertex_count = positions.size() / 3;
+	if (triangle_count < 2)
+		return;
+
+	float acmr_before = computeAcmr(indices, vertex_count);
+
+	// cluster boundaries where all three vertices miss: the cache has started over anyway,
+	// so moving whole clusters around costs almost nothing
+	std::vector<size_t> starts;
+	{
+		const unsigned int cache_size = 16;
+		std::vector<unsigned int> loaded_at(vertex_count, 0);
+		unsigned int time = cache_size + 1;
+		for (size_t t = 0; t < triangle_count; t++) {
+			int misses = 0;
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+				if (time - loaded_at[v] > cache_size) {
+					loaded_at[v] = time++;
+					misses++;
+				}
+			}
+			if (t == 0 || misses == 3)
+				starts.push_back(t);
+		}
+	}
+	if (starts.size() < 2)
+		return;
+	starts.push_back(triangle_count);
+
+	// per cluster: area-weighted centroid and normal
+	size_t cluster_count = starts.size() - 1;
+	std::vector<float> cluster_data(cluster_count * 6, 0.0f);
+	double mesh_centroid[3] = { 0.0, 0.0, 0.0 };
+	double mesh_area = 0.0;
+	for (size_t c = 0; c < cluster_count; c++) {
+		float* data = &cluster_data[c * 6];
+		float area_sum = 0.0f;
+		for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+			const float* p0 = &positions[indices[t * 3] * 3];
+			const float* p1 = &positions[indices[t * 3 + 1] * 3];
+			const float* p2 = &positions[indices[t * 3 + 2] * 3];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++) {
+				data[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+				data[3 + k] += n[k];
+			}
+			area_sum += area;
+		}
+		for (int k = 0; k < 3; k++) {
+			mesh_centroid[k] += data[k];
+			if (area_sum > 0.0f)
+				data[k] /= area_sum;
+		}
+		mesh_area += area_sum;
+	}
+	if (mesh_area <= 0.0)
+		return;
+	for (int k = 0; k < 3; k++)
+		mesh_centroid[k] /= mesh_area;
+
+	// how far out each cluster faces: clusters on the outside hide the ones behind them
+	std::vector<float> facing(cluster_count);
+	std::vector<unsigned int> order(cluster_count);
+	for (size_t c = 0; c < cluster_count; c++) {
+		const float* data = &cluster_data[c * 6];
+		float length = sqrtf(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		float dot = 0.0f;
+		for (int k = 0; k < 3; k++)
+			dot += (data[k] - (float)mesh_centroid[k]) * data[3 + k];
+		facing[c] = length > 0.0f ? dot / length : 0.0f;
+		order[c] = (unsigned int)c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&facing](unsigned int a, unsigned int b) { return facing[a] > facing[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (size_t c = 0; c < cluster_count; c++) {
+		size_t cluster = order[c];
+		result.insert(result.end(), indices.begin() + starts[cluster] * 3, indices.begin() + starts[cluster + 1] * 3);
+	}
+
+	if (computeAcmr(result, vertex_count) <= acmr_before * threshold)
+		indices.swap(result);
+}
+
+// moves attribute entries of components floats each to their new vertex positions
+static void permuteAttribute(std::vector<float>& data, const std::vector<unsigned int>& remap, size_t components) {
+	size_t vertex_count = remap.size();
+	if (data.size() < vertex_count * components)
+		return;
+
+	std::vector<float> result(data.size());
+	for (size_t v = 0; v < vertex_count; v++) {
+		for (size_t k = 0; k < components; k++)
+			result[remap[v] * components + k] = data[v * components + k];
+	}
+	std::copy(data.begin() + vertex_count * components, data.end(), result.begin() + vertex_count * components);
+	data.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<float>& positions,
+	std::vector<float>& texcoords, std::vector<float>& normals) {
+	size_t vertex_count = positions.size() / 3;
+
+	std::vector<unsigned int> remap(vertex_count, ~0u);
+	unsigned int next = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (remap[indices[i]] == ~0u)
+			remap[indices[i]] = next++;
+	}
+	for (size_t v = 0; v < vertex_count; v++) {
+		if (remap[v] == ~0u)
+			remap[v] = next++;
+	}
+
+	for (size_t i = 0; i < indices.size(); i++)
+		indices[i] = remap[indices[i]];
+	permuteAttribute(positions, remap, 3);
+	permuteAttribute(texcoords, remap, 2);
+	permuteAttribute(normals, remap, 3);
+}
+
+// exact bit pattern of up to five floats, for welding vertices
+struct VertexKey {
+	uint32_t bits[5];
+
+	bool operator==(const VertexKey& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey& key) const {
+		uint64_t h = 14695981039346656037ull;
+		for (int i = 0; i < 5; i++)
+			h = (h ^ key.bits[i]) * 1099511628211ull;
+		return (size_t)h;
+	}
+};
+
+std::vector<unsigned int> weldVertices(const std::vector<float>& positions, const std::vector<float>& texcoords, bool match_uv) {
+	size_t vertex_count = positions.size() / 3;
+	std::vector<unsigned int> first(vertex_count);
+	std::unordered_map<VertexKey, unsigned int, VertexKeyHash> seen;
+	seen.reserve(vertex_count);
+
+	for (size_t v = 0; v < vertex_count; v++) {
+		VertexKey key;
+		memset(&key, 0, sizeof(key));
+		memcpy(key.bits, &positions[v * 3], 3 * sizeof(float));
+		if (match_uv && texcoords.size() >= vertex_count * 2)
+			memcpy(key.bits + 3, &texcoords[v * 2], 2 * sizeof(float));
+		first[v] = seen.insert(std::make_pair(key, (unsigned int)v)).first->second;
+	}
+	return first;
+}
+
+// true if moving from onto to turns any triangle around from over (one that doesn't also hold to)
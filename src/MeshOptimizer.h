@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------
+// Post-load index and vertex reordering, run once per mesh before it goes into the pool.
+// Nothing here changes what is drawn, only the order: triangles so consecutive ones share
+// vertices still in the GPU's post-transform cache (and big outward-facing patches come
+// first to cut overdraw), vertices so they are fetched from memory roughly in order.
+// ------------------------------------------------------------------------------------------
+
+// average cache misses per triangle for a FIFO post-transform cache of cache_size vertices;
+// 3.0 is no reuse at all, about 0.5-0.7 is good for a regular mesh
+float computeAcmr(const std::vector<unsigned int>& indices, size_t vertex_count, unsigned int cache_size = 16);
+
+// Forsyth's linear-speed vertex cache optimisation, reorders the triangles in place
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count);
+
+// splits cache-optimised triangles where the cache starts over and draws the clusters that face
+// outwards first (Sander, Nehab & Barczak); kept only if ACMR grows by at most threshold (1.05 = 5%)
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& positions, float threshold);
+
+// renumbers vertices in order of first use and permutes the attributes to match (texcoords and
+// normals only if present for every vertex); vertices no triangle uses end up last
+void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<float>& positions,
+	std::vector<float>& texcoords, std::vector<float>& normals);
+
+// for every vertex, the first vertex with exactly the same position (and uv, with match_uv):
+// OBJ vertices are split wherever the uv or normal changes, this finds what is really connected
+std::vector<unsigned int> weldVertices(const std::vector<float>& positions, const std::vector<float>& texcoords, bool match_uv);
@@ -0,0 +1,147 @@
+#include "MeshPool.h"
+#include "Log.h"
+
+void MeshPool::clear() {
+	clearMeshes();
+
+	if (vertex_array) {
+		glDeleteVertexArrays(1, &vertex_array);
+		glDeleteVertexArrays(1, &position_array);
+		glDeleteBuffers(5, buffers);
+		vertex_array = position_array = 0;
+		for (int i = 0; i < 5; i++) buffers[i] = 0;
+	}
+}
+
+void MeshPool::clearMeshes() {
+	ranges.clear();
+	max_mesh_vertices = 0;
+	positions.clear();
+	texcoords.clear();
+	normals.clear();
+	indices.clear();
+}
+
+GLuint MeshPool::add(const std::vector<float>& mesh_positions, const std::vector<float>& mesh_texcoords,
+	const std::vector<float>& mesh_normals, const std::vector<unsigned int>& mesh_indices) {
+	size_t vertex_count = mesh_positions.size() / 3;
+
+	MeshRange range;
+	range.first_index = (GLuint)indices.size();
+	range.index_count = (GLuint)mesh_indices.size();
+	range.base_vertex = (GLint)(positions.size() / 3);
+	ranges.push_back(range);
+	if (vertex_count > max_mesh_vertices)
+		max_mesh_vertices = vertex_count;
+
+	positions.insert(positions.end(), mesh_positions.begin(), mesh_positions.begin() + vertex_count * 3);
+
+	// keep the attribute arrays the same length as positions even if the obj lacks them
+	if (mesh_texcoords.size() >= vertex_count * 2)
+		texcoords.insert(texcoords.end(), mesh_texcoords.begin(), mesh_texcoords.begin() + vertex_count * 2);
+	else
+		texcoords.resize(texcoords.size() + vertex_count * 2, 0.0f);
+
+	if (mesh_normals.size() >= vertex_count * 3)
+		normals.insert(normals.end(), mesh_normals.begin(), mesh_normals.begin() + vertex_count * 3);
+	else
+		normals.resize(normals.size() + vertex_count * 3, 0.0f);
+
+	// indices stay mesh-relative, base_vertex offsets them at draw time
+	indices.insert(indices.end(), mesh_indices.begin(), mesh_indices.end());
+
+	return (GLuint)(ranges.size() - 1);
+}
+
+GLuint MeshPool::addIndices(GLuint mesh, const std::vector<unsigned int>& mesh_indices) {
+	MeshRange range;
+	range.first_index = (GLuint)indices.size();
+	range.index_count = (GLuint)mesh_indices.size();
+	range.base_vertex = ranges[mesh].base_vertex;
+	ranges.push_back(range);
+
+	indices.insert(indices.end(), mesh_indices.begin(), mesh_indices.end());
+
+	return (GLuint)(ranges.size() - 1);
+}
+
+// one float attribute from its own buffer
+static void bindFloatAttribute(GLuint buffer, const std::vector<float>& data, GLuint shader, const char* attrib, GLint size) {
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.empty() ? NULL : &data[0], GL_STATIC_DRAW);
+
+	GLint location = glGetAttribLocation(shader, attrib);
+	if (location >= 0) {
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, 0, 0);
+	}
+}
+
+void MeshPool::upload(GLuint shader, GLuint draw_slots) {
+	// glBufferData below replaces the storage, a reload keeps the names
+	if (!vertex_array) {
+		glGenVertexArrays(1, &vertex_array);
+		glGenVertexArrays(1, &position_array);
+		glGenBuffers(5, buffers);
+	}
+	glBindVertexArray(vertex_array);
+
+	bindFloatAttribute(buffers[0], positions, shader, "a_vertex", 3);
+	bindFloatAttribute(buffers[1], texcoords, shader, "a_uv", 2);
+	bindFloatAttribute(buffers[2], normals, shader, "a_normal", 3);
+
+	// instanced 0..draw_slots-1: a draw's base instance becomes its draw id
+	std::vector<GLuint> draw_ids(draw_slots);
+	for (GLuint i = 0; i < draw_slots; i++) draw_ids[i] = i;
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[3]);
+	glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(GLuint), draw_ids.empty() ? NULL : &draw_ids[0], GL_STATIC_DRAW);
+	GLint draw_id_loc = glGetAttribLocation(shader, "a_draw_id");
+	if (draw_id_loc >= 0) {
+		glEnableVertexAttribArray(draw_id_loc);
+		glVertexAttribIPointer(draw_id_loc, 1, GL_UNSIGNED_INT, 0, 0);
+		glVertexAttribDivisor(draw_id_loc, 1);
+	}
+
+	// half the index bandwidth when no mesh needs more than 16 bits
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[4]);
+	if (max_mesh_vertices < 65536) {
+		index_type = GL_UNSIGNED_SHORT;
+		std::vector<unsigned short> short_indices(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(unsigned short), short_indices.empty() ? NULL : &short_indices[0], GL_STATIC_DRAW);
+	}
+	else {
+		index_type = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+	}
+
+	// the same position, draw id and index buffers without the shading attributes: a depth-only pass
+	// fetches a third of the vertex data
+	GLint vertex_loc = glGetAttribLocation(shader, "a_vertex");
+	glBindVertexArray(position_array);
+	if (vertex_loc >= 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		glEnableVertexAttribArray(vertex_loc);
+		glVertexAttribPointer(vertex_loc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	}
+	if (draw_id_loc >= 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[3]);
+		glEnableVertexAttribArray(draw_id_loc);
+		glVertexAttribIPointer(draw_id_loc, 1, GL_UNSIGNED_INT, 0, 0);
+		glVertexAttribDivisor(draw_id_loc, 1);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[4]);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	LOG_INFO("mesh pool: {} meshes, {} vertices, {} triangles, {}-bit indices", ranges.size(), positions.size() / 3, indices.size() / 3, (index_type == GL_UNSIGNED_SHORT ? 16 : 32));
+}
+
+void MeshPool::draw(GLuint mesh) const {
+	draw(ranges[mesh]);
+}
+
+void MeshPool::draw(const MeshRange& r) const {
+	size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	glDrawElementsBaseVertex(GL_TRIANGLES, r.index_count, index_type, (void*)(r.first_index * index_size), r.base_vertex);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <GL/glew.h>
+#include <stddef.h>
+#include <vector>
+
+// where one mesh sits inside the shared buffers
+struct MeshRange {
+	GLuint first_index;
+	GLuint index_count;
+	GLint base_vertex;
+};
+
+// layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+// ------------------------------------------------------------------------------------------
+// All meshes in one VAO: positions, uvs, normals and indices are appended to shared buffers
+// and every mesh is addressed by its index range and base vertex. With a single VAO any set
+// of meshes can be drawn by one indirect call, and switching meshes never rebinds state.
+//
+// The VAO also carries a_draw_id, an instanced attribute reading 0, 1, 2, ... so a draw's
+// base instance selects its slot in the DrawData block.
+//
+// Indices are mesh-relative, so they are uploaded as 16-bit whenever every mesh has fewer
+// than 65536 vertices, whatever the size of the pool.
+// ------------------------------------------------------------------------------------------
+class MeshPool {
+public:
+	// drops the CPU copy and the GL objects
+	void clear();
+
+	// drops the CPU copy only, the next upload() refills the same GL objects
+	void clearMeshes();
+
+	// appends one mesh, missing uvs or normals are zero filled; returns its index
+	GLuint add(const std::vector<float>& positions, const std::vector<float>& texcoords,
+		const std::vector<float>& normals, const std::vector<unsigned int>& indices);
+
+	// another index list over an already added mesh's vertices (a LOD); returns its index
+	GLuint addIndices(GLuint mesh, const std::vector<unsigned int>& indices);
+
+	// creates the VAO and buffers, or reuses them after clearMeshes() (GL thread); attribute
+	// locations are looked up in shader, draw_slots: how many a_draw_id values to provide
+	void upload(GLuint shader, GLuint draw_slots);
+
+	GLuint vao() const { return vertex_array; }
+	GLuint positionVao() const { return position_array; }	// a_vertex and a_draw_id only, same locations, for depth-only passes
+	GLenum indexType() const { return index_type; }		// for the draw calls, valid after upload()
+	size_t size() const { return ranges.size(); }
+	const MeshRange& range(GLuint mesh) const { return ranges[mesh]; }
+
+	// a single draw of one mesh, for the non-indirect paths (the pool's VAO must be bound)
+	void draw(GLuint mesh) const;
+	void draw(const MeshRange& range) const;
+
+private:
+	std::vector<MeshRange> ranges;
+	std::vector<float> positions, texcoords, normals;
+	std::vector<unsigned int> indices;
+	size_t max_mesh_vertices = 0;
+	GLenum index_type = GL_UNSIGNED_INT;
+
+	GLuint vertex_array = 0;
+	GLuint position_array = 0;
+	GLuint buffers[5] = {};		// positions, uvs, normals, draw ids, indices
+};
@@ -0,0 +1,104 @@
+#include "MeshStore.h"
+
+void NameTable::clear() {
+	names.clear();
+	ids.clear();
+}
+
+uint32_t NameTable::intern(const std::string& name) {
+	std::unordered_map<std::string, uint32_t>::const_iterator it = ids.find(name);
+	if (it != ids.end())
+		return it->second;
+
+	uint32_t id = (uint32_t)names.size();
+	names.push_back(name);
+	ids[name] = id;
+	return id;
+}
+
+uint32_t NameTable::find(const std::string& name) const {
+	std::unordered_map<std::string, uint32_t>::const_iterator it = ids.find(name);
+	return it != ids.end() ? it->second : NAME_NONE;
+}
+
+void MeshStore::clear() {
+	names.clear();
+	name_ids.clear();
+	rest_transforms.clear();
+	materials.clear();
+	passes.clear();
+	object_indices.clear();
+	texture_indices.clear();
+	material_ids.clear();
+	draw_flags.clear();
+	parents.clear();
+	nodes.clear();
+	lods.clear();
+}
+
+void MeshStore::reserve(size_t count) {
+	name_ids.reserve(count);
+	rest_transforms.reserve(count);
+	materials.reserve(count);
+	passes.reserve(count);
+	object_indices.reserve(count);
+	texture_indices.reserve(count);
+	material_ids.reserve(count);
+	draw_flags.reserve(count);
+	parents.reserve(count);
+	nodes.reserve(count);
+	lods.reserve(count);
+}
+
+GLuint MeshStore::add(const std::string& name, GLuint object_index, GLuint texture_index, const TransformationValues& rest, const MaterialProperties& material) {
+	DrawMaterial draw_material;
+	draw_material.ambient = material.ambient;
+	draw_material.diffuse = material.diffuse;
+	draw_material.specular = material.specular;
+	draw_material.shininess = material.shininess;
+	draw_material.alpha = material.alpha;
+
+	GLuint id = (GLuint)size();
+	name_ids.push_back(names.intern(name));
+	rest_transforms.push_back(rest);
+	materials.push_back(draw_material);
+
+	// alpha < 1 covers both translucent materials and alpha maps (-1.0f)
+	passes.push_back((unsigned char)(material.alpha < 1.0f ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE));
+
+	object_indices.push_back(object_index);
+	texture_indices.push_back(texture_index);
+	material_ids.push_back(0);
+	draw_flags.push_back(0);
+	parents.push_back(-1);
+	nodes.push_back(SCENE_NODE_NONE);
+	lods.push_back(0);
+	return id;
+}
+
+GLuint MeshStore::find(const std::string& name) const {
+	uint32_t name_id = names.find(name);
+	if (name_id == NAME_NONE)
+		return MESH_NONE;
+	for (GLuint i = 0; i < (GLuint)name_ids.size(); i++) {
+		if (name_ids[i] == name_id)
+			return i;
+	}
+	return MESH_NONE;
+}
+
+static bool sameMaterial(const DrawMaterial& a, const DrawMaterial& b) {
+	return a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular && a.shininess == b.shininess && a.alpha == b.alpha;
+}
+
+void MeshStore::assignMaterialIds() {
+	std::vector<GLuint> unique_meshes;		// first entity seen with each material
+	for (GLuint i = 0; i < (GLuint)size(); i++) {
+		GLuint id = 0;
+		while (id < unique_meshes.size() && !sameMaterial(materials[unique_meshes[id]], materials[i]))
+			id++;
+		if (id == unique_meshes.size())
+			unique_meshes.push_back(i);
+		material_ids[i] = id;
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "CommandBuffer.h"	// DrawMaterial, RenderPass
+#include "SceneGraph.h"		// TransformationValues
+
+struct MaterialProperties {
+	// struct for material properties
+	glm::vec3 ambient, diffuse, specular;
+	GLfloat shininess, alpha;
+
+	// constructor accepts 3 vec3 values for ambient, diffuse, specular, then 2 Glfloat values for shininess and alpha
+	MaterialProperties(glm::vec3 ambi, glm::vec3 diff, glm::vec3 spec, GLfloat shiny, GLfloat transparency) : ambient(ambi), diffuse(diff), specular(spec), shininess(shiny), alpha(transparency) {}
+};
+
+const uint32_t NAME_NONE = 0xFFFFFFFF;
+const GLuint MESH_NONE = 0xFFFFFFFF;
+
+// each string stored once and referred to by a small id, so comparing names is comparing ids
+class NameTable {
+public:
+	void clear();
+
+	// the name's id, a new one the first time it is seen
+	uint32_t intern(const std::string& name);
+
+	// NAME_NONE for a name never interned
+	uint32_t find(const std::string& name) const;
+
+	const std::string& name(uint32_t id) const { return names[id]; }
+
+private:
+	std::vector<std::string> names;
+	std::unordered_map<std::string, uint32_t> ids;
+};
+
+// ------------------------------------------------------------------------------------------
+// Scene meshes as components: one dense array per field, indexed by entity id, so a pass that
+// needs only the pass and node of every mesh walks those two arrays instead of striding over
+// whole structs. Names are interned into a side table that nothing reads per frame, and the
+// world matrices stay in the SceneGraph, reached through node(). Entities are only appended
+// at setup; per frame the store is read, and only lod is written, without allocating.
+// ------------------------------------------------------------------------------------------
+class MeshStore {
+public:
+	void clear();
+
+	// room for count entities, so adding them never moves the arrays
+	void reserve(size_t count);
+
+	// appends an entity with no parent and no scene node, returns its id
+	GLuint add(const std::string& name, GLuint object_index, GLuint texture_index, const TransformationValues& rest, const MaterialProperties& material);
+
+	size_t size() const { return object_indices.size(); }
+
+	// first entity with this name, MESH_NONE for none
+	GLuint find(const std::string& name) const;
+	const std::string& name(GLuint id) const { return names.name(name_ids[id]); }
+
+	// gives every entity a small id shared by all entities with the same material, for the
+	// render queue sort key
+	void assignMaterialIds();
+
+	const TransformationValues& rest(GLuint id) const { return rest_transforms[id]; }
+	const DrawMaterial& material(GLuint id) const { return materials[id]; }
+	RenderPass pass(GLuint id) const { return (RenderPass)passes[id]; }
+	GLuint objectIndex(GLuint id) const { return object_indices[id]; }
+	GLuint textureIndex(GLuint id) const { return texture_indices[id]; }
+	GLuint materialId(GLuint id) const { return material_ids[id]; }
+	uint32_t drawFlags(GLuint id) const { return draw_flags[id]; }
+	int parent(GLuint id) const { return parents[id]; }
+	int node(GLuint id) const { return nodes[id]; }
+	int lod(GLuint id) const { return lods[id]; }
+
+	// parents have to be added before their children
+	void setParent(GLuint id, int parent) { parents[id] = parent; }
+	void setNode(GLuint id, int node) { nodes[id] = node; }
+	void setLod(GLuint id, int lod) { lods[id] = lod; }
+	void setDrawFlags(GLuint id, uint32_t flags) { draw_flags[id] = flags; }
+
+private:
+	NameTable names;
+	std::vector<uint32_t> name_ids;
+
+	std::vector<TransformationValues> rest_transforms;	// rest pose, relative to the parent if there is one
+	std::vector<DrawMaterial> materials;
+	std::vector<unsigned char> passes;					// RenderPass, from the material's alpha
+	std::vector<GLuint> object_indices;
+	std::vector<GLuint> texture_indices;
+	std::vector<GLuint> material_ids;					// shared by identical materials
+	std::vector<uint32_t> draw_flags;					// DRAW_FLAG_*
+	std::vector<int> parents;							// entity id, -1 for none
+	std::vector<int> nodes;								// scene_graph node holding the live transform
+	std::vector<int> lods;								// LOD drawn last frame, selectLod() only moves away from it past a margin
+};
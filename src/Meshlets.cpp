@@ -0,0 +1,218 @@
+#include "Meshlets.h"
+#include "MeshOptimizer.h"	// weldVertices, optimizeVertexCache
+#include <math.h>
+
+// bounding sphere and normal cone of indices [begin, end)
+static void finishMeshlet(const std::vector<float>& positions, const std::vector<unsigned int>& indices,
+	size_t begin, size_t end, Meshlet& meshlet, BoundingSphere& sphere) {
+	std::vector<float> points;
+	points.reserve((end - begin) * 3);
+	glm::vec3 axis(0.0f);
+	std::vector<glm::vec3> normals;
+	normals.reserve((end - begin) / 3);
+
+	for (size_t i = begin; i < end; i += 3) {
+		glm::vec3 p[3];
+		for (int k = 0; k < 3; k++) {
+			const float* v = &positions[indices[i + k] * 3];
+			p[k] = glm::vec3(v[0], v[1], v[2]);
+			points.push_back(v[0]);
+			points.push_back(v[1]);
+			points.push_back(v[2]);
+		}
+		glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;	// degenerate, faces nowhere
+		normal = normal / length;
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	sphere = computeBoundingVolume(points).sphere;
+	meshlet.first_index = (GLuint)begin;
+	meshlet.index_count = (GLuint)(end - begin);
+	meshlet.cone_axis = glm::vec3(0.0f);
+	meshlet.cone_cutoff = 1.0f;
+
+	float axis_length = glm::length(axis);
+	if (axis_length == 0.0f)
+		return;
+	axis = axis / axis_length;
+
+	// the widest normal decides; past 90 degrees some triangle always faces the camera
+	float min_dot = 1.0f;
+	for (size_t n = 0; n < normals.size(); n++) {
+		float d = glm::dot(axis, normals[n]);
+		if (d < min_dot) min_dot = d;
+	}
+	meshlet.cone_axis = axis;
+	meshlet.cone_cutoff = min_dot <= 0.0f ? 1.0f : sqrtf(1.0f - min_dot * min_dot);
+}
+
+void MeshletSet::build(const std::vector<float>& positions, std::vector<unsigned int>& indices) {
+	meshlets.clear();
+	spheres.clear();
+
+	size_t vertex_count = positions.size() / 3;
+	size_t triangle_count = indices.size() / 3;
+
+	// triangles around each position (split vertices still connect), and every triangle's facing
+	std::vector<unsigned int> corner = weldVertices(positions, std::vector<float>(), false);
+	std::vector<unsigned int> offsets(vertex_count + 1, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		offsets[corner[indices[i]] + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> adjacency(triangle_count * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		adjacency[fill[corner[indices[i]]]++] = (unsigned int)(i / 3);
+
+	std::vector<glm::vec3> normals(triangle_count);
+	for (size_t t = 0; t < triangle_count; t++) {
+		glm::vec3 p[3];
+		for (int k = 0; k < 3; k++) {
+			const float* v = &positions[indices[t * 3 + k] * 3];
+			p[k] = glm::vec3(v[0], v[1], v[2]);
+		}
+		glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+
+	std::vector<unsigned char> used(triangle_count, 0);
+	std::vector<unsigned int> in_meshlet(vertex_count, ~0u);	// cluster the vertex was last added to
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> members;
+	size_t cursor = 0;	// seeds are taken in the incoming (cache optimised) order
+
+	for (;;) {
+		while (cursor < triangle_count && used[cursor])
+			cursor++;
+		if (cursor == triangle_count)
+			break;
+
+		// grow from the seed over shared vertices, preferring triangles that add no new vertex
+		// and face the same way as the cluster so far, which keeps the normal cone narrow
+		unsigned int current = (unsigned int)meshlets.size();
+		size_t unique_vertices = 0;
+		glm::vec3 facing(0.0f);
+		members.clear();
+
+		unsigned int next = (unsigned int)cursor;
+		while (next != ~0u) {
+			used[next] = 1;
+			members.push_back(next);
+			facing += normals[next];
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[next * 3 + k];
+				if (in_meshlet[v] != current) {
+					in_meshlet[v] = current;
+					unique_vertices++;
+				}
+			}
+			if (members.size() >= MESHLET_MAX_TRIANGLES)
+				break;
+
+			float facing_length = glm::length(facing);
+			glm::vec3 axis = facing_length > 0.0f ? facing / facing_length : glm::vec3(0.0f);
+
+			next = ~0u;
+			float best_score = 1e30f;
+			for (size_t m = 0; m < members.size(); m++) {
+				for (int k = 0; k < 3; k++) {
+					unsigned int v = corner[indices[members[m] * 3 + k]];
+					for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++) {
+						unsigned int t = adjacency[a];
+						if (used[t])
+							continue;
+
+						int new_vertices = 0;
+						for (int j = 0; j < 3; j++)
+							new_vertices += in_meshlet[indices[t * 3 + j]] != current ? 1 : 0;
+						if (unique_vertices + new_vertices > MESHLET_MAX_VERTICES)
+							continue;
+
+						float score = (float)new_vertices + 2.0f * (1.0f - glm::dot(axis, normals[t]));
+						if (score < best_score) {
+							best_score = score;
+							next = t;
+						}
+					}
+				}
+			}
+		}
+
+		// growing order is not cache order, sort the cluster's own triangles again
+		std::vector<unsigned int> cluster;
+		for (size_t m = 0; m < members.size(); m++) {
+			cluster.push_back(indices[members[m] * 3]);
+			cluster.push_back(indices[members[m] * 3 + 1]);
+			cluster.push_back(indices[members[m] * 3 + 2]);
+		}
+		optimizeVertexCache(cluster, vertex_count);
+
+		size_t begin = result.size();
+		result.insert(result.end(), cluster.begin(), cluster.end());
+
+		Meshlet meshlet;
+		BoundingSphere sphere;
+		finishMeshlet(positions, result, begin, result.size(), meshlet, sphere);
+		meshlets.push_back(meshlet);
+		spheres.add(sphere);
+	}
+
+	indices.swap(result);
+}
+
+size_t MeshletSet::cull(const glm::mat4& model, const Frustum& world_frustum, const glm::vec3& world_camera,
+	const MeshRange& mesh, std::vector<MeshRange>& ranges) {
+	// planes go to object space with the transpose of the model matrix, renormalised so the
+	// distances are object units like the cluster spheres
+	Frustum frustum;
+	for (int i = 0; i < 6; i++) {
+		const glm::vec4& plane = world_frustum.planes[i];
+		glm::vec4 local(glm::dot(model[0], plane), glm::dot(model[1], plane), glm::dot(model[2], plane), glm::dot(model[3], plane));
+		float length = glm::length(glm::vec3(local));
+		frustum.planes[i] = length > 0.0f ? local / length : local;
+	}
+	glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(world_camera, 1.0f));
+
+	spheres.cull(frustum, visible);
+
+	// back-facing test on the cone: whichever side of a plane the camera is on doesn't change
+	// under the model transform, so object space gives the same answer as world space
+	size_t appended = 0;
+	bool extend = false;
+	for (size_t i = 0; i < meshlets.size(); i++) {
+		const Meshlet& meshlet = meshlets[i];
+		if (visible[i] && meshlet.cone_cutoff < 1.0f) {
+			BoundingSphere sphere = spheres.at(i);
+			glm::vec3 to_center = sphere.center - camera;
+			if (glm::dot(to_center, meshlet.cone_axis) >= meshlet.cone_cutoff * glm::length(to_center) + sphere.radius)
+				visible[i] = 0;
+		}
+
+		if (!visible[i]) {
+			extend = false;
+			continue;
+		}
+
+		// clusters are contiguous in the index buffer, a run of visible ones is one range
+		if (extend) {
+			ranges.back().index_count += meshlet.index_count;
+		}
+		else {
+			MeshRange range;
+			range.first_index = mesh.first_index + meshlet.first_index;
+			range.index_count = meshlet.index_count;
+			range.base_vertex = mesh.base_vertex;
+			ranges.push_back(range);
+			appended++;
+			extend = true;
+		}
+	}
+	return appended;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <vector>
+
+#include "Culling.h"	// SphereCullBatch, Frustum
+#include "MeshPool.h"	// MeshRange
+
+// cluster size limits, small enough that one cluster is mostly flat and mostly in one place
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// meshes with fewer triangles than this are culled as a whole only
+const size_t MESHLET_MIN_TRIANGLES = 1024;
+
+// one cluster, a contiguous run of the mesh's triangles
+struct Meshlet {
+	GLuint first_index;		// relative to the mesh's first index
+	GLuint index_count;
+	glm::vec3 cone_axis;	// average facing, object space
+	float cone_cutoff;		// sin of the normals' spread around the axis, 1 = never back-facing
+};
+
+// ------------------------------------------------------------------------------------------
+// A mesh split into meshlets, each with an object-space bounding sphere and a normal cone.
+// Clusters are grown over shared vertices from seeds taken in the (vertex cache optimised)
+// triangle order, and the mesh's indices are reordered cluster by cluster, so a meshlet needs
+// no index data of its own: each one is a range of the mesh's indices in the pool.
+//
+// cull() runs per draw on the main thread. The frustum and the camera are brought into
+// object space once, then every cluster is tested against the frustum (SSE, SphereCullBatch)
+// and its normal cone; a cluster facing entirely away from the camera is dropped. Surviving
+// neighbours are merged so a mostly visible mesh still costs only a few draws.
+// ------------------------------------------------------------------------------------------
+class MeshletSet {
+public:
+	// reorders indices so every meshlet is a contiguous range
+	void build(const std::vector<float>& positions, std::vector<unsigned int>& indices);
+
+	bool empty() const { return meshlets.empty(); }
+	size_t size() const { return meshlets.size(); }
+
+	// appends the index ranges of mesh (its range in the pool) that may be visible,
+	// returns how many were appended: 0 if the whole mesh is culled
+	size_t cull(const glm::mat4& model, const Frustum& world_frustum, const glm::vec3& world_camera,
+		const MeshRange& mesh, std::vector<MeshRange>& ranges);
+
+private:
+	std::vector<Meshlet> meshlets;
+	SphereCullBatch spheres;
+	std::vector<unsigned char> visible;		// scratch for cull()
+};
@@ -0,0 +1,109 @@
+#include "Overdraw.h"
+#include "Shader.h"
+
+// weight of each new frame in the average
+static const float OVERDRAW_SMOOTHING = 0.1f;
+
+bool OverdrawMeter::create() {
+	Shader shader("src/shader_skybox.vert", "src/shader_depth.frag");
+	GLint status = GL_FALSE;
+	glGetProgramiv(shader.program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		glDeleteProgram(shader.program);
+		return false;
+	}
+
+	if (program)
+		glDeleteProgram(program);
+	program = shader.program;
+
+	if (!vao) {
+		glGenVertexArrays(1, &vao);
+		glGenQueries(FRAMES, shaded_queries);
+		glGenQueries(FRAMES, covered_queries);
+	}
+	return true;
+}
+
+void OverdrawMeter::destroy() {
+	if (program) glDeleteProgram(program);
+	if (vao) {
+		glDeleteVertexArrays(1, &vao);
+		glDeleteQueries(FRAMES, shaded_queries);
+		glDeleteQueries(FRAMES, covered_queries);
+	}
+	program = 0;
+	vao = 0;
+	for (int i = 0; i < FRAMES; i++) {
+		shaded_queries[i] = covered_queries[i] = 0;
+		pending[i] = false;
+	}
+	measuring = shading = false;
+	average = 0.0f;
+}
+
+void OverdrawMeter::beginFrame() {
+	if (!program) {
+		measuring = false;
+		return;
+	}
+
+	// oldest first; queries finish in order, so stop at the first one still running
+	for (int k = 1; k <= FRAMES; k++) {
+		int i = (current + k) % FRAMES;
+		if (!pending[i]) continue;
+
+		GLuint available = 0;
+		glGetQueryObjectuiv(covered_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+
+		GLuint shaded = 0, covered = 0;
+		glGetQueryObjectuiv(shaded_queries[i], GL_QUERY_RESULT, &shaded);
+		glGetQueryObjectuiv(covered_queries[i], GL_QUERY_RESULT, &covered);
+		pending[i] = false;
+
+		// an empty screen says nothing about overdraw
+		if (covered > 0) {
+			float sample = (float)shaded / covered;
+			average = average == 0.0f ? sample : average + (sample - average) * OVERDRAW_SMOOTHING;
+		}
+	}
+
+	// skip measuring while the gpu is more than FRAMES behind
+	current = (current + 1) % FRAMES;
+	measuring = !pending[current];
+}
+
+void OverdrawMeter::beginShaded() {
+	if (!measuring) return;
+	glBeginQuery(GL_SAMPLES_PASSED, shaded_queries[current]);
+	shading = true;
+}
+
+void OverdrawMeter::endShaded() {
+	if (!shading) return;
+	glEndQuery(GL_SAMPLES_PASSED);
+	shading = false;
+}
+
+void OverdrawMeter::countCovered() {
+	if (!measuring) return;
+
+	// passes wherever something is in front of the far plane; nothing written
+	glBeginQuery(GL_SAMPLES_PASSED, covered_queries[current]);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_GREATER);
+	glDepthMask(GL_FALSE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	glUseProgram(program);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glEndQuery(GL_SAMPLES_PASSED);
+
+	pending[current] = true;
+}
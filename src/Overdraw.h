@@ -0,0 +1,43 @@
+#pragma once
+#include <GL/glew.h>
+
+// ------------------------------------------------------------------------------------------
+// Opaque overdraw measured on the gpu: fragments that pass the depth test in draw order (what
+// the shading pass costs without a depth pre-pass) over the pixels the opaque pass covers. Both
+// are occlusion queries, read back a few frames later so nothing ever waits on the gpu; covered
+// pixels come from one full-screen triangle on the far plane drawn with GL_GREATER over the
+// finished depth buffer.
+// ------------------------------------------------------------------------------------------
+class OverdrawMeter {
+public:
+	// false when the probe shaders (shader_skybox.vert, shader_depth.frag) fail
+	bool create();
+	void destroy();
+
+	// takes in the results of earlier frames that are ready and picks this frame's queries
+	void beginFrame();
+
+	// around the draws whose depth-passing fragments count as shaded (the depth pre-pass, or the
+	// opaque pass without one); endShaded() does nothing when no count is running
+	void beginShaded();
+	void endShaded();
+
+	// once the depth buffer holds the whole opaque pass; changes program and vao
+	void countCovered();
+
+	// fragments per covered pixel, smoothed over frames; 0 until the first frame is read back
+	float overdraw() const { return average; }
+
+private:
+	static const int FRAMES = 4;	// in flight before a query is reused
+
+	GLuint program = 0;
+	GLuint vao = 0;
+	GLuint shaded_queries[FRAMES] = {};
+	GLuint covered_queries[FRAMES] = {};
+	bool pending[FRAMES] = {};
+	int current = 0;
+	bool measuring = false;			// this frame's queries are free
+	bool shading = false;			// shaded query running
+	float average = 0.0f;
+};
@@ -0,0 +1,81 @@
+#include "Particles.h"
+#include "JobSystem.h"
+#include <stdlib.h>
+
+// particles per job, below this the update runs on the calling thread
+static const size_t PARTICLE_JOB_GRAIN = 4096;
+
+float randomFloat(float min, float max) {
+	float random = static_cast<float>(rand()) / static_cast<float>(RAND_MAX); // Generate [0, 1]
+	return min + random * (max - min); // Scale to [min, max]
+}
+
+// ------------------------------------------------------------------------------------------
+// This function is called to initialize the particle effect
+// ------------------------------------------------------------------------------------------
+void initializeParticles(std::vector<Particle>& particles, int numParticles) {
+	for (int i = 0; i < numParticles; ++i) {
+		Particle p;
+		p.position = glm::vec3(
+			randomFloat(-5.0f, 5.0f), // X range
+			randomFloat(5.0f, 10.0f), // Y range (above the screen)
+			randomFloat(-5.0f, 5.0f)  // Z range
+		);
+		p.velocity = glm::vec3(0.0f, randomFloat(-1.0f, -2.0f), 0.0f); // Downward
+		p.lifetime = randomFloat(2.0f, 5.0f); // Random lifetime
+		p.size = randomFloat(0.1f, 0.3f);     // Random size
+		p.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // White color
+		p.active = true;
+		particles.push_back(p);
+	}
+}
+
+static void updateParticleRange(Particle* particles, size_t begin, size_t end, float deltaTime, float floorY) {
+	for (size_t i = begin; i < end; i++) {
+		Particle& p = particles[i];
+		if (!p.active) continue;
+
+		// Update position
+		p.position += p.velocity * deltaTime;
+
+		// Decrease lifetime
+		p.lifetime -= deltaTime;
+
+		// Fade out based on lifetime
+		p.color.a = p.lifetime > 0 ? p.lifetime / 5.0f : 0.0f;
+
+		// Check if it reached the floor
+		if (p.position.y <= floorY || p.lifetime <= 0.0f) {
+			p.active = false; // Deactivate particle
+		}
+	}
+}
+
+void updateParticles(std::vector<Particle>& particles, float deltaTime, float floorY, JobSystem* jobs) {
+	Particle* data = particles.data();
+
+	if (!jobs) {
+		updateParticleRange(data, 0, particles.size(), deltaTime, floorY);
+		return;
+	}
+	jobs->parallelFor(particles.size(), PARTICLE_JOB_GRAIN, [data, deltaTime, floorY](size_t begin, size_t end) {
+		updateParticleRange(data, begin, end, deltaTime, floorY);
+	});
+}
+
+void respawnParticles(std::vector<Particle>& particles, float topY) {
+	for (auto& p : particles) {
+		if (!p.active) {
+			p.position = glm::vec3(
+				randomFloat(-5.0f, 5.0f), // X range
+				randomFloat(topY, topY + 5.0f), // Reset Y (above the screen)
+				randomFloat(-5.0f, 5.0f)       // Z range
+			);
+			p.velocity = glm::vec3(0.0f, randomFloat(-1.0f, -2.0f), 0.0f);
+			p.lifetime = randomFloat(2.0f, 5.0f);
+			p.size = randomFloat(0.1f, 0.3f);
+			p.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+			p.active = true;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+class JobSystem;
+
+struct Particle {
+	glm::vec3 position;   // 3D position of the star
+	glm::vec3 velocity;   // Velocity of the star (falling motion)
+	float lifetime;       // Time until the star disappears
+	float size;           // Size of the star
+	glm::vec4 color;      // Color (RGBA) of the star
+	bool active;          // Whether the particle is active
+};
+
+// uses rand(), so main thread only
+float randomFloat(float min, float max);
+
+void initializeParticles(std::vector<Particle>& particles, int numParticles);
+
+// particles are independent of each other, with jobs large systems are split across worker threads
+void updateParticles(std::vector<Particle>& particles, float deltaTime, float floorY, JobSystem* jobs = NULL);
+
+// main thread only, see randomFloat()
+void respawnParticles(std::vector<Particle>& particles, float topY);
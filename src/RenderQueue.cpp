@@ -0,0 +1,101 @@
+#include "RenderQueue.h"
+#include "Memory.h"
+#include <string.h>
+
+// packs a non-negative float so that unsigned integer order matches float order
+static uint32_t depthBits(float view_depth) {
+	if (!(view_depth > 0.0f)) view_depth = 0.0f;	// behind the camera (or NaN) sorts as nearest
+	uint32_t bits;
+	memcpy(&bits, &view_depth, sizeof(bits));
+	return bits;
+}
+
+uint64_t makeSortKey(RenderPass pass, GLuint shader, GLuint material, GLuint texture, float view_depth, bool back_to_front) {
+	uint64_t p = (uint64_t)(pass & 0x3);
+	uint64_t s = (uint64_t)(shader & 0x3F);
+	uint64_t m = (uint64_t)(material & 0xFF);
+	uint64_t t = (uint64_t)(texture & 0xFFFF);
+	uint64_t d = (uint64_t)depthBits(view_depth);
+
+	if (pass == RENDER_PASS_TRANSPARENT && back_to_front) {
+		// far to near, state only breaks ties
+		return (p << 62) | ((uint64_t)(~(uint32_t)d) << 30) | (s << 24) | (m << 16) | t;
+	}
+
+	// state first, near to far within the same state
+	return (p << 62) | (s << 56) | (m << 48) | (t << 32) | d;
+}
+
+RenderPass sortKeyPass(uint64_t key) {
+	return (RenderPass)(key >> 62);
+}
+
+void RenderQueue::clear() {
+	keys.clear();
+	order.clear();
+	items.clear();
+}
+
+void RenderQueue::submit(uint64_t key, const RenderItem& item) {
+	order.push_back((GLuint)items.size());
+	keys.push_back(key);
+	items.push_back(item);
+}
+
+// ------------------------------------------------------------------------------------------
+// LSD radix sort, 8 bits per pass, histograms for all 8 digits built in one sweep.
+// digits where every key falls in the same bucket are skipped, so keys that share
+// their upper bits (same pass, same shader) only pay for the bytes that differ
+// ------------------------------------------------------------------------------------------
+void RenderQueue::sort(FrameArena& arena) {
+	size_t count = keys.size();
+	if (count < 2) return;
+
+	uint64_t* keys_tmp = arena.allocateArray<uint64_t>(count);
+	GLuint* order_tmp = arena.allocateArray<GLuint>(count);
+
+	size_t histogram[8][256];
+	memset(histogram, 0, sizeof(histogram));
+
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key = keys[i];
+		for (int digit = 0; digit < 8; digit++)
+			histogram[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	uint64_t* src_keys = keys.data();
+	GLuint* src_order = order.data();
+	uint64_t* dst_keys = keys_tmp;
+	GLuint* dst_order = order_tmp;
+
+	for (int digit = 0; digit < 8; digit++) {
+		size_t* bucket = histogram[digit];
+
+		// every key has the same byte here, nothing to reorder
+		if (bucket[(src_keys[0] >> (digit * 8)) & 0xFF] == count)
+			continue;
+
+		// prefix sum turns counts into write offsets
+		size_t offset = 0;
+		for (int b = 0; b < 256; b++) {
+			size_t c = bucket[b];
+			bucket[b] = offset;
+			offset += c;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			size_t dst = bucket[(src_keys[i] >> (digit * 8)) & 0xFF]++;
+			dst_keys[dst] = src_keys[i];
+			dst_order[dst] = src_order[i];
+		}
+
+		uint64_t* swap_keys = src_keys; src_keys = dst_keys; dst_keys = swap_keys;
+		GLuint* swap_order = src_order; src_order = dst_order; dst_order = swap_order;
+	}
+
+	// odd number of passes leaves the result in the scratch buffers
+	if (src_keys != keys.data()) {
+		memcpy(keys.data(), src_keys, count * sizeof(uint64_t));
+		memcpy(order.data(), src_order, count * sizeof(GLuint));
+	}
+}
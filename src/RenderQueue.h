@@ -0,0 +1,48 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+
+class FrameArena;
+
+// render passes, in the order they are drawn
+enum RenderPass {
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSPARENT = 1
+};
+
+// one draw submitted by draw(), the payload that travels with a sort key
+struct RenderItem {
+	GLuint mesh_index;					// entity id in mesh_store
+};
+
+// 64-bit sort key layout (most significant first)
+//
+// opaque:      | pass 2 | shader 6 | material 8 | texture 16 | depth 32 |
+// transparent: | pass 2 | ~depth 32 | shader 6 | material 8 | texture 16 |
+//
+// opaque draws are grouped by state and then drawn front-to-back inside a group (early-z),
+// transparent draws ignore state and are drawn strictly back-to-front (correct blending); with
+// !back_to_front (weighted blending, any order does) they take the opaque layout instead
+uint64_t makeSortKey(RenderPass pass, GLuint shader, GLuint material, GLuint texture, float view_depth, bool back_to_front = true);
+RenderPass sortKeyPass(uint64_t key);
+
+class RenderQueue {
+public:
+	void clear();
+	void submit(uint64_t key, const RenderItem& item);
+
+	// the radix sort's scratch comes from arena, valid until its next reset
+	void sort(FrameArena& arena);
+
+	size_t size() const { return keys.size(); }
+	uint64_t keyAt(size_t i) const { return keys[i]; }
+	const RenderItem& itemAt(size_t i) const { return items[order[i]]; }
+
+private:
+	std::vector<uint64_t> keys;			// sort keys, sorted in place
+	std::vector<GLuint> order;			// item index for each key, permuted with the keys
+	std::vector<RenderItem> items;		// submitted items, never moved
+};
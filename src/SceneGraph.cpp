@@ -0,0 +1,91 @@
+#include "SceneGraph.h"
+#include "JobSystem.h"
+#include <assert.h>
+
+// dirty locals per job; the world pass stays serial since children wait on their parents
+static const size_t TRANSFORM_JOB_GRAIN = 1024;
+
+void SceneGraph::clear() {
+	parents.clear();
+	local_trs.clear();
+	local_data.clear();
+	world_data.clear();
+	local_dirty.clear();
+	local_changed.clear();
+	world_changed.clear();
+}
+
+int SceneGraph::addNode(int parent, const TransformationValues& local) {
+	assert(parent == SCENE_NODE_NONE || (parent >= 0 && parent < (int)parents.size()));
+
+	InstanceData identity;
+	identity.model = glm::mat4(1.0f);
+	identity.normal_matrix[0] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+	identity.normal_matrix[1] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	identity.normal_matrix[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+
+	int node = (int)parents.size();
+	parents.push_back(parent);
+	local_trs.push_back(local);
+	local_data.push_back(identity);
+	world_data.push_back(identity);
+	local_dirty.push_back(1);
+	local_changed.push_back(0);
+	world_changed.push_back(0);
+	return node;
+}
+
+TransformationValues& SceneGraph::editLocal(int node) {
+	local_dirty[node] = 1;
+	return local_trs[node];
+}
+
+void SceneGraph::update(JobSystem* jobs) {
+	size_t count = parents.size();
+
+	// gather edited locals and rebuild them in one batch
+	dirty_nodes.clear();
+	batch_in.clear();
+	for (size_t i = 0; i < count; i++) {
+		local_changed[i] = local_dirty[i];
+		if (local_dirty[i]) {
+			dirty_nodes.push_back((int)i);
+			batch_in.push(local_trs[i]);
+			local_dirty[i] = 0;
+		}
+	}
+
+	if (!dirty_nodes.empty()) {
+		batch_out.resize(dirty_nodes.size());
+		if (jobs) {
+			jobs->parallelFor(dirty_nodes.size(), TRANSFORM_JOB_GRAIN, [this](size_t begin, size_t end) {
+				computeTransformsRange(batch_in, begin, end, batch_out.data());
+				for (size_t k = begin; k < end; k++)
+					local_data[dirty_nodes[k]] = batch_out[k];
+			});
+		}
+		else {
+			computeTransformsBatch(batch_in, batch_out.data());
+			for (size_t k = 0; k < dirty_nodes.size(); k++)
+				local_data[dirty_nodes[k]] = batch_out[k];
+		}
+	}
+
+	// parents come first, so a parent's world is final before its children read it
+	for (size_t i = 0; i < count; i++) {
+		int p = parents[i];
+		bool parent_changed = p != SCENE_NODE_NONE && world_changed[p];
+
+		if (!local_changed[i] && !parent_changed) {
+			// untouched subtree, no matrix math
+			world_changed[i] = 0;
+			continue;
+		}
+
+		if (p == SCENE_NODE_NONE)
+			world_data[i] = local_data[i];
+		else
+			combineInstanceData(world_data[p], local_data[i], world_data[i]);
+		world_changed[i] = 1;
+	}
+}
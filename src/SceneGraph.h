@@ -0,0 +1,65 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "TransformKernel.h"
+
+class JobSystem;
+
+struct TransformationValues {
+	// struct for transformation values
+	glm::vec3 translation, rotation, scale;
+
+	// first constructor accepts 9 float values for translate's, rotate's, scale's xyz values
+	TransformationValues(float tx, float ty, float tz, float rx, float ry, float rz, float sx, float sy, float sz) : translation(tx, ty, tz), rotation(rx, ry, rz), scale(sx, sy, sz) {}
+
+	// second constructor accepts 3 vec3 values for translate, rotate, scale vec3 values
+	TransformationValues(glm::vec3 t, glm::vec3 r, glm::vec3 s) : translation(t), rotation(r), scale(s) {}
+};
+
+const int SCENE_NODE_NONE = -1;
+
+// ------------------------------------------------------------------------------------------
+// Transform hierarchy. Nodes live in flat arrays indexed by node id, and a parent is always
+// added before its children, so one forward sweep over the arrays updates the whole tree.
+// Only nodes whose local transform was edited (and their descendants) are recomputed, and
+// the edited locals are rebuilt together by the batched SIMD kernel.
+// ------------------------------------------------------------------------------------------
+class SceneGraph {
+public:
+	void clear();
+
+	// parent must be SCENE_NODE_NONE or an existing node, which keeps parents before children
+	int addNode(int parent, const TransformationValues& local);
+
+	// read access to the local transform, does not dirty the node
+	const TransformationValues& local(int node) const { return local_trs[node]; }
+
+	// write access to the local transform, marks the node dirty
+	TransformationValues& editLocal(int node);
+
+	// recompute world matrices of dirty nodes and their subtrees
+	// with jobs, the local transform rebuild is split across worker threads
+	void update(JobSystem* jobs = NULL);
+
+	int parent(int node) const { return parents[node]; }
+	size_t size() const { return parents.size(); }
+	const glm::mat4& world(int node) const { return world_data[node].model; }
+
+	// world model + normal matrix, contiguous in node order
+	const InstanceData& instance(int node) const { return world_data[node]; }
+
+private:
+	std::vector<int> parents;
+	std::vector<TransformationValues> local_trs;
+	std::vector<InstanceData> local_data;
+	std::vector<InstanceData> world_data;
+	std::vector<unsigned char> local_dirty;		// local TRS edited since last update
+	std::vector<unsigned char> local_changed;	// local matrices rebuilt in this update
+	std::vector<unsigned char> world_changed;	// world matrices rebuilt in this update
+
+	// scratch for the batched local transform rebuild, kept to avoid per-frame allocation
+	std::vector<int> dirty_nodes;
+	TransformSoA batch_in;
+	std::vector<InstanceData> batch_out;
+};
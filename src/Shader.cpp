@@ -43,7 +43,7 @@ char* Shader::readFile(const char* filename)
             contents[i] = 0;
         }
         fread(contents, 1, file_length, fp);
-        contents[file_length + 1] = '\0';
+        contents[file_length] = '\0';
         fclose(fp);
         return contents;
     }
@@ -56,6 +56,8 @@ Shader::Shader(const char* vertSource, const char* fragSource) {
     char* vertexShaderSourceCode=readFile(vertSource);
     char* fragmentShaderSourceCode=readFile(fragSource);
     makeShaderProgram(makeVertexShader(vertexShaderSourceCode), makeFragmentShader(fragmentShaderSourceCode));
+    delete[] vertexShaderSourceCode;
+    delete[] fragmentShaderSourceCode;
 }
 
 GLuint Shader::makeVertexShader(const char* shaderSource)
@@ -147,6 +149,10 @@ void Shader::makeShaderProgram(GLuint vertexShaderID,GLuint fragmentShaderID)
     program=glCreateProgram();
     glAttachShader(program, vertexShaderID);
     glAttachShader(program,fragmentShaderID);
+
+    // only flagged while attached, they go with the program (and can still be relinked)
+    glDeleteShader(vertexShaderID);
+    glDeleteShader(fragmentShaderID);
     
     glLinkProgram(program);
     GLint link_ok = GL_FALSE;
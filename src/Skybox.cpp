@@ -0,0 +1,204 @@
+#include "Skybox.h"
+#include "JobSystem.h"
+#include "Shader.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const GLint SKYBOX_UNIT = 11;	// clear of the scene's, the G-buffer's and the light lists' units
+
+// "CUBE", then version, face size, source hash, then the faces
+static const uint32_t CUBEMAP_CACHE_MAGIC = 0x45425543;
+static const uint32_t CUBEMAP_CACHE_VERSION = 1;
+
+int cubemapFaceSize(int equirect_width) {
+	int size = 16;
+	while (size < equirect_width / 4 && size < 2048)
+		size *= 2;
+	return size;
+}
+
+// bilinear, wrapping around the horizon and clamped at the poles
+static void sampleEquirect(const unsigned char* pixels, int width, int height, int channels, float u, float v, unsigned char* out) {
+	float x = u * width - 0.5f;
+	float y = v * height - 0.5f;
+	int x0 = (int)floorf(x), y0 = (int)floorf(y);
+	float fx = x - x0, fy = y - y0;
+
+	int xs[2] = { ((x0 % width) + width) % width, (((x0 + 1) % width) + width) % width };
+	int ys[2] = { y0 < 0 ? 0 : (y0 >= height ? height - 1 : y0), y0 + 1 < 0 ? 0 : (y0 + 1 >= height ? height - 1 : y0 + 1) };
+
+	for (int c = 0; c < 4; c++) {
+		if (c >= channels) {
+			out[c] = 255;
+			continue;
+		}
+		float top = pixels[(ys[0] * width + xs[0]) * channels + c] * (1.0f - fx) + pixels[(ys[0] * width + xs[1]) * channels + c] * fx;
+		float bottom = pixels[(ys[1] * width + xs[0]) * channels + c] * (1.0f - fx) + pixels[(ys[1] * width + xs[1]) * channels + c] * fx;
+		out[c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+	}
+}
+
+void equirectToCubemap(const unsigned char* pixels, int width, int height, int channels, int face_size,
+	std::vector<unsigned char>& faces, JobSystem* jobs) {
+	faces.resize((size_t)6 * face_size * face_size * 4);
+	unsigned char* out = faces.data();
+
+	// one row of one face per item
+	std::function<void(size_t, size_t)> convert_rows = [=](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			int face = (int)(row / face_size);
+			int j = (int)(row % face_size);
+			float b = 2.0f * (j + 0.5f) / face_size - 1.0f;
+
+			for (int i = 0; i < face_size; i++) {
+				float a = 2.0f * (i + 0.5f) / face_size - 1.0f;
+
+				// texel (s, t) of each face back to its direction (the GL cube map face table inverted)
+				glm::vec3 direction;
+				switch (face) {
+				case 0: direction = glm::vec3(1.0f, -b, -a); break;
+				case 1: direction = glm::vec3(-1.0f, -b, a); break;
+				case 2: direction = glm::vec3(a, 1.0f, b); break;
+				case 3: direction = glm::vec3(a, -1.0f, -b); break;
+				case 4: direction = glm::vec3(a, -b, 1.0f); break;
+				default: direction = glm::vec3(-a, -b, -1.0f); break;
+				}
+				direction = glm::normalize(direction);
+
+				// sky sphere's uvs: v from the latitude, u from the longitude, turned so its seam stays put
+				float u = 0.95f - atan2f(direction.z, direction.x) / (2.0f * 3.14159265f);
+				u -= floorf(u);
+				float v = asinf(direction.y < -1.0f ? -1.0f : (direction.y > 1.0f ? 1.0f : direction.y)) / 3.14159265f + 0.5f;
+
+				sampleEquirect(pixels, width, height, channels, u, v, out + (row * face_size + i) * 4);
+			}
+		}
+	};
+
+	size_t rows = (size_t)6 * face_size;
+	if (jobs)
+		jobs->parallelFor(rows, 16, convert_rows);
+	else
+		convert_rows(0, rows);
+}
+
+bool readCubemapCache(const std::string& path, uint64_t source_hash, int& face_size, std::vector<unsigned char>& faces) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+
+	uint32_t header[3];
+	uint64_t hash = 0;
+	bool ok = fread(header, sizeof(header), 1, file) == 1 && fread(&hash, sizeof(hash), 1, file) == 1 &&
+		header[0] == CUBEMAP_CACHE_MAGIC && header[1] == CUBEMAP_CACHE_VERSION && hash == source_hash &&
+		header[2] > 0 && header[2] <= 2048;
+
+	if (ok) {
+		face_size = (int)header[2];
+		faces.resize((size_t)6 * face_size * face_size * 4);
+		ok = fread(faces.data(), 1, faces.size(), file) == faces.size();
+	}
+	fclose(file);
+	return ok;
+}
+
+bool writeCubemapCache(const std::string& path, uint64_t source_hash, int face_size, const std::vector<unsigned char>& faces) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+
+	uint32_t header[3] = { CUBEMAP_CACHE_MAGIC, CUBEMAP_CACHE_VERSION, (uint32_t)face_size };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(&source_hash, sizeof(source_hash), 1, file) == 1 &&
+		fwrite(faces.data(), 1, faces.size(), file) == faces.size();
+	fclose(file);
+
+	// a half-written cache would only fail its read, but don't leave it around
+	if (!ok)
+		remove(path.c_str());
+	return ok;
+}
+
+bool SkyboxRenderer::create() {
+	Shader shader("src/shader_skybox.vert", "src/shader_skybox.frag");
+	GLint status = GL_FALSE;
+	glGetProgramiv(shader.program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		glDeleteProgram(shader.program);
+		return false;
+	}
+
+	if (program)
+		glDeleteProgram(program);
+	program = shader.program;
+	inverse_loc = glGetUniformLocation(program, "u_inverse_view_projection");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "u_skybox"), SKYBOX_UNIT);
+	glUseProgram(0);
+
+	if (!vao)
+		glGenVertexArrays(1, &vao);
+
+	// no visible edges where a direction crosses from one face to the next
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	return true;
+}
+
+void SkyboxRenderer::destroy() {
+	if (program) glDeleteProgram(program);
+	if (vao) glDeleteVertexArrays(1, &vao);
+	if (cubemap) glDeleteTextures(1, &cubemap);
+	program = 0;
+	inverse_loc = -1;
+	vao = 0;
+	cubemap = 0;
+	cubemap_size = 0;
+}
+
+void SkyboxRenderer::upload(int face_size, const std::vector<unsigned char>& faces) {
+	if (!cubemap) {
+		glGenTextures(1, &cubemap);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+
+	size_t face_bytes = (size_t)face_size * face_size * 4;
+	for (int face = 0; face < 6; face++) {
+		const unsigned char* data = faces.data() + face * face_bytes;
+		if (face_size == cubemap_size)
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, face_size, face_size, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		else
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, face_size, face_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	}
+	cubemap_size = face_size;
+
+	// the far sky is minified in a narrow fov
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+void SkyboxRenderer::draw(const glm::mat4& view_projection) {
+	glm::mat4 inverse_view_projection = glm::inverse(view_projection);
+
+	// on the far plane: passes only where the depth buffer still holds its clear value; nothing
+	// to write there
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_BLEND);
+
+	glActiveTexture(GL_TEXTURE0 + SKYBOX_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUseProgram(program);
+	glUniformMatrix4fv(inverse_loc, 1, GL_FALSE, &inverse_view_projection[0][0]);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// cube face size for an equirectangular image: its width over four (a face spans a quarter of
+// the horizon), up to the next power of two, at most 2048
+int cubemapFaceSize(int equirect_width);
+
+// resamples an equirectangular image (rows bottom-up, as stb_image loads them flipped) into the
+// six faces of a cube map, in GL face order (+x, -x, +y, -y, +z, -z), face_size^2 RGBA texels
+// each; the sky sphere's mapping, so both skybox modes show the same sky
+void equirectToCubemap(const unsigned char* pixels, int width, int height, int channels, int face_size,
+	std::vector<unsigned char>& faces, JobSystem* jobs = NULL);
+
+// faces converted before from a source whose content hashed to source_hash; false when the cache
+// is missing, from another source or unreadable
+bool readCubemapCache(const std::string& path, uint64_t source_hash, int& face_size, std::vector<unsigned char>& faces);
+bool writeCubemapCache(const std::string& path, uint64_t source_hash, int face_size, const std::vector<unsigned char>& faces);
+
+// ------------------------------------------------------------------------------------------
+// Cube map skybox drawn after the opaque pass, as one full-screen triangle on the far plane with
+// GL_LEQUAL: only pixels no geometry has covered run the sky shader, where drawing the sky sphere
+// first shaded every pixel twice and paid for its 100 KB of vertices. The view direction comes
+// back from the inverse view-projection per pixel, so perspective and orthographic both work.
+// ------------------------------------------------------------------------------------------
+class SkyboxRenderer {
+public:
+	// builds the program (shader_skybox.vert / .frag) and vao; again on a shader reload, the cube
+	// map is kept; false when the shaders fail
+	bool create();
+	void destroy();
+
+	bool ready() const { return program != 0 && cubemap != 0; }
+
+	// fills the cube map, reusing its name and storage when the face size is unchanged
+	void upload(int face_size, const std::vector<unsigned char>& faces);
+
+	// the depth buffer must hold the opaque pass; leaves depth test on, depth writes on and
+	// program / vao / texture unit 11 changed
+	void draw(const glm::mat4& view_projection);
+
+private:
+	GLuint program = 0;
+	GLint inverse_loc = -1;
+	GLuint vao = 0;				// empty, the triangle comes from gl_VertexID
+	GLuint cubemap = 0;
+	int cubemap_size = 0;
+};
@@ -0,0 +1,128 @@
+#include "StreamBuffer.h"
+#include "Log.h"
+
+void StreamBuffer::create(GLenum buffer_target, GLsizeiptr frame_size) {
+	destroy();
+
+	target = buffer_target;
+	region_size = frame_size;
+	persistent = GLEW_ARB_buffer_storage ? true : false;
+
+	// uniform / storage block ranges must start at the driver's alignment, vertices just stay vec4 aligned
+	alignment = 16;
+	if (target == GL_UNIFORM_BUFFER)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	else if (target == GL_SHADER_STORAGE_BUFFER)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	region_size = (region_size + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &id);
+	glBindBuffer(target, id);
+
+	GLsizeiptr total_size = region_size * STREAM_FRAMES;
+	if (persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, total_size, NULL, flags);
+		persistent_base = (unsigned char*)glMapBufferRange(target, 0, total_size, flags);
+
+		// immutable storage can't be respecified, a new buffer takes the map-per-frame path
+		if (!persistent_base) {
+			LOG_WARNING("stream buffer: persistent mapping of {} bytes failed, mapping per frame instead", total_size);
+			persistent = false;
+			glDeleteBuffers(1, &id);
+			glGenBuffers(1, &id);
+			glBindBuffer(target, id);
+		}
+	}
+	if (!persistent) {
+		glBufferData(target, total_size, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(target, 0);
+
+	LOG_INFO("stream buffer: {} bytes, {}", total_size, (persistent ? "persistent mapping" : "unsynchronised map per frame"));
+}
+
+void StreamBuffer::destroy() {
+	if (!id) return;
+
+	for (int i = 0; i < STREAM_FRAMES; i++) {
+		if (fences[i]) glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+
+	if (persistent_base) {
+		glBindBuffer(target, id);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+	}
+	glDeleteBuffers(1, &id);
+
+	id = 0;
+	persistent_base = NULL;
+	mapped = NULL;
+}
+
+void StreamBuffer::beginFrame() {
+	region = (region + 1) % STREAM_FRAMES;
+	head = 0;
+
+	// normally signalled long ago, this only blocks if the GPU is STREAM_FRAMES behind
+	if (fences[region]) {
+		GLenum result = glClientWaitSync(fences[region], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			stall_count++;
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);	// 1 ms
+		}
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+
+	if (persistent) {
+		mapped = persistent_base + region * region_size;
+	}
+	else {
+		// the fence already guarantees the GPU is done with this range, no need for the driver to check
+		glBindBuffer(target, id);
+		mapped = (unsigned char*)glMapBufferRange(target, region * region_size, region_size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		glBindBuffer(target, 0);
+	}
+}
+
+StreamAllocation StreamBuffer::allocate(GLsizeiptr size) {
+	StreamAllocation allocation;
+	allocation.data = NULL;
+	allocation.offset = 0;
+
+	GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+	if (!mapped || start + size > region_size) {
+		if (!overflow_reported) {
+			LOG_WARNING("stream buffer: frame region of {} bytes is full, dropping data", region_size);
+			overflow_reported = true;
+		}
+		return allocation;
+	}
+
+	head = start + size;
+	allocation.data = mapped + start;
+	allocation.offset = region * region_size + start;
+	return allocation;
+}
+
+void StreamBuffer::flush() {
+	// coherent persistent mappings need nothing
+	if (persistent || !mapped) return;
+
+	glBindBuffer(target, id);
+	if (head > 0)
+		glFlushMappedBufferRange(target, 0, head);	// relative to the mapped range
+	glUnmapBuffer(target);
+	glBindBuffer(target, 0);
+	mapped = NULL;
+}
+
+void StreamBuffer::endFrame() {
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
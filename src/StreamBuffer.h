@@ -0,0 +1,59 @@
+#pragma once
+#include <GL/glew.h>
+#include <stddef.h>
+
+// frames the CPU may run ahead of the GPU, each writes its own region of the buffer
+const int STREAM_FRAMES = 3;
+
+struct StreamAllocation {
+	void* data;			// write-only, NULL if the frame's region is full
+	GLintptr offset;	// from the start of the buffer, for glBindBufferRange / attribute pointers
+};
+
+// ------------------------------------------------------------------------------------------
+// Ring buffer for data rewritten every frame (uniform blocks, particle vertices, cull inputs).
+// The buffer is split into STREAM_FRAMES regions used round-robin, and each region is fenced
+// after the frame that used it, so by the time it comes around again the GPU is long done
+// with it and the CPU writes without any driver synchronisation.
+//
+// With ARB_buffer_storage the whole buffer is mapped once, persistent and coherent. Without
+// it each frame maps its region unsynchronised + invalidated and unmaps before drawing.
+//
+// Per frame, on the GL thread: beginFrame(), allocate() and write, flush(), draw, endFrame().
+// ------------------------------------------------------------------------------------------
+class StreamBuffer {
+public:
+	// frame_size bytes per region; target is the binding point used for mapping
+	void create(GLenum target, GLsizeiptr frame_size);
+	void destroy();
+
+	void beginFrame();
+	StreamAllocation allocate(GLsizeiptr size);
+
+	// makes this frame's writes visible to the GPU, must come before the draws that read them
+	void flush();
+
+	// fences the region behind the commands issued so far
+	void endFrame();
+
+	GLuint buffer() const { return id; }
+	bool isPersistent() const { return persistent; }
+
+	// times beginFrame() found its region still in use and had to block, should stay 0
+	unsigned stalls() const { return stall_count; }
+
+private:
+	GLenum target = GL_ARRAY_BUFFER;
+	GLuint id = 0;
+	GLsizeiptr region_size = 0;
+	GLint alignment = 1;
+	bool persistent = false;
+
+	unsigned char* persistent_base = NULL;	// whole buffer, persistent path only
+	unsigned char* mapped = NULL;			// current region while it is writable
+	int region = 0;
+	GLsizeiptr head = 0;					// bytes used in the current region
+	GLsync fences[STREAM_FRAMES] = {};
+	unsigned stall_count = 0;
+	bool overflow_reported = false;
+};
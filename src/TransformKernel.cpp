@@ -0,0 +1,171 @@
+#include "TransformKernel.h"
+#include "SceneGraph.h"
+#include <math.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TRANSFORM_USE_SSE2 1
+#endif
+
+void TransformSoA::clear() {
+	tx.clear(); ty.clear(); tz.clear();
+	rx.clear(); ry.clear(); rz.clear();
+	sx.clear(); sy.clear(); sz.clear();
+}
+
+void TransformSoA::push(const TransformationValues& transform) {
+	tx.push_back(transform.translation.x); ty.push_back(transform.translation.y); tz.push_back(transform.translation.z);
+	rx.push_back(transform.rotation.x); ry.push_back(transform.rotation.y); rz.push_back(transform.rotation.z);
+	sx.push_back(transform.scale.x); sy.push_back(transform.scale.y); sz.push_back(transform.scale.z);
+}
+
+// ------------------------------------------------------------------------------------------
+// R = Rx(a) * Ry(b) * Rz(c), written out by column:
+//   col0 = ( cb*cc,  ca*sc + sa*sb*cc,  sa*sc - ca*sb*cc )
+//   col1 = (-cb*sc,  ca*cc - sa*sb*sc,  sa*cc + ca*sb*sc )
+//   col2 = ( sb,    -sa*cb,             ca*cb            )
+// model  = [ col0*sx | col1*sy | col2*sz | t ]
+// normal = [ col0/sx | col1/sy | col2/sz ]
+// ------------------------------------------------------------------------------------------
+static void computeTransformScalar(const TransformSoA& in, size_t i, InstanceData& out) {
+	float sa = sinf(in.rx[i]), ca = cosf(in.rx[i]);
+	float sb = sinf(in.ry[i]), cb = cosf(in.ry[i]);
+	float sc = sinf(in.rz[i]), cc = cosf(in.rz[i]);
+
+	glm::vec3 c0(cb * cc, ca * sc + sa * sb * cc, sa * sc - ca * sb * cc);
+	glm::vec3 c1(-cb * sc, ca * cc - sa * sb * sc, sa * cc + ca * sb * sc);
+	glm::vec3 c2(sb, -sa * cb, ca * cb);
+
+	out.model[0] = glm::vec4(c0 * in.sx[i], 0.0f);
+	out.model[1] = glm::vec4(c1 * in.sy[i], 0.0f);
+	out.model[2] = glm::vec4(c2 * in.sz[i], 0.0f);
+	out.model[3] = glm::vec4(in.tx[i], in.ty[i], in.tz[i], 1.0f);
+
+	out.normal_matrix[0] = glm::vec4(c0 / in.sx[i], 0.0f);
+	out.normal_matrix[1] = glm::vec4(c1 / in.sy[i], 0.0f);
+	out.normal_matrix[2] = glm::vec4(c2 / in.sz[i], 0.0f);
+}
+
+#ifdef TRANSFORM_USE_SSE2
+
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// sine of four angles: reduce to [-pi, pi], fold into [-pi/2, pi/2], odd taylor polynomial to x^11 (error < 1e-7)
+static inline __m128 sin_ps(__m128 x) {
+	const __m128 pi = _mm_set1_ps(3.14159265f);
+	const __m128 half_pi = _mm_set1_ps(1.57079633f);
+	const __m128 two_pi = _mm_set1_ps(6.28318531f);
+	const __m128 inv_two_pi = _mm_set1_ps(0.159154943f);
+
+	__m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, inv_two_pi)));
+	x = _mm_sub_ps(x, _mm_mul_ps(k, two_pi));
+
+	__m128 neg_pi = _mm_sub_ps(_mm_setzero_ps(), pi);
+	__m128 neg_half_pi = _mm_sub_ps(_mm_setzero_ps(), half_pi);
+	x = select_ps(_mm_cmpgt_ps(x, half_pi), _mm_sub_ps(pi, x), x);
+	x = select_ps(_mm_cmplt_ps(x, neg_half_pi), _mm_sub_ps(neg_pi, x), x);
+
+	__m128 x2 = _mm_mul_ps(x, x);
+	__m128 p = _mm_set1_ps(-2.50521084e-8f);						// -1/11!
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.75573192e-6f));	//  1/9!
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.98412698e-4f));	// -1/7!
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.33333333e-3f));	//  1/5!
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.66666667e-1f));	// -1/3!
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+	return _mm_mul_ps(p, x);
+}
+
+static inline __m128 cos_ps(__m128 x) {
+	return sin_ps(_mm_add_ps(x, _mm_set1_ps(1.57079633f)));
+}
+
+// transposes four SoA column vectors (x, y, z, w lanes per object) and stores one vec4 per object
+static inline void storeColumn(__m128 x, __m128 y, __m128 z, __m128 w, float* dst0, float* dst1, float* dst2, float* dst3) {
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(dst0, x);
+	_mm_storeu_ps(dst1, y);
+	_mm_storeu_ps(dst2, z);
+	_mm_storeu_ps(dst3, w);
+}
+
+#endif
+
+void computeTransformsBatch(const TransformSoA& in, InstanceData* out) {
+	computeTransformsRange(in, 0, in.size(), out);
+}
+
+void computeTransformsRange(const TransformSoA& in, size_t begin, size_t end, InstanceData* out) {
+	size_t count = end;
+	size_t i = begin;
+
+#ifdef TRANSFORM_USE_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(&in.rx[i]);
+		__m128 b = _mm_loadu_ps(&in.ry[i]);
+		__m128 c = _mm_loadu_ps(&in.rz[i]);
+		__m128 sa = sin_ps(a), ca = cos_ps(a);
+		__m128 sb = sin_ps(b), cb = cos_ps(b);
+		__m128 sc = sin_ps(c), cc = cos_ps(c);
+
+		__m128 sa_sb = _mm_mul_ps(sa, sb);
+		__m128 ca_sb = _mm_mul_ps(ca, sb);
+
+		__m128 r00 = _mm_mul_ps(cb, cc);
+		__m128 r01 = _mm_add_ps(_mm_mul_ps(ca, sc), _mm_mul_ps(sa_sb, cc));
+		__m128 r02 = _mm_sub_ps(_mm_mul_ps(sa, sc), _mm_mul_ps(ca_sb, cc));
+		__m128 r10 = _mm_sub_ps(zero, _mm_mul_ps(cb, sc));
+		__m128 r11 = _mm_sub_ps(_mm_mul_ps(ca, cc), _mm_mul_ps(sa_sb, sc));
+		__m128 r12 = _mm_add_ps(_mm_mul_ps(sa, cc), _mm_mul_ps(ca_sb, sc));
+		__m128 r20 = sb;
+		__m128 r21 = _mm_sub_ps(zero, _mm_mul_ps(sa, cb));
+		__m128 r22 = _mm_mul_ps(ca, cb);
+
+		__m128 scale_x = _mm_loadu_ps(&in.sx[i]);
+		__m128 scale_y = _mm_loadu_ps(&in.sy[i]);
+		__m128 scale_z = _mm_loadu_ps(&in.sz[i]);
+		__m128 inv_x = _mm_div_ps(one, scale_x);
+		__m128 inv_y = _mm_div_ps(one, scale_y);
+		__m128 inv_z = _mm_div_ps(one, scale_z);
+
+		float* m0 = &out[i].model[0][0];
+		float* m1 = &out[i + 1].model[0][0];
+		float* m2 = &out[i + 2].model[0][0];
+		float* m3 = &out[i + 3].model[0][0];
+		storeColumn(_mm_mul_ps(r00, scale_x), _mm_mul_ps(r01, scale_x), _mm_mul_ps(r02, scale_x), zero, m0, m1, m2, m3);
+		storeColumn(_mm_mul_ps(r10, scale_y), _mm_mul_ps(r11, scale_y), _mm_mul_ps(r12, scale_y), zero, m0 + 4, m1 + 4, m2 + 4, m3 + 4);
+		storeColumn(_mm_mul_ps(r20, scale_z), _mm_mul_ps(r21, scale_z), _mm_mul_ps(r22, scale_z), zero, m0 + 8, m1 + 8, m2 + 8, m3 + 8);
+		storeColumn(_mm_loadu_ps(&in.tx[i]), _mm_loadu_ps(&in.ty[i]), _mm_loadu_ps(&in.tz[i]), one, m0 + 12, m1 + 12, m2 + 12, m3 + 12);
+
+		float* n0 = &out[i].normal_matrix[0][0];
+		float* n1 = &out[i + 1].normal_matrix[0][0];
+		float* n2 = &out[i + 2].normal_matrix[0][0];
+		float* n3 = &out[i + 3].normal_matrix[0][0];
+		storeColumn(_mm_mul_ps(r00, inv_x), _mm_mul_ps(r01, inv_x), _mm_mul_ps(r02, inv_x), zero, n0, n1, n2, n3);
+		storeColumn(_mm_mul_ps(r10, inv_y), _mm_mul_ps(r11, inv_y), _mm_mul_ps(r12, inv_y), zero, n0 + 4, n1 + 4, n2 + 4, n3 + 4);
+		storeColumn(_mm_mul_ps(r20, inv_z), _mm_mul_ps(r21, inv_z), _mm_mul_ps(r22, inv_z), zero, n0 + 8, n1 + 8, n2 + 8, n3 + 8);
+	}
+#endif
+
+	// remainder (or everything, without SSE2)
+	for (; i < count; i++)
+		computeTransformScalar(in, i, out[i]);
+}
+
+void combineInstanceData(const InstanceData& parent, const InstanceData& local, InstanceData& out) {
+	out.model = parent.model * local.model;
+
+	// (P * L)^-T = P^-T * L^-T, so normal matrices compose the same way
+	for (int c = 0; c < 3; c++) {
+		glm::vec4 l = local.normal_matrix[c];
+		out.normal_matrix[c] = parent.normal_matrix[0] * l.x + parent.normal_matrix[1] * l.y + parent.normal_matrix[2] * l.z;
+	}
+}
+
+glm::mat3 normalMatrix3(const InstanceData& data) {
+	return glm::mat3(glm::vec3(data.normal_matrix[0]), glm::vec3(data.normal_matrix[1]), glm::vec3(data.normal_matrix[2]));
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+struct TransformationValues;
+
+// per-object transform data in the layout the shaders consume (std140: mat4, then mat3 as three vec4 columns)
+struct InstanceData {
+	glm::mat4 model;
+	glm::vec4 normal_matrix[3];		// inverse-transpose of the model's upper 3x3, w unused
+};
+
+// translation / euler rotation / scale for many objects, one array per component
+struct TransformSoA {
+	std::vector<float> tx, ty, tz;
+	std::vector<float> rx, ry, rz;
+	std::vector<float> sx, sy, sz;
+
+	void clear();
+	void push(const TransformationValues& transform);
+	size_t size() const { return tx.size(); }
+};
+
+// ------------------------------------------------------------------------------------------
+// Builds translate * rotX * rotY * rotZ * scale and its normal matrix for every entry of in,
+// four objects per iteration with SSE2. The normal matrix uses the closed form R * S^-1
+// (rotation is orthonormal) instead of a general inverse. out must hold in.size() entries.
+// ------------------------------------------------------------------------------------------
+void computeTransformsBatch(const TransformSoA& in, InstanceData* out);
+
+// same for entries [begin, end) only, out is indexed like in; disjoint ranges can run in parallel
+void computeTransformsRange(const TransformSoA& in, size_t begin, size_t end, InstanceData* out);
+
+// out = parent * local, for both the model and the normal matrix
+void combineInstanceData(const InstanceData& parent, const InstanceData& local, InstanceData& out);
+
+glm::mat3 normalMatrix3(const InstanceData& data);
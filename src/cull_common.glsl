@@ -0,0 +1,59 @@
+// shared by cull.comp and cull_feedback.vert, the #version line is prepended when compiling
+
+uniform vec4 u_frustum[6];				// current frame, inside when dot(xyz, p) + w >= 0
+uniform mat4 u_prev_view_projection;	// camera the depth pyramid was built from
+uniform sampler2D u_depth_pyramid;		// max depth per texel, mip chain
+uniform vec2 u_pyramid_size;			// level 0 size in texels
+uniform int u_pyramid_levels;			// 0 = no pyramid yet, occlusion test off
+
+bool insideFrustum(vec4 sphere)
+{
+	for (int i = 0; i < 6; i++) {
+		if (dot(u_frustum[i].xyz, sphere.xyz) + u_frustum[i].w < -sphere.w)
+			return false;
+	}
+	return true;
+}
+
+// true only if the sphere is certainly behind last frame's depth
+bool occluded(vec4 sphere)
+{
+	if (u_pyramid_levels == 0)
+		return false;
+
+	// screen-space box of the sphere's bounding cube
+	vec3 lo = vec3(1e9);
+	vec3 hi = vec3(-1e9);
+	for (int i = 0; i < 8; i++) {
+		vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = u_prev_view_projection * vec4(corner, 1.0);
+		if (clip.w <= 0.0)
+			return false;	// reaches behind the camera, can't tell
+		vec3 ndc = clip.xyz / clip.w;
+		lo = min(lo, ndc);
+		hi = max(hi, ndc);
+	}
+
+	float nearest = lo.z * 0.5 + 0.5;
+	if (nearest <= 0.0)
+		return false;	// crosses the near plane
+
+	vec2 uv_lo = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0);
+	vec2 uv_hi = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0);
+
+	// the level where the box covers at most 2x2 texels, so four samples see all of it
+	vec2 extent = (uv_hi - uv_lo) * u_pyramid_size;
+	float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+	level = min(level, float(u_pyramid_levels - 1));
+
+	float farthest = max(
+		max(textureLod(u_depth_pyramid, uv_lo, level).r, textureLod(u_depth_pyramid, vec2(uv_hi.x, uv_lo.y), level).r),
+		max(textureLod(u_depth_pyramid, vec2(uv_lo.x, uv_hi.y), level).r, textureLod(u_depth_pyramid, uv_hi, level).r));
+
+	return nearest > farthest;
+}
+
+bool isVisible(vec4 sphere)
+{
+	return insideFrustum(sphere) && !occluded(sphere);
+}
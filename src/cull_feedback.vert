@@ -0,0 +1,20 @@
+// GL 3.3 culling: one point per draw, rasterizer off, the outputs are captured with
+// transform feedback straight into the indirect buffer in input order
+
+in vec4 a_sphere;		// world-space center, radius
+in uvec4 a_command;		// count, first_index, base_vertex, base_instance
+
+flat out uint f_count;
+flat out uint f_instance_count;
+flat out uint f_first_index;
+flat out int f_base_vertex;
+flat out uint f_base_instance;
+
+void main()
+{
+	f_count = a_command.x;
+	f_instance_count = isVisible(a_sphere) ? 1u : 0u;
+	f_first_index = a_command.y;
+	f_base_vertex = int(a_command.z);
+	f_base_instance = a_command.w;
+}
@@ -0,0 +1,37 @@
+#version 330
+
+// one point light per instance, drawn as a cube around its sphere of influence (no vertex buffer)
+
+in vec4 a_light_sphere;		// instanced: position, radius
+in vec4 a_light_color;		// instanced: color, intensity
+
+flat out vec4 v_light_sphere;
+flat out vec3 v_light_color;
+
+// per-frame values, streamed once per frame (same layout as in shader.vert)
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
+
+// corner i is (bit 0, bit 1, bit 2) mapped to -1 / +1, triangles counter-clockwise seen from outside
+const int cube[36] = int[36](
+	4, 6, 2, 4, 2, 0,	1, 3, 7, 1, 7, 5,
+	1, 5, 4, 1, 4, 0,	2, 6, 7, 2, 7, 3,
+	2, 3, 1, 2, 1, 0,	4, 5, 7, 4, 7, 6);
+
+void main()
+{
+	int corner = cube[gl_VertexID];
+	vec3 offset = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+
+	gl_Position = u_projection * u_view * vec4(a_light_sphere.xyz + offset * a_light_sphere.w, 1.0);
+
+	v_light_sphere = a_light_sphere;
+	v_light_color = a_light_color.rgb * a_light_color.a;
+}
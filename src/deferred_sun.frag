@@ -0,0 +1,57 @@
+#version 330
+
+// deferred lighting, full screen (with hiz.vert): ambient and the scene light for every pixel with
+// geometry, the same blinn-phong as shader.frag; pixels without geometry keep the skybox
+
+uniform sampler2D u_gbuffer_diffuse;
+uniform sampler2D u_gbuffer_normal;			// world normal, shininess
+uniform sampler2D u_gbuffer_specular;
+uniform sampler2D u_gbuffer_emissive;		// ambient color, or the night map with a = 1
+uniform sampler2D u_gbuffer_depth;
+uniform mat4 u_inverse_view_projection;
+
+// per-frame values, streamed once per frame (same layout as in shader.frag)
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
+
+out vec4 fragColor;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(u_gbuffer_depth, pixel, 0).r;
+	if (depth == 1.0)
+		discard;
+
+	vec4 emissive = texelFetch(u_gbuffer_emissive, pixel, 0);
+	if (emissive.a > 0.5) {
+		fragColor = vec4(emissive.rgb, 1.0);
+		return;
+	}
+
+	// world position back from the depth buffer
+	vec4 clip = vec4(gl_FragCoord.xy / vec2(textureSize(u_gbuffer_depth, 0)) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 world = u_inverse_view_projection * clip;
+	vec3 position = world.xyz / world.w;
+
+	vec4 normal_shininess = texelFetch(u_gbuffer_normal, pixel, 0);
+	vec3 normal = normal_shininess.xyz;
+
+	vec3 light = normalize(u_light - position);
+	float n_dot_l = max(dot(normal, light), 0.0f);
+	vec3 eye = normalize(u_cam_pos - position);
+	vec3 half_vector = normalize(light + eye);
+	float n_dot_h = max(dot(normal, half_vector), 0.0f);
+
+	vec3 diffuse = texelFetch(u_gbuffer_diffuse, pixel, 0).rgb * n_dot_l;
+	vec3 specular = texelFetch(u_gbuffer_specular, pixel, 0).rgb * pow(n_dot_h, normal_shininess.w);
+
+	fragColor = vec4((emissive.rgb + diffuse + specular) * u_light_intensity, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330
+
+// one level of the depth pyramid: the farthest depth of the texels below it
+
+// depth buffer copy, or the pyramid with its base level on the previous one; either way lod 0
+// of the fetches below is the source
+uniform sampler2D u_source;
+uniform ivec2 u_source_size;
+
+out float depth;
+
+void main()
+{
+	ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+	ivec2 last = u_source_size - 1;
+
+	float d = max(
+		max(texelFetch(u_source, min(base, last), 0).r, texelFetch(u_source, min(base + ivec2(1, 0), last), 0).r),
+		max(texelFetch(u_source, min(base + ivec2(0, 1), last), 0).r, texelFetch(u_source, min(base + ivec2(1, 1), last), 0).r));
+
+	// odd sizes: the last texel of this level also covers the source's extra column / row
+	bool extra_x = (u_source_size.x & 1) != 0 && base.x + 2 == last.x;
+	bool extra_y = (u_source_size.y & 1) != 0 && base.y + 2 == last.y;
+	if (extra_x) {
+		d = max(d, texelFetch(u_source, min(base + ivec2(2, 0), last), 0).r);
+		d = max(d, texelFetch(u_source, min(base + ivec2(2, 1), last), 0).r);
+	}
+	if (extra_y) {
+		d = max(d, texelFetch(u_source, min(base + ivec2(0, 2), last), 0).r);
+		d = max(d, texelFetch(u_source, min(base + ivec2(1, 2), last), 0).r);
+	}
+	if (extra_x && extra_y)
+		d = max(d, texelFetch(u_source, last, 0).r);
+
+	depth = d;
+}
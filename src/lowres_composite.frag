@@ -0,0 +1,73 @@
+#version 330
+
+// the low-res transparent target over the scene, premultiplied; bilinear where the four low-res
+// texels around the pixel lie on its surface, the one nearest its depth across an edge; weighted
+// blending is resolved here, the summed weights divided out and the revealage turned to coverage
+
+uniform sampler2D u_color;		// low-res, premultiplied; weighted: revealage in alpha
+uniform sampler2D u_weights;	// low-res, summed weights, weighted only
+uniform bool u_weighted;
+uniform sampler2D u_low_depth;	// low-res, farthest of each block
+uniform sampler2D u_depth;		// scene
+
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
+
+out vec4 fragColor;
+
+// depths further apart than this fraction of the distance are different surfaces
+const float EDGE_THRESHOLD = 0.1;
+
+// distance from the camera, for perspective and orthographic projections
+float viewDistance(float depth)
+{
+	float ndc = depth * 2.0 - 1.0;
+	if (u_projection[2][3] != 0.0)
+		return u_projection[3][2] / (ndc + u_projection[2][2]);
+	return (u_projection[3][2] - ndc) / u_projection[2][2];
+}
+
+// premultiplied color over the scene, from the accumulated color and summed weight
+vec4 resolve(vec4 accum, float weight)
+{
+	if (!u_weighted)
+		return accum;
+	float coverage = 1.0 - accum.a;
+	return vec4(accum.rgb / max(weight, 1e-5) * coverage, coverage);
+}
+
+void main()
+{
+	vec2 size = vec2(textureSize(u_depth, 0));
+	vec2 low_size = vec2(textureSize(u_color, 0));
+	vec2 uv = gl_FragCoord.xy / size;
+	float distance = viewDistance(texelFetch(u_depth, ivec2(gl_FragCoord.xy), 0).r);
+
+	// the four texels bilinear filtering blends here
+	ivec2 base = ivec2(floor(uv * low_size - 0.5));
+	ivec2 last = ivec2(low_size) - 1;
+	ivec2 nearest = clamp(base, ivec2(0), last);
+	float nearest_difference = 1e30;
+	float largest_difference = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 texel = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), last);
+		float difference = abs(viewDistance(texelFetch(u_low_depth, texel, 0).r) - distance);
+		if (difference < nearest_difference) {
+			nearest_difference = difference;
+			nearest = texel;
+		}
+		largest_difference = max(largest_difference, difference);
+	}
+
+	if (largest_difference < EDGE_THRESHOLD * distance)
+		fragColor = resolve(texture(u_color, uv), texture(u_weights, uv).r);
+	else
+		fragColor = resolve(texelFetch(u_color, nearest, 0), texelFetch(u_weights, nearest, 0).r);
+}
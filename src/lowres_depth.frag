@@ -0,0 +1,20 @@
+#version 330
+
+// one low-res texel: the farthest scene depth of its u_factor x u_factor block, so transparent
+// draws behind an opaque edge still pass where part of the block is open; drawn with hiz.vert
+
+uniform sampler2D u_depth;
+uniform int u_factor;
+
+void main()
+{
+	ivec2 base = ivec2(gl_FragCoord.xy) * u_factor;
+	ivec2 last = textureSize(u_depth, 0) - 1;
+
+	float farthest = 0.0;
+	for (int y = 0; y < u_factor; y++) {
+		for (int x = 0; x < u_factor; x++)
+			farthest = max(farthest, texelFetch(u_depth, min(base + ivec2(x, y), last), 0).r);
+	}
+	gl_FragDepth = farthest;
+}
@@ -18,6 +18,31 @@
 //include some custom code files
 #include "glfunctions.h"	//include all OpenGL stuff
 #include "Shader.h"			// class to compile shaders
+#include "RenderQueue.h"	// sort-key based draw ordering
+#include "Culling.h"		// bounding volumes and frustum culling
+#include "SceneGraph.h"		// transform hierarchy
+#include "Animation.h"		// fixed-timestep animation tracks
+#include "FramePipeline.h"	// command buffers and the render thread
+#include "JobSystem.h"		// worker threads for per-frame tasks
+#include "JobBenchmark.h"	// --bench-jobs
+#include "Particles.h"		// falling stars
+#include "StreamBuffer.h"	// per-frame uniform and vertex uploads
+#include "MeshPool.h"		// shared geometry buffers for indirect drawing
+#include "GpuCulling.h"		// frustum + hi-z occlusion culling on the gpu
+#include "MeshLod.h"		// mesh simplification and LOD selection
+#include "MeshOptimizer.h"	// vertex cache / overdraw / fetch reordering
+#include "Meshlets.h"		// clusters with cone culling for the big meshes
+#include "Deferred.h"		// G-buffer and light volumes for the opaque pass
+#include "LightGrid.h"		// clustered light lists for the forward shader
+#include "AssetRegistry.h"	// file versions for incremental reloads
+#include "Skybox.h"			// cube map sky drawn behind everything
+#include "Overdraw.h"		// opaque overdraw from occlusion queries
+#include "DynamicResolution.h"	// scene size from the gpu frame time
+#include "LowResTransparency.h"	// blended draws at a fraction of the scene's size
+#include "MeshStore.h"		// per-mesh components in dense arrays
+#include "Memory.h"			// allocation counting, per-frame arena
+#include "Log.h"			// asynchronous logging
+#include "CameraLatch.h"	// newest camera direction for the render thread
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -40,9 +65,12 @@ double mouse_x, mouse_y;	//variables storing mouse position
 const vec3 g_backgroundColor(0.0f, 0.0f, 0.0f); // background colour - a GLM 3-component vector
 
 // uniform location variables
-GLuint model_loc, view_loc, projection_loc, normal_loc, texture_loc, texture_normal_loc, texture_spec_loc, texture_night_loc;
-GLuint light_loc, light_intensity_loc, cam_pos_loc, ambient_loc, diffuse_loc, specular_loc, shininess_loc, alpha_loc;
-GLuint offset_loc, has_multi_loc;
+// (everything else lives in the FrameData / DrawData uniform blocks)
+GLuint texture_loc, texture_array_loc;
+GLint light_base_loc, light_count_loc, light_slicing_loc;
+GLint weighted_blend_loc;
+GLint point_scale_loc;
+GLint particle_weighted_loc;
 
 // if using orthographic project, and if using orbital camera settings
 bool orthographic = false;
@@ -51,10 +79,12 @@ bool orbital = false;
 
 // camera variables
 glm::vec3 cameraPos = vec3(0.0f, 5.0f, 5.0f);								// Pos: position of camera
+glm::vec3 cameraPrevPos = cameraPos;										// position at the previous simulation step
+glm::vec3 cameraRenderPos = cameraPos;										// blended between the two for drawing
 glm::vec3 cameraTarget = vec3(0.0f, 4.0f, -2.0f);							// Center: where you wanna look at in world space
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 glm::vec3 cameraRight = glm::normalize(glm::cross(cameraTarget, cameraUp));
-float cameraSpeed = 0.25f;
+float cameraSpeed = 3.0f;	// units per second while a movement key is held
 // would have created struct, but everything is declared here already, and they aren't used as often as other structs
 
 // fps camera variables
@@ -66,14 +96,72 @@ float lastY = 512.0f / 2.0f;
 float fov = 90.0f; //field of view
 
 GLuint g_simpleShader = 0;				// shader identifier
-std::vector <GLuint> g_vao;				// vao vector
-std::vector <GLuint> g_NumTriangles;	// num triangles vector
+GLuint g_particleShader = 0;			// particle shader identifier
+GLuint g_depthShader = 0;				// depth pre-pass, positions only
+GLuint g_overdrawShader = 0;			// overdraw view, same vertex shader
+GLint depth_offset_loc = -1, overdraw_offset_loc = -1;	// their u_draw_offset
+MeshPool mesh_pool;						// every obj in one vao, mesh i = objects[i]
 
 std::vector <std::string> objects;		// object vector
 std::vector < std::vector < tinyobj::shape_t > > shapesVector; // shapes vector
+std::vector <BoundingVolume> object_bounds;	// object-space bounds per shapesVector entry
+std::vector <MeshLodChain> object_lods;		// mesh pool entries of every object's LODs, finest first
+std::vector <MeshletSet> object_meshlets;	// clusters of LOD 0, empty for small objects
+std::vector < std::vector < std::vector <unsigned int> > > object_lod_indices;	// LOD 1.. of every object, kept to refill the mesh pool
 
 std::vector <std::string> textures;		// textures vector
-std::vector <GLuint> texture_ids;		// texture id vector
+GLuint texture_sky = 0;					// the skybox keeps a full-size texture of textures[0]
+GLuint texture_array = 0;				// every texture as one layer, layer i = textures[i]
+const GLsizei texture_array_size = 1024;	// layers are resampled to this size
+
+// one image from stb_image, decoded off the GL thread
+struct DecodedImage {
+	unsigned char* pixels;
+	int width, height, numChannels;
+};
+
+// every file load() reads, R re-imports the ones that changed on disk
+AssetRegistry asset_registry;
+
+// what each registry entry is loaded as, by AssetId
+enum AssetKind { ASSET_SHADER, ASSET_OBJECT, ASSET_TEXTURE };
+struct AssetUse {
+	AssetKind kind;
+	GLuint index;		// into shader_sources, objects or textures
+};
+std::vector <AssetUse> asset_uses;
+
+// shader source files and the programs built from them
+const unsigned SHADER_SCENE = 1;		// g_simpleShader
+const unsigned SHADER_PARTICLE = 2;		// g_particleShader
+const unsigned SHADER_DEFERRED = 4;		// deferred_renderer's programs
+const unsigned SHADER_SKY = 8;			// skybox's program
+const unsigned SHADER_DEPTH = 16;		// g_depthShader, g_overdrawShader and overdraw_meter's probe
+const unsigned SHADER_UPSCALE = 32;		// dynamic_resolution's program
+const unsigned SHADER_LOWRES = 64;		// low_res_transparency's programs
+struct ShaderSource {
+	const char* path;
+	unsigned programs;
+};
+const ShaderSource shader_sources[] = {
+	{ "src/shader.vert", SHADER_SCENE | SHADER_DEFERRED },
+	{ "src/shader.frag", SHADER_SCENE },
+	{ "src/shader_particle.vert", SHADER_PARTICLE },
+	{ "src/shader_particle.frag", SHADER_PARTICLE },
+	{ "src/shader_gbuffer.frag", SHADER_DEFERRED },
+	{ "src/hiz.vert", SHADER_DEFERRED | SHADER_UPSCALE | SHADER_LOWRES },
+	{ "src/deferred_sun.frag", SHADER_DEFERRED },
+	{ "src/deferred_light.vert", SHADER_DEFERRED },
+	{ "src/deferred_light.frag", SHADER_DEFERRED },
+	{ "src/shader_skybox.vert", SHADER_SKY | SHADER_DEPTH },
+	{ "src/shader_skybox.frag", SHADER_SKY },
+	{ "src/shader_depth.vert", SHADER_DEPTH },
+	{ "src/shader_depth.frag", SHADER_DEPTH },
+	{ "src/shader_overdraw.frag", SHADER_DEPTH },
+	{ "src/upscale.frag", SHADER_UPSCALE },
+	{ "src/lowres_depth.frag", SHADER_LOWRES },
+	{ "src/lowres_composite.frag", SHADER_LOWRES },
+};
 
 // for setting for loops and vector sizes
 GLuint objCount;						// objects.size(), but to be called later
@@ -104,70 +192,647 @@ GLfloat starZ = 0.0f;
 //GLuint model_loc_sky, view_loc_sky, projection_loc_sky;
 // skybox settings no longer needed as it is stored in index 0 of vectors
 
-// matrices for projection, view, and model
-// model matrices stored in vector for mesh parenting
+// matrices for projection and view
+// model matrices live in scene_graph, one node per mesh
 mat4 view_matrix, projection_matrix;
-std::vector <mat4> models;
+mat4 cull_projection_matrix;	// projection_matrix, widened by LATE_LATCH_MARGIN while late latching
 
 // delta time variables, for animation purposes
 GLfloat currentTime = 0.0f;
 GLfloat lastTime = 0.0f;
 GLfloat deltaTime = 0.0f;
 
+// fixed-timestep simulation state
+GLfloat sim_accumulator = 0.0f;		// real time not yet consumed by simulation steps
+unsigned long long sim_steps = 0;	// steps taken, sim time is sim_steps * SIM_TIMESTEP
+GLfloat sim_alpha = 0.0f;			// fraction of a step between the last simulated state and now
+bool vsync = true;					// V toggles, off to run the renderer uncapped
+
+// falling path settings
+const float fall_speed = 1.5f;		// Speed of movement
+const float loop_height = 15.0f;	// Total height of the motion path
+const int num_objects = 15;			// Total number of objects on the path (mesh 0 is the thread)
+
+AnimationSystem animation;
+GLFWwindow* g_window = NULL;
+
+// frames are recorded on the main thread and drawn on the render thread, which owns the GL context
+FramePipeline frame_pipeline;
+
+// per-frame work (animation, transforms, culling, particles) and asset decoding run on these
+JobSystem jobs;
+
 // particle variables
 std::vector<Particle> particles;
-initializeParticles(particles, 100); // Create 100 stars
+const float particle_floor = 0.0f;	// stars die here
+const float particle_top = 5.0f;	// and respawn between here and 5 units above
+
+// point lights: every falling star, and the star and coin meshes glow
+const float particle_light_radius = 1.5f;
+const float glow_light_radius = 3.0f;
+const glm::vec3 glow_light_color(1.0f, 0.85f, 0.5f);
+
+// every per-frame upload goes through these ring buffers (render thread only)
+const int max_stream_draws = 1024;			// DrawData blocks per frame, skybox included
+const int max_stream_commands = 4096;		// indirect commands per frame, one per mesh or meshlet range
+const int max_stream_particles = 4096;		// particle vertices per frame
+const int max_stream_lights = 4096;			// point lights per frame
+StreamBuffer uniform_stream;				// DrawData pages
+StreamBuffer frame_stream;					// the FrameData block, written just before the first draw
+StreamBuffer vertex_stream;
+StreamBuffer indirect_stream;				// DrawElementsIndirectCommands, indirect path without gpu culling
+StreamBuffer cull_stream;					// CullInputs, gpu culling only
+StreamBuffer light_stream;					// lights, cluster ranges and light indices, read through light_textures
+GLuint light_textures[3] = {};				// buffer textures over all of light_stream: RGBA32F, RG32UI, R16UI
+GLuint g_particle_vao = 0;
+std::vector <GLintptr> draw_page_offsets;	// DrawData page p of this frame holds draws [p * 64, p * 64 + 64)
+
+// one glMultiDrawElementsIndirect call per pass and DrawData page when the context supports it,
+// a loop of glDrawElementsBaseVertex on plain 3.3 contexts
+bool use_indirect = false;
+GLint draw_offset_loc = -1;
+
+// one index range of one draw: a whole mesh, or a run of its visible meshlets
+struct DrawRange {
+	GLuint slot;			// the draw's DrawData slot
+	MeshRange range;
+};
+std::vector <DrawRange> draw_ranges;
+
+// contiguous ranges sharing pass and DrawData page
+struct DrawRun {
+	RenderPass pass;
+	GLuint first_slot;		// frame-wide slot of the first draw (slot 0 is the skybox)
+	GLuint first_range;		// in draw_ranges, one indirect command each
+	GLuint count;			// ranges in the run
+	GLintptr indirect_offset;
+	bool compacted;			// gpu culled survivors were appended, their number is in the count buffer
+};
+std::vector <DrawRun> draw_runs;
+
+// with indirect drawing, visibility is decided on the gpu: the cpu queues every candidate and the
+// culling pass writes the indirect commands (set once on the render thread, before the first frame)
+GpuCuller gpu_culler;
+bool gpu_culling = false;
+
+// opaque draws fill a G-buffer and are lit once per pixel, with a light volume per point light
+// (set up by load(), render thread only); G toggles to clustered forward shading for comparison
+DeferredRenderer deferred_renderer;
+bool deferred_shading = true;
+
+// the sky as a cube map (converted from textures[0] at load, cached next to it) on one full-screen
+// triangle behind the opaque pass; B switches back to the sky sphere drawn first under everything
+SkyboxRenderer skybox;
+bool sky_cubemap = true;
+
+// the opaque pass can lay down depth first with g_depthShader and then shade only the nearest
+// fragment of each pixel (GL_EQUAL, no depth writes); E cycles auto / on / off, auto turns it on
+// past prepass_overdraw_on fragments per covered pixel and off again under prepass_overdraw_off
+// X shows the overdraw instead of the shaded scene
+OverdrawMeter overdraw_meter;
+DepthPrepassMode depth_prepass_mode = DEPTH_PREPASS_AUTO;
+bool depth_prepass_active = false;		// auto's last choice, render thread only
+bool overdraw_view = false;
+const float prepass_overdraw_on = 1.5f;
+const float prepass_overdraw_off = 1.25f;
+
+// the scene is drawn into an offscreen target sized to hold 60 fps on the gpu and scaled up to the
+// window (render thread only); H switches back to drawing at the window's size
+DynamicResolution dynamic_resolution;
+bool dynamic_scaling = true;
+
+// transparent draws and particles go into a target at 1 / transparency_divisor of the scene's
+// size and are composited over it (render thread only); U cycles full, half and quarter size
+LowResTransparency low_res_transparency;
+int transparency_divisor = 2;
+
+// order-independent transparency: blended draws are weighted by depth into the same target
+// instead of sorted back to front; F switches back to sorting
+bool weighted_transparency = true;
+
+// low_res_transparency.ready(), set by loadShaders() on the render thread while the main thread
+// waits for it; without the programs there is no weights target, so the frame is sorted instead
+bool low_res_linked = false;
+
+// weighted_transparency as buildFrame() records it, once per frame: the sort keys, the gpu culler's
+// compaction and the render thread's blending all follow this one value
+bool weighted_blending = false;
+
+// the render thread turns the recorded view to the newest polled mouse direction right before it
+// draws; frustum culling and the light grid are LATE_LATCH_MARGIN degrees wider so whatever the
+// turn brings into view is there. Y prints the input to swap latency and switches it
+bool late_latch = true;
+const float LATE_LATCH_MARGIN = 10.0f;
+CameraLatch camera_latch;
+double input_time = 0.0;			// glfwGetTime() at the last poll (main thread)
+double presented_input_time = 0.0;	// input behind the frame being drawn, for presentFrame() (render thread)
+
+// every scene mesh, entity ids in the order they were added
+MeshStore mesh_store;
+
+// star and coin, they light their surroundings
+std::vector <GLuint> glow_meshes;
+
+// world transforms for every mesh, parents before children
+SceneGraph scene_graph;
+
+// draws are submitted here by buildFrame() and issued in sort key order
+RenderQueue render_queue;
+
+// meshes considered for drawing this frame, only those inside the view frustum reach the render queue
+std::vector <RenderItem> cull_candidates;
+SphereCullBatch cull_batch;
+
+// buildFrame()'s transient data (sort scratch, culling results), released at the start of the next
+FrameArena frame_arena(64 * 1024);
+
+// heap allocations on all threads during the last main loop iteration, 0 once warmed up; C prints it
+uint64_t last_frame_allocations = 0;
+
+// points a program's FrameData / DrawData blocks at the shared binding points
+void bindUniformBlocks(GLuint program) {
+	GLuint frame_block = glGetUniformBlockIndex(program, "FrameData");
+	if (frame_block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame_block, FRAME_DATA_BINDING);
+
+	GLuint draw_block = glGetUniformBlockIndex(program, "DrawData");
+	if (draw_block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, draw_block, DRAW_DATA_BINDING);
+}
 
-struct TransformationValues {
-	// struct for transformation values
-	glm::vec3 translation, rotation, scale;
+// adds path to the asset registry as what it is loaded as
+void registerAsset(const std::string& path, AssetKind kind, GLuint index) {
+	AssetId id = asset_registry.add(path);
+	if (asset_uses.size() <= id)
+		asset_uses.resize(id + 1);
+	asset_uses[id].kind = kind;
+	asset_uses[id].index = index;
+}
 
-	// first constructor accepts 9 float values for translate's, rotate's, scale's xyz values
-	TransformationValues(float tx, float ty, float tz, float rx, float ry, float rz, float sx, float sy, float sz) : translation(tx, ty, tz), rotation(rx, ry, rz), scale(sx, sy, sz) {}
+// ------------------------------------------------------------------------------------------
+// This function creates the streaming buffers, once, on the render thread
+// ------------------------------------------------------------------------------------------
+void createStreamBuffers()
+{
+	// base_instance has to reach the instanced a_draw_id for the indirect path
+	use_indirect = (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance) ? true : false;
+	LOG_INFO("draw path: {}", (use_indirect ? "multi-draw indirect" : "glDrawElementsBaseVertex loop"));
+
+	// 256: worst-case block alignment
+	GLsizeiptr page_size = DRAW_SLOTS_PER_BLOCK * sizeof(DrawUniforms);
+	GLsizeiptr page_count = (max_stream_draws + DRAW_SLOTS_PER_BLOCK - 1) / DRAW_SLOTS_PER_BLOCK;
+	uniform_stream.create(GL_UNIFORM_BUFFER, page_count * (page_size + 256));
+	frame_stream.create(GL_UNIFORM_BUFFER, sizeof(FrameUniforms));
+	vertex_stream.create(GL_ARRAY_BUFFER, max_stream_particles * sizeof(ParticleVertex));
+
+	// a buffer texture can't view a range before GL 4.3, so each one covers the whole ring and
+	// shader.frag adds this frame's first texel (u_light_base); allocations stay 16-byte aligned
+	light_stream.create(GL_TEXTURE_BUFFER, max_stream_lights * sizeof(PointLight) + LIGHT_GRID_CLUSTERS * 2 * sizeof(GLuint) + LIGHT_GRID_MAX_INDICES * sizeof(GLushort) + 3 * 16);
+	static const GLenum light_formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+	glGenTextures(3, light_textures);
+	for (int i = 0; i < 3; i++) {
+		glBindTexture(GL_TEXTURE_BUFFER, light_textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, light_formats[i], light_stream.buffer());
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	// runs split on pages and once more between the opaque and transparent passes
+	GpuCullMode cull_mode = gpu_culler.create(use_indirect, max_stream_commands, (GLuint)page_count + 1);
+	gpu_culling = cull_mode != GPU_CULL_NONE;
+	if (gpu_culling)
+		cull_stream.create(cull_mode == GPU_CULL_COMPUTE ? GL_SHADER_STORAGE_BUFFER : GL_ARRAY_BUFFER, max_stream_commands * sizeof(CullInput));
+	else if (use_indirect)
+		indirect_stream.create(GL_DRAW_INDIRECT_BUFFER, max_stream_commands * sizeof(DrawElementsIndirectCommand));
+
+	// attribute pointers are set per frame, the particles' offset in the stream changes
+	glGenVertexArrays(1, &g_particle_vao);
+}
 
-	// second constructor accepts 3 vec3 values for translate, rotate, scale vec3 values
-	TransformationValues(glm::vec3 t, glm::vec3 r, glm::vec3 s) : translation(t), rotation(r), scale(s) {}
-};
+void destroyStreamBuffers()
+{
+	uniform_stream.destroy();
+	frame_stream.destroy();
+	vertex_stream.destroy();
+	indirect_stream.destroy();
+	cull_stream.destroy();
+	light_stream.destroy();
+	glDeleteTextures(3, light_textures);
+	gpu_culler.destroy();
+	deferred_renderer.destroy();
+	skybox.destroy();
+	overdraw_meter.destroy();
+	dynamic_resolution.destroy();
+	low_res_transparency.destroy();
+	glDeleteProgram(g_depthShader);
+	glDeleteProgram(g_overdrawShader);
+	g_depthShader = g_overdrawShader = 0;
+	glDeleteVertexArrays(1, &g_particle_vao);
+	g_particle_vao = 0;
+}
 
-struct MaterialProperties {
-	// struct for material properties
-	glm::vec3 ambient, diffuse, specular;
-	GLfloat shininess, alpha;
+// ------------------------------------------------------------------------------------------
+// This function creates texture_array with one black layer per texture, importTextures() fills them
+// ------------------------------------------------------------------------------------------
+void createTextureArray()
+{
+	glGenTextures(1, &texture_array);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, texture_array_size, texture_array_size, texCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// black like sampling the empty texture was, for the ones that fail to load (a layered
+	// attachment clears every layer at once)
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_array, 0);
+	GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	glClearBufferfv(GL_COLOR, 0, black);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+
+	LOG_INFO("texture array: {} layers of {}x{}", texCount, texture_array_size, texture_array_size);
+}
 
-	// constructor accepts 3 vec3 values for ambient, diffuse, specular, then 2 Glfloat values for shininess and alpha
-	MaterialProperties(glm::vec3 ambi, glm::vec3 diff, glm::vec3 spec, GLfloat shiny, GLfloat transparency) : ambient(ambi), diffuse(diff), specular(spec), shininess(shiny), alpha(transparency) {}
-};
+// ------------------------------------------------------------------------------------------
+// This function puts a decoded image into texture, keeping its name, and its storage too when the
+// size and channels are the same as what it holds (level 0 only, nothing samples it minified)
+// ------------------------------------------------------------------------------------------
+void uploadImage(GLuint& texture, const DecodedImage& image)
+{
+	GLenum format = image.numChannels == 4 ? GL_RGBA : GL_RGB;
+	GLint internal_format = image.numChannels == 4 ? GL_RGBA8 : GL_RGB8;
 
-// mat4 model_parent, TransformationValues transform, MaterialProperties material
+	if (!texture) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
 
-struct Mesh {
-	// struct for mesh
-	TransformationValues transform;
-	MaterialProperties material;
-	GLuint object_index;
-	GLuint texture_index;
-	mat4 model_matrix;
-	string mesh_name;
+	GLint width = 0, height = 0, current_format = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &current_format);
 
-	// constructor 
-	Mesh(string name, GLuint object_i, GLuint texture_i, TransformationValues t_values, MaterialProperties m_props) : mesh_name(name), object_index(object_i), texture_index(texture_i), transform(t_values), material(m_props) {}
-};
+	if (width == image.width && height == image.height && current_format == internal_format)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, image.pixels);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+}
 
-std::vector <Mesh> meshes;
+// swaps a freshly built program in for program and frees the old one, unless it failed to link
+// and there is an old one to keep
+bool replaceProgram(GLuint& program, GLuint replacement, const char* name)
+{
+	GLint status = GL_FALSE;
+	glGetProgramiv(replacement, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE && program) {
+		LOG_WARNING("Shader: {} failed to link, keeping the previous program", name);
+		glDeleteProgram(replacement);
+		return false;
+	}
 
-struct Particle {
-	glm::vec3 position;   // 3D position of the star
-	glm::vec3 velocity;   // Velocity of the star (falling motion)
-	float lifetime;       // Time until the star disappears
-	float size;           // Size of the star
-	glm::vec4 color;      // Color (RGBA) of the star
-	bool active;          // Whether the particle is active
-};
+	if (program)
+		glDeleteProgram(program);
+	program = replacement;
+	return true;
+}
 
+// ------------------------------------------------------------------------------------------
+// This function (re)builds the programs in programs (SHADER_* bits) from their source files and
+// sets up their uniforms; a program that fails to link on a reload keeps the previous one
+// returns the programs that were replaced
+// ------------------------------------------------------------------------------------------
+unsigned loadShaders(unsigned programs)
+{
+	unsigned replaced = 0;
+
+	if (programs & SHADER_SCENE) {
+		Shader simpleShader("src/shader.vert", "src/shader.frag");
+		if (replaceProgram(g_simpleShader, simpleShader.program, "scene")) {
+			replaced |= SHADER_SCENE;
+			bindUniformBlocks(g_simpleShader);
+			draw_offset_loc = glGetUniformLocation(g_simpleShader, "u_draw_offset");
+
+			// samplers never change: skybox on unit 0, the array on unit 1
+			glUseProgram(g_simpleShader);
+			texture_loc = glGetUniformLocation(g_simpleShader, "u_texture");
+			glUniform1i(texture_loc, 0);
+			texture_array_loc = glGetUniformLocation(g_simpleShader, "u_texture_array");
+			glUniform1i(texture_array_loc, 1);
+
+			// clustered lights on units 8 to 10, clear of the deferred path's and gpu culling's units
+			glUniform1i(glGetUniformLocation(g_simpleShader, "u_lights"), 8);
+			glUniform1i(glGetUniformLocation(g_simpleShader, "u_light_clusters"), 9);
+			glUniform1i(glGetUniformLocation(g_simpleShader, "u_light_indices"), 10);
+			light_base_loc = glGetUniformLocation(g_simpleShader, "u_light_base");
+			light_count_loc = glGetUniformLocation(g_simpleShader, "u_light_count");
+			light_slicing_loc = glGetUniformLocation(g_simpleShader, "u_light_slicing");
+			weighted_blend_loc = glGetUniformLocation(g_simpleShader, "u_weighted_blend");
+			glUseProgram(0);
+
+			// the G-buffer and depth passes are relinked with this program's attribute locations
+			programs |= SHADER_DEFERRED | SHADER_DEPTH;
+		}
+	}
+
+	if (programs & SHADER_PARTICLE) {
+		Shader particleShader("src/shader_particle.vert", "src/shader_particle.frag");
+		if (replaceProgram(g_particleShader, particleShader.program, "particle")) {
+			replaced |= SHADER_PARTICLE;
+			bindUniformBlocks(g_particleShader);
+			point_scale_loc = glGetUniformLocation(g_particleShader, "u_point_scale");
+			particle_weighted_loc = glGetUniformLocation(g_particleShader, "u_weighted_blend");
+		}
+	}
 
-float randomFloat(float min, float max) {
-	float random = static_cast<float>(rand()) / static_cast<float>(RAND_MAX); // Generate [0, 1]
-	return min + random * (max - min); // Scale to [min, max]
+	// G-buffer pass shares shader.vert, lighting passes read the G-buffer
+	if (programs & SHADER_DEFERRED) {
+		deferred_renderer.create(g_simpleShader);
+		replaced |= SHADER_DEFERRED;
+	}
+
+	if (programs & SHADER_SKY) {
+		if (skybox.create())
+			replaced |= SHADER_SKY;
+		else
+			LOG_WARNING("Shader: skybox failed to link");
+	}
+
+	// these draw from the mesh pool's position-only vao, which has the scene program's locations
+	if (programs & SHADER_DEPTH) {
+		Shader depthShader("src/shader_depth.vert", "src/shader_depth.frag");
+		Shader overdrawShader("src/shader_depth.vert", "src/shader_overdraw.frag");
+		static const char* const attributes[] = { "a_vertex", "a_draw_id" };
+		for (int i = 0; i < 2; i++) {
+			GLint location = glGetAttribLocation(g_simpleShader, attributes[i]);
+			if (location < 0) continue;
+			glBindAttribLocation(depthShader.program, location, attributes[i]);
+			glBindAttribLocation(overdrawShader.program, location, attributes[i]);
+		}
+		glLinkProgram(depthShader.program);
+		glLinkProgram(overdrawShader.program);
+
+		if (replaceProgram(g_depthShader, depthShader.program, "depth")) {
+			replaced |= SHADER_DEPTH;
+			bindUniformBlocks(g_depthShader);
+			depth_offset_loc = glGetUniformLocation(g_depthShader, "u_draw_offset");
+		}
+		if (replaceProgram(g_overdrawShader, overdrawShader.program, "overdraw")) {
+			replaced |= SHADER_DEPTH;
+			bindUniformBlocks(g_overdrawShader);
+			overdraw_offset_loc = glGetUniformLocation(g_overdrawShader, "u_draw_offset");
+		}
+		if (!overdraw_meter.create())
+			LOG_WARNING("Shader: overdraw probe failed to link");
+
+		// nothing to keep from the first load: without a depth program the prepass can't lay down
+		// the depth the shading pass tests against, so it stays off
+		GLuint* depth_programs[2] = { &g_depthShader, &g_overdrawShader };
+		for (int i = 0; i < 2; i++) {
+			GLint status = GL_FALSE;
+			glGetProgramiv(*depth_programs[i], GL_LINK_STATUS, &status);
+			if (status != GL_TRUE) {
+				glDeleteProgram(*depth_programs[i]);
+				*depth_programs[i] = 0;
+			}
+		}
+	}
+
+	if (programs & SHADER_UPSCALE) {
+		if (dynamic_resolution.create())
+			replaced |= SHADER_UPSCALE;
+		else
+			LOG_WARNING("Shader: upscale failed to link");
+	}
+
+	if (programs & SHADER_LOWRES) {
+		if (low_res_transparency.create())
+			replaced |= SHADER_LOWRES;
+		else
+			LOG_WARNING("Shader: low-res transparency failed to link");
+		low_res_linked = low_res_transparency.ready();
+	}
+
+	return replaced;
+}
+
+// ------------------------------------------------------------------------------------------
+// This function re-imports the objs in changed on the job system (parse, reorder for the gpu
+// caches, bounds, meshlets, LODs), then refills the mesh pool from every object's data
+// ------------------------------------------------------------------------------------------
+void importObjects(const std::vector <GLuint>& changed)
+{
+	// parsed on the side, so an obj that fails to load keeps the geometry it had
+	// (unsigned char, not bool: vector<bool> packs bits and can't be written from several threads)
+	std::vector < std::vector < tinyobj::shape_t > > parsed(changed.size());
+	std::vector <unsigned char> ret(changed.size());
+	jobs.parallelFor(changed.size(), 1, [&changed, &parsed, &ret](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; k++)
+			ret[k] = tinyobj::LoadObj(parsed[k], objects[changed[k]].c_str());
+	});
+
+	std::vector <GLuint> imported;
+	for (size_t k = 0; k < changed.size(); k++) {
+		GLuint i = changed[k];
+		if (ret[k] && !parsed[k].empty()) {
+			LOG_INFO("OBJ File: {} successfully loaded!", objects[i]);
+			shapesVector[i].swap(parsed[k]);
+			imported.push_back(i);
+		}
+		else {
+			LOG_WARNING("OBJ File: {} cannot be found or is not valid OBJ file.", objects[i]);
+		}
+	}
+
+	// triangles and vertices reordered for the gpu caches (as exported they are in face group order),
+	// bounds for frustum culling, and simplified index lists for the detailed objs
+	std::vector <float> acmr_before(imported.size()), acmr_after(imported.size());
+	jobs.parallelFor(imported.size(), 1, [&imported, &acmr_before, &acmr_after](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; k++) {
+			GLuint i = imported[k];
+			tinyobj::mesh_t& mesh = shapesVector[i][0].mesh;
+			size_t vertex_count = mesh.positions.size() / 3;
+
+			acmr_before[k] = computeAcmr(mesh.indices, vertex_count);
+			optimizeVertexCache(mesh.indices, vertex_count);
+			optimizeOverdraw(mesh.indices, mesh.positions, 1.05f);
+			object_meshlets[i] = MeshletSet();
+			if (mesh.indices.size() / 3 >= MESHLET_MIN_TRIANGLES)
+				object_meshlets[i].build(mesh.positions, mesh.indices);
+			optimizeVertexFetch(mesh.indices, mesh.positions, mesh.texcoords, mesh.normals);
+			acmr_after[k] = computeAcmr(mesh.indices, vertex_count);
+
+			object_bounds[i] = computeBoundingVolume(mesh.positions);
+			generateLods(mesh.positions, mesh.texcoords, mesh.indices, object_bounds[i].sphere.radius, object_lod_indices[i]);
+			for (size_t l = 0; l < object_lod_indices[i].size(); l++)
+				optimizeVertexCache(object_lod_indices[i][l], vertex_count);
+		}
+	});
+
+	for (size_t k = 0; k < imported.size(); k++) {
+		GLuint i = imported[k];
+		if (object_meshlets[i].empty())
+			LOG_INFO("ACMR: {}: {} -> {}", objects[i], acmr_before[k], acmr_after[k]);
+		else
+			LOG_INFO("ACMR: {}: {} -> {}, {} meshlets", objects[i], acmr_before[k], acmr_after[k], object_meshlets[i].size());
+
+		if (object_lod_indices[i].empty()) continue;
+		char chain[MAX_LODS * 16] = "";
+		for (size_t l = 0; l < object_lod_indices[i].size(); l++)
+			snprintf(chain + strlen(chain), sizeof(chain) - strlen(chain), " -> %u", (unsigned)(object_lod_indices[i][l].size() / 3));
+		LOG_INFO("LODs: {}: {}{} triangles", objects[i], shapesVector[i][0].mesh.indices.size() / 3, chain);
+	}
+
+	// the pool is one set of buffers, so it is refilled from every object (a copy, only the objs
+	// above were processed) and uploaded into the same buffers
+	// all objs go in the same order, so object i is mesh i of the pool; one that never loaded is empty
+	static const std::vector <float> no_floats;
+	static const std::vector <unsigned int> no_indices;
+	mesh_pool.clearMeshes();
+	for (GLuint i = 0; i < objCount; i++) {
+		// for skybox settings, they use regular shaders, but a component will indicate it is a skybox
+		if (shapesVector[i].empty()) {
+			mesh_pool.add(no_floats, no_floats, no_floats, no_indices);
+		}
+		else {
+			const tinyobj::mesh_t& mesh = shapesVector[i][0].mesh;
+			mesh_pool.add(mesh.positions, mesh.texcoords, mesh.normals, mesh.indices);
+		}
+		object_lods[i].count = 1;
+		object_lods[i].pool_mesh[0] = i;
+	}
+
+	// the LODs after them, sharing their object's vertices
+	for (GLuint i = 0; i < objCount; i++) {
+		for (size_t l = 0; l < object_lod_indices[i].size(); l++)
+			object_lods[i].pool_mesh[object_lods[i].count++] = mesh_pool.addIndices(i, object_lod_indices[i][l]);
+	}
+	mesh_pool.upload(g_simpleShader, DRAW_SLOTS_PER_BLOCK);
+}
+
+// ------------------------------------------------------------------------------------------
+// This function gives the skybox its cube map from the equirectangular textures[0], read back from
+// the cache next to it when that was converted from the same file content
+// ------------------------------------------------------------------------------------------
+void loadSkyCubemap(const DecodedImage& image)
+{
+	std::string cache_path = textures[0] + ".cube";
+	uint64_t source_hash = asset_registry.hash(asset_registry.add(textures[0]));
+
+	int face_size = 0;
+	std::vector <unsigned char> faces;
+	if (readCubemapCache(cache_path, source_hash, face_size, faces)) {
+		LOG_INFO("skybox: {}, 6 faces of {}x{}", cache_path, face_size, face_size);
+	}
+	else {
+		face_size = cubemapFaceSize(image.width);
+		equirectToCubemap(image.pixels, image.width, image.height, image.numChannels, face_size, faces, &jobs);
+		bool cached = writeCubemapCache(cache_path, source_hash, face_size, faces);
+		LOG_INFO("skybox: {} converted to 6 faces of {}x{}{}", textures[0], face_size, face_size, (cached ? ", cached" : ", not cached"));
+	}
+	skybox.upload(face_size, faces);
+}
+
+// ------------------------------------------------------------------------------------------
+// This function re-imports the textures in changed: decoded on the job system, then textures[0]
+// goes into the skybox's texture and every other one into its texture_array layer, scaled to
+// the common size by the gpu (framebuffer blits); one that fails to load keeps its old image
+// ------------------------------------------------------------------------------------------
+void importTextures(const std::vector <GLuint>& changed)
+{
+	// decode on the job system, only the uploads below need the GL thread
+	std::vector <DecodedImage> decoded(changed.size());
+	stbi_set_flip_vertically_on_load(true); // remove if texture is flipped
+	jobs.parallelFor(changed.size(), 1, [&changed, &decoded](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; k++)
+			decoded[k].pixels = stbi_load(textures[changed[k]].c_str(), &decoded[k].width, &decoded[k].height, &decoded[k].numChannels, 0);
+	});
+
+	GLuint staging = 0;		// every layer's image on its way into the array
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+	bool layers_changed = false;
+
+	for (size_t k = 0; k < changed.size(); k++) {
+		GLuint i = changed[k];
+		const DecodedImage& image = decoded[k];
+		int width = image.width, height = image.height, numChannels = image.numChannels;
+
+		// if-else statement created to not run into error when numChannels is different (RGB, RGBA)
+		bool loaded = image.pixels && (numChannels == 4 || numChannels == 3);
+		if (loaded)
+			LOG_INFO("texture_index[{}]: Successfully loaded: Texture {} with a width of {}, a height of {}, and uses {} channels.", i, textures[i], width, height, numChannels);
+		else if (image.pixels)
+			LOG_WARNING("texture_index[{}]: Failed to load: Texture {} with a width of {}, a height of {}, and uses {} channels. (error: channel)", i, textures[i], width, height, numChannels);
+		else
+			LOG_WARNING("texture_index[{}]: Failed to load: Texture: {} with a width of {}, a height of {}, and uses {} channels. (error: pixels)", i, textures[i], width, height, numChannels);
+
+		if (loaded && i == 0) {
+			// the sky sphere keeps its full-size texture, the cube map sky is made from it
+			uploadImage(texture_sky, image);
+			loadSkyCubemap(image);
+		}
+		else if (loaded) {
+			uploadImage(staging, image);
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, staging, 0);
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_array, 0, i);
+			glBlitFramebuffer(0, 0, width, height, 0, 0, texture_array_size, texture_array_size, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			layers_changed = true;
+		}
+		stbi_image_free(image.pixels);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(2, framebuffers);
+	if (staging)
+		glDeleteTextures(1, &staging);
+
+	if (layers_changed) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+}
+
+// ------------------------------------------------------------------------------------------
+// This function re-imports every asset whose file changed since it was last imported (all of
+// them the first time), so R costs what changed rather than a whole load(); frames recorded
+// before a change are dropped by draw(), they may point at replaced geometry
+// ------------------------------------------------------------------------------------------
+void reloadAssets()
+{
+	double start = glfwGetTime();
+
+	std::vector <AssetId> changed;
+	asset_registry.refresh(changed, &jobs);
+
+	unsigned changed_programs = 0;
+	std::vector <GLuint> changed_objects, changed_textures;
+	for (size_t k = 0; k < changed.size(); k++) {
+		const AssetUse& use = asset_uses[changed[k]];
+		if (use.kind == ASSET_SHADER)
+			changed_programs |= shader_sources[use.index].programs;
+		else if (use.kind == ASSET_OBJECT)
+			changed_objects.push_back(use.index);
+		else
+			changed_textures.push_back(use.index);
+	}
+
+	// programs first, the mesh pool's vao takes the scene program's attribute locations
+	unsigned replaced_programs = loadShaders(changed_programs);
+	if (!changed_objects.empty())
+		importObjects(changed_objects);
+	else if (replaced_programs & SHADER_SCENE)
+		mesh_pool.upload(g_simpleShader, DRAW_SLOTS_PER_BLOCK);
+	if (!changed_textures.empty())
+		importTextures(changed_textures);
+
+	LOG_INFO("assets: {} of {} changed ({} objs, {} textures), {} ms", changed.size(), asset_registry.size(), changed_objects.size(), changed_textures.size(), (glfwGetTime() - start) * 1000.0);
 }
 
 // ------------------------------------------------------------------------------------------
@@ -183,9 +848,9 @@ void load()
 	//g_simpleShader_sky = simpleShaderSky.program;
 	// although regular shader file was redesigned to not need this
 
-	//load regular shader
-	Shader simpleShader("src/shader.vert", "src/shader.frag");
-	g_simpleShader = simpleShader.program;
+	// shader sources, compiled by reloadAssets() below
+	for (GLuint i = 0; i < sizeof(shader_sources) / sizeof(shader_sources[0]); i++)
+		registerAsset(shader_sources[i].path, ASSET_SHADER, i);
 
 	// put obj file paths into a vector
 	objects.push_back("assets/sphere.obj");
@@ -204,58 +869,16 @@ void load()
 	objects.push_back("assets/plane.obj");
 
 	objCount = objects.size();
-	models.resize(objCount);
-	g_vao.resize(objCount);
-	g_NumTriangles.resize(objCount);
+	for (GLuint i = 0; i < objCount; i++)
+		registerAsset(objects[i], ASSET_OBJECT, i);
 
 	// shapes vector getting its size based on number of objects
-	for (int i = 0; i < objCount; i++)
-		shapesVector.emplace_back();
-
-	std::vector <bool> ret(objCount);
-	for (int i = 0; i < objCount; i++) {
-		ret[i] = tinyobj::LoadObj(shapesVector[i], objects[i].c_str());
-
-		if (ret[i]) {
-			cout << "OBJ File: " << objects[i] << " successfully loaded!\n";
-		}
-		else {
-			cout << "OBJ File: " << objects[i] << " cannot be found or is not valid OBJ file.\n";
-		}
-	}
-
-	for (int i = 0; i < objCount; i++) {
-		GLuint chosen_shader = g_simpleShader;
-		g_vao[i] = gl_createAndBindVAO();
-		std::cout << "vao: " << g_vao[i] << "\n";
-
-		// for skybox settings, they use regular shaders, but a component will indicate it is a skybox
-
-		gl_createAndBindAttribute(&(shapesVector[i][0].mesh.positions[0]),
-			shapesVector[i][0].mesh.positions.size() * sizeof(float),
-			chosen_shader, "a_vertex", 3
-		);
-
-		gl_createIndexBuffer(&(shapesVector[i][0].mesh.indices[0]),
-			shapesVector[i][0].mesh.indices.size() * sizeof(unsigned int)
-		);
-
-		gl_createAndBindAttribute(&(shapesVector[i][0].mesh.texcoords[0]),
-			shapesVector[i][0].mesh.texcoords.size() * sizeof(float),
-			chosen_shader, "a_uv", 2
-		);
-
-		gl_createAndBindAttribute(&(shapesVector[i][0].mesh.normals[0]),
-			shapesVector[i][0].mesh.normals.size() * sizeof(float),
-			chosen_shader, "a_normal", 3
-		);
+	shapesVector.resize(objCount);
+	object_bounds.resize(objCount);
+	object_lods.assign(objCount, MeshLodChain());
+	object_lod_indices.resize(objCount);
+	object_meshlets.resize(objCount);
 
-		gl_unbindVAO();
-
-		//store number of triangles (use in draw())
-		g_NumTriangles[i] = shapesVector[i][0].mesh.indices.size() / 3;
-	}
-	
 	// put texture file paths into a vector
 	textures.push_back("textures/milkyway.bmp");
 	textures.push_back("textures/Thread.png");
@@ -280,70 +903,20 @@ void load()
 	textures.push_back("textures/earthnight.bmp");		// index 20 - 3 indices noted for hard-coded multi-texturing
 
 	texCount = textures.size();
-	texture_ids.resize(texCount);
-
-	for (int i = 0; i < texCount; i++) {
-		int width, height, numChannels;
+	for (GLuint i = 0; i < texCount; i++)
+		registerAsset(textures[i], ASSET_TEXTURE, i);
 
-		stbi_set_flip_vertically_on_load(true); // remove if texture is flipped
-		unsigned char* pixels = stbi_load(textures[i].c_str(), &width, &height, &numChannels, 0);
-		glGenTextures(1, &texture_ids[i]);
-		glBindTexture(GL_TEXTURE_2D, texture_ids[i]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-		cout << "texture_index[" << i << "]: ";
-
-		if (pixels) {
-			// if-else statement created to not run into error when numChannels is different (RGB, RGBA)
-			if (numChannels == 4) {
-				glTexImage2D(
-					GL_TEXTURE_2D, // target
-					0, // level = 0 base, no mipmap
-					GL_RGBA, // how the data will be stored (Grayscale, RGB, RGBA)
-					width, //width of the image
-					height, //height of the image
-					0, // border
-					GL_RGBA, // format of original data
-					GL_UNSIGNED_BYTE, // type of data
-					pixels
-				);
-				std::cout << "Successfully loaded: Texture " << textures[i].c_str() << " with a width of " << width << ", a height of " << height << ", and uses 4 channels." << std::endl;
-			}
-			else if (numChannels == 3) {
-				glTexImage2D(
-					GL_TEXTURE_2D, // target
-					0, // level = 0 base, no mipmap
-					GL_RGB, // how the data will be stored (Grayscale, RGB, RGBA)
-					width, //width of the image
-					height, //height of the image
-					0, // border
-					GL_RGB, // format of original data
-					GL_UNSIGNED_BYTE, // type of data
-					pixels
-				);
-				std::cout << "Successfully loaded: Texture " << textures[i].c_str() << " with a width of " << width << ", a height of " << height << ", and uses 3 channels." << std::endl;
-			}
-			else {
-				std::cout << "Failed to load: Texture " << textures[i].c_str() << " with a width of " << width << ", a height of " << height << ", and uses " << numChannels << " channels. (error: channel)" << std::endl;
-			}
-
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else {
-			std::cout << "Failed to load: Texture: " << textures[i].c_str() << " with a width of " << width << ", a height of " << height << ", and uses " << numChannels << " channels. (error: pixels)" << std::endl;
-		}
-		stbi_image_free(pixels);
+	// one array for everything but the skybox, so a whole pass can be drawn without rebinding textures
+	createTextureArray();
 
-		texture_loc = glGetUniformLocation(g_simpleShader, "u_texture");
-		glUniform1i(texture_loc, i);
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, texture_ids[i]);
-	}
+	// everything is new the first time
+	reloadAssets();
 
-	// put meshes into a vector
+	// put meshes into the store
+	mesh_store.reserve(num_objects + 1);
 
-	// meshes[0] = thread
-	meshes.push_back(Mesh(
+	// entity 0 = thread
+	mesh_store.add(
 		"thread",
 		1,
 		1,
@@ -359,10 +932,10 @@ void load()
 			100.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[1] = earth
-	meshes.push_back(Mesh(
+	// entity 1 = earth
+	mesh_store.add(
 		"earth",
 		0,
 		2,
@@ -378,17 +951,17 @@ void load()
 			5.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[2] = moon
-	meshes.push_back(Mesh(
+	// entity 2 = moon, child of earth (earth's 0.5 scale applies, so world scale is 0.125)
+	mesh_store.add(
 		"moon",
 		0,
 		3,
 		TransformationValues(
-			glm::vec3(0.0f, 1.0f, 0.0f),
+			glm::vec3(2.5f, 0.0f, 0.0f),
 			glm::vec3(0.0f, moon_rot, 0.0f),
-			glm::vec3(0.125f, 0.125f, 0.125f)
+			glm::vec3(0.25f, 0.25f, 0.25f)
 		),
 		MaterialProperties(
 			glm::vec3(0.1f, 0.1f, 0.1f),
@@ -397,10 +970,10 @@ void load()
 			10.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[4] = stellar (stellated dodecahedron)
-	meshes.push_back(Mesh(
+	// entity 3 = stellar (stellated dodecahedron)
+	mesh_store.add(
 		"stellar",
 		2,
 		5,
@@ -416,10 +989,10 @@ void load()
 			20.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[5] = cloud
-	meshes.push_back(Mesh(
+	// entity 4 = cloud
+	mesh_store.add(
 		"cloud",
 		3,
 		6,
@@ -435,10 +1008,10 @@ void load()
 			20.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[6] = star
-	meshes.push_back(Mesh(
+	// entity 5 = star
+	mesh_store.add(
 		"star",
 		4,
 		7,
@@ -454,10 +1027,10 @@ void load()
 			1.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[7] = crescent
-	meshes.push_back(Mesh(
+	// entity 6 = crescent
+	mesh_store.add(
 		"crescent",
 		5,
 		8,
@@ -473,10 +1046,10 @@ void load()
 			10.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[8] = icosahedron
-	meshes.push_back(Mesh(
+	// entity 7 = icosahedron
+	mesh_store.add(
 		"icosahedron",
 		6,
 		9,
@@ -492,10 +1065,10 @@ void load()
 			10.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[9] = coin
-	meshes.push_back(Mesh(
+	// entity 8 = coin
+	mesh_store.add(
 		"coin",
 		7,
 		10,
@@ -511,10 +1084,10 @@ void load()
 			10.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[10] = tetrahedron
-	meshes.push_back(Mesh(
+	// entity 9 = tetrahedron
+	mesh_store.add(
 		"tetrahedron",
 		8,
 		11,
@@ -530,10 +1103,10 @@ void load()
 			10.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[3] = saturn
-	meshes.push_back(Mesh(
+	// entity 10 = saturn
+	mesh_store.add(
 		"saturn",
 		0,
 		4,
@@ -549,10 +1122,10 @@ void load()
 			20.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[11] = octahedron
-	meshes.push_back(Mesh(
+	// entity 11 = octahedron
+	mesh_store.add(
 		"octahedron",
 		9,
 		12,
@@ -568,10 +1141,10 @@ void load()
 			100.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[12] = heart
-	meshes.push_back(Mesh(
+	// entity 12 = heart
+	mesh_store.add(
 		"heart",
 		10,
 		13,
@@ -587,10 +1160,10 @@ void load()
 			20.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[13] = hex
-	meshes.push_back(Mesh(
+	// entity 13 = hex
+	mesh_store.add(
 		"hex",
 		11,
 		14,
@@ -606,10 +1179,10 @@ void load()
 			25.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[14] = amogus
-	meshes.push_back(Mesh(
+	// entity 14 = amogus
+	mesh_store.add(
 		"amogus",
 		12,
 		15,
@@ -625,17 +1198,17 @@ void load()
 			20.0f,
 			1.0f
 		)
-	));
+	);
 
-	// meshes[15] = rings
-	meshes.push_back(Mesh(
+	// entity 15 = rings, child of saturn, laid flat in saturn's equatorial plane
+	mesh_store.add(
 		"rings",
 		13,
 		16,
 		TransformationValues(
 			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(ring_rot, 0.0f, 0.0f),
-			glm::vec3(4.0f, 4.0f, 4.0f)
+			glm::vec3(glm::radians(ring_rot), 0.0f, 0.0f),
+			glm::vec3(5.0f, 5.0f, 5.0f)
 		),
 		MaterialProperties(
 			glm::vec3(0.1f, 0.1f, 0.1f),
@@ -644,41 +1217,93 @@ void load()
 			20.0f,
 			-1.0f					// use -1.0f for alpha maps (just like skybox)
 		)
-	));
+	);
+
+	// attachments, parents are always earlier in the store
+	mesh_store.setParent(2, 1);			// moon -> earth
+	mesh_store.setParent(15, 10);		// rings -> saturn
+
+	mesh_store.assignMaterialIds();
 
+	// multi-texturing
+	// hard-coded for earth only since it's the only one with multi-texturing
+	mesh_store.setDrawFlags(mesh_store.find("earth"), DRAW_FLAG_MULTITEXTURE);
+
+	glow_meshes.clear();
+	glow_meshes.push_back(mesh_store.find("star"));
+	glow_meshes.push_back(mesh_store.find("coin"));
+
+	// one scene node per mesh, in entity order so parents come first
+	scene_graph.clear();
+	for (GLuint i = 0; i < mesh_store.size(); i++) {
+		int parent_node = mesh_store.parent(i) == -1 ? SCENE_NODE_NONE : mesh_store.node(mesh_store.parent(i));
+		mesh_store.setNode(i, scene_graph.addNode(parent_node, mesh_store.rest(i)));
+	}
+
+	// animation tracks, spin rates in radians per second (the old per-frame steps at 60 fps)
+	animation.clear();
+
+	// procedural animation, attached meshes ride along with their parent
+	for (int i = 1; i < num_objects; i++) {
+		if (mesh_store.parent(i) == -1)
+			animation.addFallingPath(mesh_store.node(i), mesh_store.rest(i).translation, i, num_objects, fall_speed, loop_height);
+	}
+
+	animation.addSpin(mesh_store.node(15), 2, mesh_store.rest(15).rotation.z, 0.3f);		// ring_rot, spins in saturn's equatorial plane
+	GLuint coin = mesh_store.find("coin");
+	animation.addSpin(mesh_store.node(coin), 2, mesh_store.rest(coin).rotation.z, 0.6f);		// coin_rot
+	animation.addSpin(mesh_store.node(13), 1, mesh_store.rest(13).rotation.y, 1.5f);		// hex_rot
+	animation.addSpin(mesh_store.node(1), 1, mesh_store.rest(1).rotation.y, 0.6f);		// earth_rot, carries the moon around
+	animation.addSpin(mesh_store.node(2), 1, mesh_store.rest(2).rotation.y, -0.6f);		// moon_rot
+
+	// start from the current sim time
+	animation.step(sim_steps * (double)SIM_TIMESTEP);
+	animation.step(sim_steps * (double)SIM_TIMESTEP);
+
+	particles.clear();
+	initializeParticles(particles, 100); // Create 100 stars
 }
 
-void renderObject(GLuint shader, Mesh mesh, vec3 animation_translation);
+void renderObject(const DrawRange& entry, GLint offset_loc);
+void drawRun(size_t r, GLint offset_loc);
+bool useDepthPrepass(DepthPrepassMode mode);
+void bindDrawPage(GLuint page);
+void renderParticles(const std::vector<ParticleVertex>& particles, GLintptr offset, GLfloat point_scale, bool weighted);
+void finishOpaquePass(const FrameConstants& frame, const mat4& view_projection, bool deferred, GLintptr light_offset, GLsizei light_count, int transparency_divisor, bool weighted);
+mat4 latchFrameData(const FrameConstants& frame);
+void presentFrame();
+void updateCameraDirection();
+void advanceSimulation();
+void simulateStep();
+void addCullCandidate(GLuint mesh_index);
+void cullCandidates();
+void submitObject(GLuint mesh_index);
+void recordRenderQueue(RenderCommandBuffer& commands);
 
 // ^ to tell the program these functions exists below
 
 // ------------------------------------------------------------------------------------------
-// This function actually draws to screen and called non-stop, in a loop
+// This function records the next frame into a command buffer and called non-stop, in a loop
+// no GL calls in here, it runs on the main thread while the previous frame is being drawn
 // ------------------------------------------------------------------------------------------
-void draw()
+void buildFrame(RenderCommandBuffer& commands)
 {
-	glClearColor(g_backgroundColor.x, g_backgroundColor.y, g_backgroundColor.z, 1.0);
-
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
 	// camera settings
 	// 
 	// remove orthographic and orbital if there's time
 	// but both are also useful during testing and debugging...
 
 	float radius = 5.0f;
-	float camX = sin(glfwGetTime()) * radius;
-	float camZ = cos(glfwGetTime()) * radius;
+	double render_time = (sim_steps + sim_alpha) * (double)SIM_TIMESTEP;
+	float camX = sin(render_time) * radius;
+	float camZ = cos(render_time) * radius;
 
 	if (!orbital) {
 		view_matrix = glm::lookAt(
-			cameraPos,		//eye, where the camera is
-			cameraPos+cameraTarget,	//center, where the camera is looking at
+			cameraRenderPos,		//eye, where the camera is
+			cameraRenderPos+cameraTarget,	//center, where the camera is looking at
 			cameraUp		//up, roll of pitch-yaw-roll
 		);
-
-		view_loc = glGetUniformLocation(g_simpleShader, "u_view");
-		glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(view_matrix));
 	}
 	else {
 		view_matrix = glm::lookAt(
@@ -686,64 +1311,381 @@ void draw()
 			glm::vec3(0.0f, 4.0f, 0.0f), //0,0,0
 			glm::vec3(0.0f, 1.0f, 0.0f)  //0,1,0
 		);
-
-		view_loc = glGetUniformLocation(g_simpleShader, "u_view");
-		glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(view_matrix));
 	}
 
-	if (!orthographic) {
+	// the window can be resized, keep its aspect ratio
+	float aspect = g_ViewportHeight > 0 ? (float)g_ViewportWidth / g_ViewportHeight : 1.0f;
 
-		projection_loc = glGetUniformLocation(g_simpleShader, "u_projection");
+	if (!orthographic) {
 		projection_matrix = perspective(
 			fov, // field of view
-			1.0f, // aspect ratio 1:1
+			aspect, // aspect ratio of the window
 			0.1f, // near plane (distance from camera), very low number
 			50.0f // far plane (distance from camera), relatively big but not too big
 		);
 		// on top of other code so that all vao have same projection
-
-		glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projection_matrix));
 	}
 	else {
-		projection_loc = glGetUniformLocation(g_simpleShader, "u_projection");
 		projection_matrix = ortho(
-			-5.0f,
-			5.0f,
+			-5.0f * aspect,
+			5.0f * aspect,
 			-5.0f,
 			5.0f,
 			-10.0f, // near plane
 			10.0f // far plane
 		);
-		glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projection_matrix));
 	}
 
-	// skybox settings activated first
+	// culling and the light grid cover what a late-latched turn can bring into view; a turned
+	// orthographic box has no such margin, so it isn't latched
+	bool latching = late_latch && !orbital && !orthographic;
+	cull_projection_matrix = projection_matrix;
+	if (latching)
+		cull_projection_matrix = perspective(fov + LATE_LATCH_MARGIN < 170.0f ? fov + LATE_LATCH_MARGIN : 170.0f, aspect, 0.1f, 50.0f);
+
+	commands.frame.view_matrix = view_matrix;
+	commands.frame.projection_matrix = projection_matrix;
+	commands.frame.camera_pos = cameraRenderPos;
+	commands.frame.light = g_light;
+	commands.frame.light_intensity = light_intensity;
+	commands.frame.clear_color = g_backgroundColor;
+	commands.frame.viewport_width = g_ViewportWidth;
+	commands.frame.viewport_height = g_ViewportHeight;
+	commands.frame.dynamic_resolution = dynamic_scaling;
+	commands.frame.transparency_divisor = transparency_divisor;
+	weighted_blending = weighted_transparency && low_res_linked;
+	commands.frame.weighted_transparency = weighted_blending;
+	commands.frame.deferred = deferred_shading;
+	commands.frame.sky_cubemap = sky_cubemap;
+	commands.frame.depth_prepass = depth_prepass_mode;
+	commands.frame.overdraw_view = overdraw_view;
+	commands.frame.asset_generation = asset_registry.generation();
+	commands.frame.late_latch = latching;
+	commands.frame.input_time = input_time;
+	commands.frame.cluster_projection = cull_projection_matrix;
+
+	int numMeshes = num_objects + 1;    // falling objects plus the rings
+
+	// animated transforms were written by advanceSimulation(),
+	// only dirty nodes and their children get new world matrices
+	scene_graph.update(&jobs);
+
+	frame_arena.reset();
+	render_queue.clear();
+	cull_candidates.clear();
+	cull_batch.clear();
+
+	// thread, falling objects and rings (alpha map); visibility is left to frustum culling
+	for (int i = 0; i < numMeshes; i++)
+		addCullCandidate(i);
+
+	// only what survives the frustum test is queued (everything, with gpu culling)
+	cullCandidates();
+
+	// opaque front-to-back, then transparent back-to-front
+	render_queue.sort(frame_arena);
+	recordRenderQueue(commands);
+
+	// live particles, snapshotted for the render thread, each one also a point light
+	for (size_t i = 0; i < particles.size(); i++) {
+		const Particle& p = particles[i];
+		if (!p.active) continue;
 
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT);
-	glUseProgram(g_simpleShader);
+		ParticleVertex vertex;
+		vertex.position = p.position;
+		vertex.size = p.size;
+		vertex.color = p.color;
+		commands.particles.push_back(vertex);
+
+		PointLight light;
+		light.position = p.position;
+		light.radius = particle_light_radius;
+		light.color = vec3(p.color);
+		light.intensity = p.color.a;	// fades out with the star
+		commands.lights.push_back(light);
+	}
+
+	for (size_t i = 0; i < glow_meshes.size(); i++) {
+		PointLight light;
+		light.position = vec3(scene_graph.world(mesh_store.node(glow_meshes[i]))[3]);
+		light.radius = glow_light_radius;
+		light.color = glow_light_color;
+		light.intensity = 1.0f;
+		commands.lights.push_back(light);
+	}
+
+	// binned on the job system for the forward shader, the lights' indices have to match the upload
+	if (commands.lights.size() > (size_t)max_stream_lights)
+		commands.lights.resize(max_stream_lights);
+	commands.light_grid.build(commands.lights, view_matrix, cull_projection_matrix, &jobs);
+}
 
-	// skybox functions
-	// skybox is index 0 for models[], texture_ids[], g_vao[], g_NumTriangles[]
+// ------------------------------------------------------------------------------------------
+// This function actually draws to screen by replaying a recorded frame (render thread only)
+// false when the frame was dropped, nothing drawn
+// ------------------------------------------------------------------------------------------
+bool draw(const RenderCommandBuffer& commands)
+{
+	const FrameConstants& frame = commands.frame;
+
+	// recorded before a reload replaced assets, its mesh pool entries and ranges may be gone
+	if (frame.asset_generation != asset_registry.generation())
+		return false;
+
+	// minimized, nothing to draw into
+	if (frame.viewport_width <= 0 || frame.viewport_height <= 0)
+		return false;
+
+	// write everything the frame needs into the streams first (a non-persistent map has to be
+	// released before drawing from it), then draw with ranges into them
+
+	uniform_stream.beginFrame();
+	vertex_stream.beginFrame();
+	light_stream.beginFrame();
+	if (gpu_culling)
+		cull_stream.beginFrame();
+	else if (use_indirect)
+		indirect_stream.beginFrame();
+
+	// per-draw blocks, in pages of DRAW_SLOTS_PER_BLOCK; slot 0 is the skybox, draw i is slot i + 1
+	GLuint slot_count = (GLuint)commands.draws.size() + 1;
+	if (slot_count > (GLuint)max_stream_draws)
+		slot_count = max_stream_draws;
+
+	draw_page_offsets.clear();
+	DrawUniforms* page = NULL;
+	for (GLuint slot = 0; slot < slot_count; slot++) {
+		if (slot % DRAW_SLOTS_PER_BLOCK == 0) {
+			StreamAllocation page_block = uniform_stream.allocate(DRAW_SLOTS_PER_BLOCK * sizeof(DrawUniforms));
+			if (!page_block.data) {
+				slot_count = slot;
+				break;
+			}
+			page = (DrawUniforms*)page_block.data;
+			draw_page_offsets.push_back(page_block.offset);
+		}
 
-	model_loc = glGetUniformLocation(g_simpleShader, "u_model");
-	texture_loc = glGetUniformLocation(g_simpleShader, "u_texture");
-	alpha_loc = glGetUniformLocation(g_simpleShader, "u_alpha");
+		DrawUniforms draw_uniforms;
+		if (slot == 0) {
+			// skybox follows the camera, alpha = -1.0f signifies skybox settings
+			draw_uniforms.transform.model = translate(mat4(1.0f), frame.camera_pos);
+			draw_uniforms.transform.normal_matrix[0] = vec4(1.0f, 0.0f, 0.0f, 0.0f);
+			draw_uniforms.transform.normal_matrix[1] = vec4(0.0f, 1.0f, 0.0f, 0.0f);
+			draw_uniforms.transform.normal_matrix[2] = vec4(0.0f, 0.0f, 1.0f, 0.0f);
+			draw_uniforms.ambient = draw_uniforms.diffuse = draw_uniforms.specular = vec3(0.0f);
+			draw_uniforms.shininess = 1.0f;
+			draw_uniforms.alpha = -1.0f;
+			draw_uniforms.has_multitextures = 0;
+			draw_uniforms.layers[0] = -1;	// its own 2D texture
+			draw_uniforms.layers[1] = draw_uniforms.layers[2] = draw_uniforms.layers[3] = 0;
+		}
+		else {
+			const DrawCommand& command = commands.draws[slot - 1];
+			draw_uniforms.transform = command.transform;
+			draw_uniforms.ambient = command.material.ambient;
+			draw_uniforms.shininess = command.material.shininess;
+			draw_uniforms.diffuse = command.material.diffuse;
+			draw_uniforms.alpha = command.material.alpha;
+			draw_uniforms.specular = command.material.specular;
+			draw_uniforms.layers[0] = command.texture_index;
+
+			// multi-texturing
+			// hard-coded texture indices, the flag is only set for earth
+			draw_uniforms.has_multitextures = (command.flags & DRAW_FLAG_MULTITEXTURE) ? 1 : 0;
+			draw_uniforms.layers[1] = draw_uniforms.has_multitextures ? 18 : 0;
+			draw_uniforms.layers[2] = draw_uniforms.has_multitextures ? 19 : 0;
+			draw_uniforms.layers[3] = draw_uniforms.has_multitextures ? 20 : 0;
+		}
+		memcpy(&page[slot % DRAW_SLOTS_PER_BLOCK], &draw_uniforms, sizeof(DrawUniforms));
+	}
 
-	models[0] = translate(mat4(1.0f), cameraPos);
+	// every draw as index ranges: its whole mesh, or the meshlets that survived culling
+	draw_ranges.clear();
+	for (GLuint slot = 1; slot < slot_count; slot++) {
+		const DrawCommand& command = commands.draws[slot - 1];
+		DrawRange entry;
+		entry.slot = slot;
+		if (command.cluster_count == 0) {
+			entry.range = mesh_pool.range(command.pool_mesh);
+			draw_ranges.push_back(entry);
+		}
+		for (GLuint c = 0; c < command.cluster_count; c++) {
+			entry.range = commands.clusters[command.first_cluster + c];
+			draw_ranges.push_back(entry);
+		}
+	}
+	if (draw_ranges.size() > (size_t)max_stream_commands)
+		draw_ranges.resize(max_stream_commands);
+
+	// split the ranges where the pass or the page changes, each run is one indirect call
+	draw_runs.clear();
+	for (GLuint i = 0; i < (GLuint)draw_ranges.size(); i++) {
+		GLuint slot = draw_ranges[i].slot;
+		RenderPass pass = commands.draws[slot - 1].pass;
+		bool new_run = draw_runs.empty() || draw_runs.back().pass != pass || draw_runs.back().first_slot / DRAW_SLOTS_PER_BLOCK != slot / DRAW_SLOTS_PER_BLOCK;
+		if (new_run) {
+			DrawRun run;
+			run.pass = pass;
+			run.first_slot = slot;
+			run.first_range = i;
+			run.count = 0;
+			run.indirect_offset = 0;
+			run.compacted = false;
+			draw_runs.push_back(run);
+		}
+		draw_runs.back().count++;
+	}
 
-	// send values to shader
-	glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(models[0]));
-	glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(view_matrix));
-	glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projection_matrix));
+	// gpu culling: one CullInput per range instead, the culling pass writes the commands; range i's
+	// command goes to index i, except in compacted runs where survivors are packed from the run's start
+	GLuint cull_count = 0;
+	GLintptr cull_offset = 0;
+	if (gpu_culling && !draw_ranges.empty()) {
+		StreamAllocation cull_block = cull_stream.allocate(draw_ranges.size() * sizeof(CullInput));
+		if (cull_block.data) {
+			cull_count = (GLuint)draw_ranges.size();
+			cull_offset = cull_block.offset;
+		}
 
-	glUniform1i(texture_loc, 0);
-	glUniform1f(alpha_loc, -1.0f);			// when using g_simpleShader (not g_simpleShader_sky), alpha = -1.0f signifies skybox settings
+		CullInput* inputs = (CullInput*)cull_block.data;
+		for (size_t r = 0; r < draw_runs.size(); r++) {
+			DrawRun& run = draw_runs[r];
+			if (!inputs) {
+				run.count = 0;
+				continue;
+			}
+			run.indirect_offset = run.first_range * sizeof(DrawElementsIndirectCommand);
+
+			// sorted transparent draws must stay in back-to-front order, weighted ones go in any order
+			run.compacted = gpu_culler.compacts() && (run.pass == RENDER_PASS_OPAQUE || commands.frame.weighted_transparency);
+
+			for (GLuint k = 0; k < run.count; k++) {
+				GLuint i = run.first_range + k;
+				const DrawRange& entry = draw_ranges[i];
+
+				CullInput input;
+				input.sphere = commands.draws[entry.slot - 1].bounds;
+				input.count = entry.range.index_count;
+				input.first_index = entry.range.first_index;
+				input.base_vertex = entry.range.base_vertex;
+				input.base_instance = entry.slot % DRAW_SLOTS_PER_BLOCK;
+				input.out_index = run.compacted ? run.first_range : i;
+				input.run = (GLuint)r;
+				input.compact = run.compacted ? 1 : 0;
+				input.padding = 0;
+				inputs[i] = input;
+			}
+		}
+	}
+	else if (use_indirect) {
+		for (size_t r = 0; r < draw_runs.size(); r++) {
+			DrawRun& run = draw_runs[r];
+			StreamAllocation indirect_block = indirect_stream.allocate(run.count * sizeof(DrawElementsIndirectCommand));
+			if (!indirect_block.data) {
+				run.count = 0;
+				continue;
+			}
+			run.indirect_offset = indirect_block.offset;
+
+			DrawElementsIndirectCommand* indirect = (DrawElementsIndirectCommand*)indirect_block.data;
+			for (GLuint k = 0; k < run.count; k++) {
+				const DrawRange& entry = draw_ranges[run.first_range + k];
+
+				DrawElementsIndirectCommand command;
+				command.count = entry.range.index_count;
+				command.instance_count = 1;
+				command.first_index = entry.range.first_index;
+				command.base_vertex = entry.range.base_vertex;
+				command.base_instance = entry.slot % DRAW_SLOTS_PER_BLOCK;		// a_draw_id, the slot within the page
+				indirect[k] = command;
+			}
+		}
+	}
+
+	StreamAllocation particle_block = vertex_stream.allocate(commands.particles.size() * sizeof(ParticleVertex));
+	if (particle_block.data && !commands.particles.empty())
+		memcpy(particle_block.data, commands.particles.data(), commands.particles.size() * sizeof(ParticleVertex));
+
+	// lights with their cluster lists for shader.frag; the deferred path draws its volumes from the same lights
+	const std::vector<GLuint>& light_ranges = commands.light_grid.clusterRanges();
+	const std::vector<GLushort>& light_indices = commands.light_grid.lightIndices();
+	GLsizei light_count = (GLsizei)commands.lights.size();
+	StreamAllocation light_block = light_stream.allocate(light_count * sizeof(PointLight));
+	StreamAllocation cluster_block = light_stream.allocate(light_ranges.size() * sizeof(GLuint));
+	StreamAllocation index_block = light_stream.allocate(light_indices.size() * sizeof(GLushort));
+	if (light_block.data && cluster_block.data && index_block.data && light_count > 0 && !light_ranges.empty()) {
+		memcpy(light_block.data, commands.lights.data(), light_count * sizeof(PointLight));
+		memcpy(cluster_block.data, light_ranges.data(), light_ranges.size() * sizeof(GLuint));
+		if (!light_indices.empty())
+			memcpy(index_block.data, light_indices.data(), light_indices.size() * sizeof(GLushort));
+	}
+	else
+		light_count = 0;
+
+	uniform_stream.flush();
+	vertex_stream.flush();
+	light_stream.flush();
+	if (gpu_culling)
+		cull_stream.flush();
+	else if (use_indirect)
+		indirect_stream.flush();
+
+	// the scene target at this frame's size, timed from here to the upscale
+	dynamic_resolution.beginFrame(frame.viewport_width, frame.viewport_height, frame.dynamic_resolution);
+
+	// the view last of all, from the newest input, then everything is drawn with it
+	mat4 view_projection = frame.projection_matrix * latchFrameData(frame);
+
+	// frustum and last frame's depth decide what this frame draws
+	if (cull_count > 0)
+		gpu_culler.cull(cull_stream.buffer(), cull_offset, cull_count, (GLuint)draw_runs.size(), extractFrustumPlanes(view_projection));
+
+	glClearColor(frame.clear_color.x, frame.clear_color.y, frame.clear_color.z, 1.0);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// earlier frames' overdraw is in by now, it picks the depth pre-pass for this one
+	overdraw_meter.beginFrame();
+	bool prepass = !frame.overdraw_view && useDepthPrepass(frame.depth_prepass);
+
+	// textures stay bound for the whole frame
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture_sky);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+	for (int i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE8 + i);
+		glBindTexture(GL_TEXTURE_BUFFER, light_textures[i]);
+	}
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture_ids[0]);
-	gl_bindVAO(g_vao[0]);
-	glDrawElements(GL_TRIANGLES, 3 * g_NumTriangles[0], GL_UNSIGNED_INT, 0);
+
+	glUseProgram(g_simpleShader);
+
+	// this frame's lights and clusters, in texels from the start of the light stream
+	glUniform3i(light_base_loc, (GLint)(light_block.offset / sizeof(glm::vec4)), (GLint)(cluster_block.offset / (2 * sizeof(GLuint))), (GLint)(index_block.offset / sizeof(GLushort)));
+	glUniform1i(light_count_loc, light_count);
+	glUniform4fv(light_slicing_loc, 1, &commands.light_grid.depthSlicing()[0]);
+	glUniform1i(weighted_blend_loc, 0);
+	glBindVertexArray(mesh_pool.vao());
+
+	// sky sphere first, under everything; the cube map sky is drawn after the opaque pass instead,
+	// only where it shows (finishOpaquePass()); neither in the overdraw view, uncovered pixels stay black
+	if (!frame.overdraw_view && !(frame.sky_cubemap && skybox.ready())) {
+		// skybox settings activated first
+
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+
+		// skybox functions
+		// skybox is index 0 for textures[], the mesh pool and the draw slots
+
+		if (slot_count > 0) {
+			bindDrawPage(0);
+			glUniform1i(draw_offset_loc, 0);
+			mesh_pool.draw(0);
+		}
+	}
 
 
 
@@ -752,287 +1694,430 @@ void draw()
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK);
-	glEnable(GL_TEXTURE_2D);
-
-	// activate shader
-	// glUseProgram(g_simpleShader);
-	// no need to reactivate because merged shader programs already
-	
-	// funtion takes the following parameters:
-	// index,
-	// model_parent,
-	// TransformationValues (translate, rotate, scale),
-	// MaterialProperties (ambient, diffuse, specular, shininess, alpha)
-
-	// Animation parameters
-	float currentTime = glfwGetTime(); // Time elapsed
-	float speed = 1.5f;                // Speed of movement
-	float loopHeight = 15.0f;          // Total height of the motion path
-	int numObjects = 15;               // Total number of objects
-	float spacing = loopHeight / numObjects; // Equal spacing between objects
-	float totalLoopTime = loopHeight / speed;
-
-	// render thread
-	renderObject(g_simpleShader, meshes[0], vec3(0.0f));
-
-	// procedural animation
-	for (int i = 1; i < numObjects; i++) {
-		// start time offset
-		float startOffset = i * (loopHeight / speed / numObjects); // total time per object
-
-		// current relative position
-		float elapsedTime = fmod(currentTime - startOffset + totalLoopTime, totalLoopTime);
-
-		if (elapsedTime < 0) elapsedTime += totalLoopTime; // no negative time
-
-		// downward motion
-		float y_offset = loopHeight - fmod(elapsedTime * speed, loopHeight);
-
-		// horizontal zigzag motion
-		float x_offset = sin(elapsedTime * speed / loopHeight + i) * 2.0f;
-		float z_offset = cos(elapsedTime * speed / loopHeight + i) * 1.0f;
-
-		vec3 position = vec3(x_offset, y_offset, z_offset);
-		// combined motion
-
-		// Only render the object if it's within the visible path
-		if (y_offset >= -spacing) {
-			renderObject(g_simpleShader, meshes[i], position);
-		}
+
+	// opaque draws go to the G-buffer on the deferred path, with the geometry program's own u_draw_offset
+	bool deferred = frame.deferred && deferred_renderer.ready() && !frame.overdraw_view;
+	GLint offset_loc = draw_offset_loc;
+	if (deferred) {
+		deferred_renderer.beginGeometry(dynamic_resolution.renderWidth(), dynamic_resolution.renderHeight());
+		offset_loc = deferred_renderer.drawOffsetLocation();
 	}
 
-	// settings for alpha map usage
+	if (use_indirect) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpu_culling ? gpu_culler.commandBuffer() : indirect_stream.buffer());
+		if (gpu_culler.compacts())
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, gpu_culler.countBuffer());
+		glUniform1i(offset_loc, 0);
+	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_CULL_FACE);
+	// fragments that pass the depth test in draw order: the prepass's, or the opaque pass's without one
+	overdraw_meter.beginShaded();
+
+	if (frame.overdraw_view) {
+		// each fragment adds a little, brighter where more of them landed
+		glUseProgram(g_overdrawShader);
+		glBindVertexArray(mesh_pool.positionVao());
+		offset_loc = overdraw_offset_loc;
+		if (use_indirect)
+			glUniform1i(offset_loc, 0);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+	else if (prepass) {
+		// opaque depth first, positions only, then shade only what is left in front
+		glUseProgram(g_depthShader);
+		glBindVertexArray(mesh_pool.positionVao());
+		if (use_indirect)
+			glUniform1i(depth_offset_loc, 0);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for (size_t r = 0; r < draw_runs.size(); r++) {
+			if (draw_runs[r].pass == RENDER_PASS_OPAQUE)
+				drawRun(r, depth_offset_loc);
+		}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		overdraw_meter.endShaded();
 
-	// rings (alpha map)
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		glUseProgram(deferred ? deferred_renderer.geometryProgram() : g_simpleShader);
+		glBindVertexArray(mesh_pool.vao());
+	}
 
-	renderObject(g_simpleShader, meshes[15], vec3(0.0f));
-	
-	// object animations below
-	meshes[15].transform.rotation.x += 0.005;					// ring_rot
-	meshes[9].transform.rotation.z += 0.01;						// coin_rot
-	meshes[13].transform.rotation.y += 0.025;					// hex_rot
-	meshes[1].transform.rotation.y += 0.01;						// earth_rot
-	meshes[2].transform.rotation.y -= 0.01;						// moon_rot
+	// blended draws at a fraction of the scene's size, when there are any
+	bool particles_drawn = particle_block.data && !commands.particles.empty();
+	bool blended = particles_drawn;
+	for (size_t r = 0; r < draw_runs.size(); r++)
+		blended = blended || draw_runs[r].pass == RENDER_PASS_TRANSPARENT;
+	int divisor = frame.transparency_divisor > 1 && low_res_transparency.ready() && blended ? frame.transparency_divisor : 1;
+	bool weighted = frame.weighted_transparency && blended;
+
+	bool opaque_finished = false;
+	for (size_t r = 0; r < draw_runs.size(); r++) {
+		const DrawRun& run = draw_runs[r];
+
+		// switch blending/culling once, where the transparent pass begins
+		if (run.pass == RENDER_PASS_TRANSPARENT && (r == 0 || draw_runs[r - 1].pass != RENDER_PASS_TRANSPARENT)) {
+			finishOpaquePass(frame, view_projection, deferred, light_block.offset, light_count, divisor, weighted);
+			opaque_finished = true;
+			offset_loc = draw_offset_loc;
+
+			// premultiplied color or weighted sums, whichever the target holds
+			LowResTransparency::setBlending(weighted);
+			glDisable(GL_CULL_FACE);
+		}
 
-	
+		drawRun(r, offset_loc);
+	}
 
-	// fps camera updates with code below
+	if (!opaque_finished)
+		finishOpaquePass(frame, view_projection, deferred, light_block.offset, light_count, divisor, weighted);
 
-	cameraTarget = glm::normalize(
-		vec3(
-			cos(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch)),
-			sin(glm::radians(camera_pitch)),
-			sin(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch))
-		)
-	);
+	if (use_indirect)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	if (gpu_culler.compacts())
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	glBindVertexArray(0);
 
-	cameraRight = glm::normalize(glm::cross(cameraTarget, cameraUp));
+	// stars last, blended over everything
+	if (particles_drawn)
+		renderParticles(commands.particles, particle_block.offset, dynamic_resolution.scale() / divisor, weighted);
 
-	cameraTarget = glm::normalize(
-		vec3(
-			cos(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch)),
-			sin(glm::radians(camera_pitch)),
-			sin(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch))
-		)
-	);
+	// everything blended goes over the scene at once
+	if (divisor > 1 || weighted)
+		low_res_transparency.composite(dynamic_resolution.colorTexture(), dynamic_resolution.framebuffer());
 
-	cameraRight = glm::normalize(glm::cross(cameraTarget, cameraUp));
+	// back to opaque state for the next frame's skybox
+	glDisable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
 
+	// into the window
+	dynamic_resolution.endFrame();
+
+	// fence this frame's stream regions
+	uniform_stream.endFrame();
+	frame_stream.endFrame();
+	vertex_stream.endFrame();
+	light_stream.endFrame();
+	if (gpu_culling)
+		cull_stream.endFrame();
+	else if (use_indirect)
+		indirect_stream.endFrame();
+
+	return true;
 }
 
 // ------------------------------------------------------------------------------------------
-// This function is called to render an object to screen
+// This function writes the FrameData block, its view turned to the newest published camera
+// direction when the frame allows it, and binds it; returns that view (render thread only)
 // ------------------------------------------------------------------------------------------
-void renderObject(GLuint shader, Mesh mesh, vec3 animation_translation)
+mat4 latchFrameData(const FrameConstants& frame)
 {
-	// lay out variables from struct for clarity
-	GLuint object_index = mesh.object_index;
-	GLuint texture_index = mesh.texture_index;
-	TransformationValues transform = mesh.transform;
-	MaterialProperties material = mesh.material;
-	bool has_multitextures = false;
-
-	// activate shader
-	glUseProgram(shader);
-
-	// get uniform locations
-	texture_loc = glGetUniformLocation(shader, "u_texture");
-	light_loc = glGetUniformLocation(shader, "u_light");
-	light_intensity_loc = glGetUniformLocation(shader, "u_light_intensity");
-	cam_pos_loc = glGetUniformLocation(shader, "u_cam_pos");
-	ambient_loc = glGetUniformLocation(shader, "u_ambient");
-	diffuse_loc = glGetUniformLocation(shader, "u_diffuse");
-	specular_loc = glGetUniformLocation(shader, "u_specular");
-	shininess_loc = glGetUniformLocation(shader, "u_shininess");
-	alpha_loc = glGetUniformLocation(shader, "u_alpha");
-	model_loc = glGetUniformLocation(shader, "u_model");
-	normal_loc = glGetUniformLocation(shader, "a_normal");
-
-	// render textures
-	glUniform1i(texture_loc, texture_index);
-	glActiveTexture(GL_TEXTURE0 + texture_index);
-	glBindTexture(GL_TEXTURE_2D, texture_ids[texture_index]);
-
-	// multi-texturing
-	// hard-coded for earth only since it's the only one with multi-texturing
-	// ideally should be included in the struct but it'll be empty for the rest so this'll do
+	mat4 view = frame.view_matrix;
+	presented_input_time = frame.input_time;
+
+	// same position as recorded, it moves with the simulation steps the rest of the frame is from
+	CameraSample sample;
+	if (frame.late_latch && camera_latch.latest(sample) && sample.input_time > frame.input_time) {
+		view = glm::lookAt(frame.camera_pos, frame.camera_pos + sample.forward, cameraUp);
+		presented_input_time = sample.input_time;
+	}
 
-	if (mesh.mesh_name == "earth") {
-		GLuint texture_normal_index = 18;
-		GLuint texture_spec_index = 19;
-		GLuint texture_night_index = 20;
-		has_multitextures = true;
+	// its own stream, so nothing else has to be written this late
+	frame_stream.beginFrame();
+	FrameUniforms frame_uniforms;
+	frame_uniforms.view_matrix = view;
+	frame_uniforms.projection_matrix = frame.projection_matrix;
+	frame_uniforms.light = frame.light;
+	frame_uniforms.light_intensity = frame.light_intensity;
+	frame_uniforms.camera_pos = frame.camera_pos;
+	frame_uniforms.padding = 0.0f;
+	frame_uniforms.cluster_view = frame.view_matrix;
+	frame_uniforms.cluster_projection = frame.cluster_projection;
+	StreamAllocation frame_block = frame_stream.allocate(sizeof(FrameUniforms));
+	if (frame_block.data)
+		memcpy(frame_block.data, &frame_uniforms, sizeof(FrameUniforms));
+	frame_stream.flush();
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frame_stream.buffer(), frame_block.offset, sizeof(FrameUniforms));
+	return view;
+}
 
-		has_multi_loc = glGetUniformLocation(g_simpleShader, "u_has_multitextures");
-		glUniform1i(has_multi_loc, has_multitextures);
+// ------------------------------------------------------------------------------------------
+// This function runs right after each swap (render thread): input to swap of the frame shown
+// ------------------------------------------------------------------------------------------
+void presentFrame()
+{
+	camera_latch.presented(presented_input_time, glfwGetTime());
+}
 
-		texture_normal_loc = glGetUniformLocation(shader, "u_texture_normal");
-		glUniform1i(texture_normal_loc, texture_normal_index);
-		glActiveTexture(GL_TEXTURE0 + texture_normal_index);
-		glBindTexture(GL_TEXTURE_2D, texture_ids[texture_normal_index]);
+// ------------------------------------------------------------------------------------------
+// This function ends the opaque pass: lights the G-buffer on the deferred path, fills the sky in
+// behind it, builds the depth pyramid for next frame's occlusion test, then puts back the scene state,
+// in the low-res transparency target when transparency_divisor > 1 or the blending is weighted
+// ------------------------------------------------------------------------------------------
+void finishOpaquePass(const FrameConstants& frame, const mat4& view_projection, bool deferred, GLintptr light_offset, GLsizei light_count, int transparency_divisor, bool weighted)
+{
+	// back from the prepass's GL_EQUAL or the overdraw view's blending
+	overdraw_meter.endShaded();
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
 
-		texture_spec_loc = glGetUniformLocation(shader, "u_texture_spec");
-		glUniform1i(texture_spec_loc, texture_spec_index);
-		glActiveTexture(GL_TEXTURE0 + texture_spec_index);
-		glBindTexture(GL_TEXTURE_2D, texture_ids[texture_spec_index]);
+	if (deferred)
+		deferred_renderer.resolve(dynamic_resolution.framebuffer(), view_projection, light_stream.buffer(), light_offset, light_count);
+	overdraw_meter.countCovered();
+	if (frame.sky_cubemap && skybox.ready() && !frame.overdraw_view)
+		skybox.draw(view_projection);
+	if (gpu_culling)
+		gpu_culler.buildDepthPyramid(dynamic_resolution.framebuffer(), dynamic_resolution.renderWidth(), dynamic_resolution.renderHeight(), view_projection);
+
+	if (transparency_divisor > 1 || weighted)
+		low_res_transparency.begin(dynamic_resolution.depthTexture(), dynamic_resolution.renderWidth(), dynamic_resolution.renderHeight(), transparency_divisor, weighted);
+	else
+		glViewport(0, 0, dynamic_resolution.renderWidth(), dynamic_resolution.renderHeight());
+	glUseProgram(g_simpleShader);
+	glUniform1i(weighted_blend_loc, weighted ? 1 : 0);
+	glBindVertexArray(mesh_pool.vao());
+}
 
-		texture_night_loc = glGetUniformLocation(shader, "u_texture_night");
-		glUniform1i(texture_night_loc, texture_night_index);
-		glActiveTexture(GL_TEXTURE0 + texture_night_index);
-		glBindTexture(GL_TEXTURE_2D, texture_ids[texture_night_index]);
+// ------------------------------------------------------------------------------------------
+// This function draws draw_runs[r] with the bound program and vao, whose u_draw_offset is offset_loc
+// ------------------------------------------------------------------------------------------
+void drawRun(size_t r, GLint offset_loc)
+{
+	const DrawRun& run = draw_runs[r];
+	bindDrawPage(run.first_slot / DRAW_SLOTS_PER_BLOCK);
+
+	if (use_indirect) {
+		// the whole run, any number of meshes, in one call
+		if (run.count > 0 && run.compacted)
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, mesh_pool.indexType(), (void*)run.indirect_offset, r * sizeof(GLuint), run.count, 0);
+		else if (run.count > 0)
+			glMultiDrawElementsIndirect(GL_TRIANGLES, mesh_pool.indexType(), (void*)run.indirect_offset, run.count, 0);
 	}
 	else {
-		has_multitextures = false;
-		has_multi_loc = glGetUniformLocation(g_simpleShader, "u_has_multitextures");
-		glUniform1i(has_multi_loc, has_multitextures);
-		
-		glActiveTexture(GL_TEXTURE0 + 18);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		glActiveTexture(GL_TEXTURE0 + 19);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		glActiveTexture(GL_TEXTURE0 + 20);
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
-
-	// object transformations
-	// (formerly models[object_index])
-	models[object_index] = translate(mat4(1.0f), vec3(
-		transform.translation.x + animation_translation.x,
-		transform.translation.y + animation_translation.y,
-		transform.translation.z + animation_translation.z)) *
-		rotate(mat4(1.0f), transform.rotation.x, vec3(1.0f, 0.0f, 0.0f)) *
-		rotate(mat4(1.0f), transform.rotation.y, vec3(0.0f, 1.0f, 0.0f)) *
-		rotate(mat4(1.0f), transform.rotation.z, vec3(0.0f, 0.0f, 1.0f)) *
-		scale(mat4(1.0f), vec3(transform.scale.x, transform.scale.y, transform.scale.z));
-
-	mesh.model_matrix = models[object_index];
-
-	// send transformations and normals to shader
-	glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(mesh.model_matrix));	//(models[object_index]));
-	glm::mat4 normal_matrix = glm::transpose(glm::inverse(mesh.model_matrix));		//(models[object_index]));
-	glUniformMatrix4fv(normal_loc, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-
-	// send material properties to shader
-	glUniform3f(light_loc, g_light.x, g_light.y, g_light.z);
-	glUniform1f(light_intensity_loc, light_intensity);
-	glUniform3f(cam_pos_loc, cameraPos.x, cameraPos.y, cameraPos.z);
-	glUniform3f(ambient_loc, material.ambient.x, material.ambient.y, material.ambient.z);
-	glUniform3f(diffuse_loc, material.diffuse.x, material.diffuse.y, material.diffuse.z);
-	glUniform3f(specular_loc, material.specular.x, material.specular.y, material.specular.z);
-	glUniform1f(shininess_loc, material.shininess);
-	glUniform1f(alpha_loc, material.alpha);
-
-	// bind vao
-	gl_bindVAO(g_vao[object_index]);
-
-	// draw to screen!
-	glDrawElements(GL_TRIANGLES, 3 * g_NumTriangles[object_index], GL_UNSIGNED_INT, 0);
+		for (GLuint k = 0; k < run.count; k++)
+			renderObject(draw_ranges[run.first_range + k], offset_loc);
+	}
+}
 
+// ------------------------------------------------------------------------------------------
+// This function decides whether this frame's opaque pass starts with a depth pre-pass: the
+// prepass pays for a second transform of every opaque vertex, worth it once enough fragments
+// would be shaded only to be drawn over (render thread only)
+// ------------------------------------------------------------------------------------------
+bool useDepthPrepass(DepthPrepassMode mode)
+{
+	if (!g_depthShader) return false;
+	if (mode != DEPTH_PREPASS_AUTO) return mode == DEPTH_PREPASS_ON;
+
+	// two thresholds, so overdraw hovering around one doesn't flip it every few frames
+	float overdraw = overdraw_meter.overdraw();
+	bool active = depth_prepass_active ? overdraw > prepass_overdraw_off : overdraw > prepass_overdraw_on;
+	if (active != depth_prepass_active)
+		LOG_INFO("depth pre-pass: {}, overdraw {}", (active ? "on" : "off"), overdraw);
+	depth_prepass_active = active;
+	return active;
 }
 
 // ------------------------------------------------------------------------------------------
-// This function is called to initialize the particle effect
+// This function points the DrawData block at one page of this frame's draw slots
 // ------------------------------------------------------------------------------------------
-void initializeParticles(std::vector<Particle>& particles, int numParticles) {
-	for (int i = 0; i < numParticles; ++i) {
-		Particle p;
-		p.position = glm::vec3(
-			randomFloat(-5.0f, 5.0f), // X range
-			randomFloat(5.0f, 10.0f), // Y range (above the screen)
-			randomFloat(-5.0f, 5.0f)  // Z range
-		);
-		p.velocity = glm::vec3(0.0f, randomFloat(-1.0f, -2.0f), 0.0f); // Downward
-		p.lifetime = randomFloat(2.0f, 5.0f); // Random lifetime
-		p.size = randomFloat(0.1f, 0.3f);     // Random size
-		p.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // White color
-		p.active = true;
-		particles.push_back(p);
-	}
+void bindDrawPage(GLuint page)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, uniform_stream.buffer(), draw_page_offsets[page], DRAW_SLOTS_PER_BLOCK * sizeof(DrawUniforms));
 }
 
-void updateParticles(std::vector<Particle>& particles, float deltaTime, float floorY) {
-	for (auto& p : particles) {
-		if (!p.active) continue;
+// ------------------------------------------------------------------------------------------
+// This function advances the simulation by whole fixed steps for the real time that passed,
+// then blends the last two steps so drawing is smooth whatever the frame rate
+// ------------------------------------------------------------------------------------------
+void advanceSimulation()
+{
+	currentTime = glfwGetTime();
+	deltaTime = currentTime - lastTime;
+	lastTime = currentTime;
 
-		// Update position
-		p.position += p.velocity * deltaTime;
+	// after a stall (window drag, breakpoint) don't try to catch up on all of it
+	if (deltaTime > 0.25f) deltaTime = 0.25f;
 
-		// Decrease lifetime
-		p.lifetime -= deltaTime;
+	sim_accumulator += deltaTime;
+	while (sim_accumulator >= SIM_TIMESTEP) {
+		simulateStep();
+		sim_accumulator -= SIM_TIMESTEP;
+	}
 
-		// Fade out based on lifetime
-		p.color.a = p.lifetime > 0 ? p.lifetime / 5.0f : 0.0f;
+	sim_alpha = sim_accumulator / SIM_TIMESTEP;
+	animation.apply(scene_graph, sim_alpha);
+	cameraRenderPos = mix(cameraPrevPos, cameraPos, sim_alpha);
+}
 
-		// Check if it reached the floor
-		if (p.position.y <= floorY || p.lifetime <= 0.0f) {
-			p.active = false; // Deactivate particle
-		}
+// ------------------------------------------------------------------------------------------
+// This function is one fixed simulation step: held movement keys, then all animation tracks
+// ------------------------------------------------------------------------------------------
+void simulateStep()
+{
+	sim_steps++;
+	cameraPrevPos = cameraPos;
+
+	if (!orbital) {
+		float step = cameraSpeed * SIM_TIMESTEP;
+		if (glfwGetKey(g_window, GLFW_KEY_W) == GLFW_PRESS) cameraPos += cameraTarget * step;
+		if (glfwGetKey(g_window, GLFW_KEY_S) == GLFW_PRESS) cameraPos -= cameraTarget * step;
+		if (glfwGetKey(g_window, GLFW_KEY_D) == GLFW_PRESS) cameraPos += cameraRight * step;
+		if (glfwGetKey(g_window, GLFW_KEY_A) == GLFW_PRESS) cameraPos -= cameraRight * step;
+		if (glfwGetKey(g_window, GLFW_KEY_Q) == GLFW_PRESS) cameraPos += cameraUp * step;
+		if (glfwGetKey(g_window, GLFW_KEY_Z) == GLFW_PRESS) cameraPos -= cameraUp * step;
 	}
+
+	animation.step(sim_steps * (double)SIM_TIMESTEP, &jobs);
+
+	updateParticles(particles, SIM_TIMESTEP, particle_floor, &jobs);
+	respawnParticles(particles, particle_top);
 }
 
-void renderParticles(const std::vector<Particle>& particles) {
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// ------------------------------------------------------------------------------------------
+// This function adds an object's world-space bounding sphere to this frame's culling batch
+// ------------------------------------------------------------------------------------------
+void addCullCandidate(GLuint mesh_index)
+{
+	RenderItem item;
+	item.mesh_index = mesh_index;
+	cull_candidates.push_back(item);
+	cull_batch.add(transformBoundingSphere(object_bounds[mesh_store.objectIndex(mesh_index)].sphere, scene_graph.world(mesh_store.node(mesh_index))));
+}
 
-	for (const auto& p : particles) {
-		if (!p.active) continue;
+// ------------------------------------------------------------------------------------------
+// This function tests all candidates against the view frustum and submits the visible ones
+// ------------------------------------------------------------------------------------------
+void cullCandidates()
+{
+	// the gpu tests every draw against the frustum and last frame's depth instead
+	if (gpu_culling) {
+		for (size_t i = 0; i < cull_candidates.size(); i++)
+			submitObject(cull_candidates[i].mesh_index);
+		return;
+	}
 
-		// Set color and size
-		glPointSize(p.size * 10.0f); // Scale size for visibility
-		glColor4f(p.color.r, p.color.g, p.color.b, p.color.a);
+	Frustum frustum = extractFrustumPlanes(cull_projection_matrix * view_matrix);
+	unsigned char* cull_visible = frame_arena.allocateArray<unsigned char>(cull_batch.size());
+	cull_batch.cull(frustum, cull_visible, &jobs);
 
-		// Render particle
-		glBegin(GL_POINTS);
-		glVertex3f(p.position.x, p.position.y, p.position.z);
-		glEnd();
+	for (size_t i = 0; i < cull_candidates.size(); i++) {
+		if (cull_visible[i])
+			submitObject(cull_candidates[i].mesh_index);
 	}
+}
 
-	glDisable(GL_BLEND);
+// ------------------------------------------------------------------------------------------
+// This function queues an object for drawing, keyed by pass, state and view depth
+// ------------------------------------------------------------------------------------------
+void submitObject(GLuint mesh_index)
+{
+	// depth of the object's origin along the view direction
+	vec3 position = vec3(scene_graph.world(mesh_store.node(mesh_index))[3]);
+	float view_depth = -(view_matrix * vec4(position, 1.0f)).z;
+
+	RenderItem item;
+	item.mesh_index = mesh_index;
+	render_queue.submit(makeSortKey(mesh_store.pass(mesh_index), g_simpleShader, mesh_store.materialId(mesh_index), mesh_store.textureIndex(mesh_index), view_depth, !weighted_blending), item);
 }
 
-void respawnParticles(std::vector<Particle>& particles, float topY) {
-	for (auto& p : particles) {
-		if (!p.active) {
-			p.position = glm::vec3(
-				randomFloat(-5.0f, 5.0f), // X range
-				randomFloat(topY, topY + 5.0f), // Reset Y (above the screen)
-				randomFloat(-5.0f, 5.0f)       // Z range
-			);
-			p.velocity = glm::vec3(0.0f, randomFloat(-1.0f, -2.0f), 0.0f);
-			p.lifetime = randomFloat(2.0f, 5.0f);
-			p.size = randomFloat(0.1f, 0.3f);
-			p.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-			p.active = true;
+// ------------------------------------------------------------------------------------------
+// This function turns the sorted render queue into draw commands for the render thread
+// ------------------------------------------------------------------------------------------
+void recordRenderQueue(RenderCommandBuffer& commands)
+{
+	Frustum frustum = extractFrustumPlanes(cull_projection_matrix * view_matrix);
+
+	for (size_t i = 0; i < render_queue.size(); i++) {
+		GLuint id = render_queue.itemAt(i).mesh_index;
+		GLuint object_index = mesh_store.objectIndex(id);
+		int node = mesh_store.node(id);
+
+		DrawCommand command;
+		command.pass = sortKeyPass(render_queue.keyAt(i));
+		command.object_index = object_index;
+		command.texture_index = mesh_store.textureIndex(id);
+		command.flags = mesh_store.drawFlags(id);
+		command.material = mesh_store.material(id);
+
+		// world transforms already resolved through the parent chain by scene_graph.update()
+		command.transform = scene_graph.instance(node);
+
+		BoundingSphere sphere = transformBoundingSphere(object_bounds[object_index].sphere, scene_graph.world(node));
+		command.bounds = vec4(sphere.center, sphere.radius);
+
+		// fewer triangles the fewer pixels the object covers
+		const MeshLodChain& lods = object_lods[object_index];
+		int lod = selectLod(projectedDiameter(sphere, view_matrix, projection_matrix, commands.frame.viewport_height), lods.count, mesh_store.lod(id));
+		mesh_store.setLod(id, lod);
+		command.pool_mesh = lods.pool_mesh[lod];
+
+		// big meshes at full detail send only the meshlets in view and facing the camera
+		command.first_cluster = (uint32_t)commands.clusters.size();
+		command.cluster_count = 0;
+		MeshletSet& meshlets = object_meshlets[object_index];
+		if (lod == 0 && !meshlets.empty()) {
+			command.cluster_count = (uint32_t)meshlets.cull(scene_graph.world(node), frustum, commands.frame.camera_pos, mesh_pool.range(command.pool_mesh), commands.clusters);
+			if (command.cluster_count == 0)
+				continue;
 		}
+
+		commands.draws.push_back(command);
 	}
 }
 
+// ------------------------------------------------------------------------------------------
+// This function is called to render an object to screen, one call per object (non-indirect path)
+// ------------------------------------------------------------------------------------------
+void renderObject(const DrawRange& entry, GLint offset_loc)
+{
+	// transform, material and texture layers were streamed by draw(), only pick the slot
+	// (the pool's vao, the program whose u_draw_offset is offset_loc and the right DrawData page are already bound)
+	glUniform1i(offset_loc, entry.slot % DRAW_SLOTS_PER_BLOCK);
+
+	// draw to screen!
+	mesh_pool.draw(entry.range);
+}
+
+// ------------------------------------------------------------------------------------------
+// This function draws the particles streamed by draw() as point sprites
+// ------------------------------------------------------------------------------------------
+void renderParticles(const std::vector<ParticleVertex>& particles, GLintptr offset, GLfloat point_scale, bool weighted) {
+	LowResTransparency::setBlending(weighted);
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glDepthMask(GL_FALSE);
+
+	glUseProgram(g_particleShader);
+
+	// sizes are in pixels of the target drawn into, smaller than the window's when it is scaled down
+	glUniform1f(point_scale_loc, point_scale);
+	glUniform1i(particle_weighted_loc, weighted ? 1 : 0);
+
+	// the particles' place in the stream moves every frame, so the pointers are set every frame
+	glBindVertexArray(g_particle_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_stream.buffer());
+
+	GLint position_loc = glGetAttribLocation(g_particleShader, "a_position");
+	GLint size_loc = glGetAttribLocation(g_particleShader, "a_size");
+	GLint color_loc = glGetAttribLocation(g_particleShader, "a_color");
+	glEnableVertexAttribArray(position_loc);
+	glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)(offset + offsetof(ParticleVertex, position)));
+	glEnableVertexAttribArray(size_loc);
+	glVertexAttribPointer(size_loc, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)(offset + offsetof(ParticleVertex, size)));
+	glEnableVertexAttribArray(color_loc);
+	glVertexAttribPointer(color_loc, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)(offset + offsetof(ParticleVertex, color)));
+
+	glDrawArrays(GL_POINTS, 0, (GLsizei)particles.size());
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_PROGRAM_POINT_SIZE);
+	glDisable(GL_BLEND);
+}
 
 // ------------------------------------------------------------------------------------------
 // This function is called every time you press a screen
@@ -1041,56 +2126,52 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	//quit
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, 1);
-	//reload
+	//reload, only what changed on disk
 	if (key == GLFW_KEY_R && action == GLFW_PRESS)
-		load();
+		frame_pipeline.runOnRenderThread(reloadAssets);	// needs the GL context
 	if (key == GLFW_KEY_W && action == GLFW_PRESS && !orbital) {
-		cameraPos += cameraTarget * cameraSpeed;
-		cout << "pressed w button, moving camera forward" << endl;
+		LOG_DEBUG("pressed w button, moving camera forward");	// movement happens in simulateStep() while held
 	}
 	if (key == GLFW_KEY_S && action == GLFW_PRESS && !orbital) {
-		cameraPos -= cameraTarget * cameraSpeed;
-		cout << "pressed s button, moving camera backward" << endl;
+		LOG_DEBUG("pressed s button, moving camera backward");	// movement happens in simulateStep() while held
 	}
 	if (key == GLFW_KEY_D && action == GLFW_PRESS && !orbital) {
-		cameraPos += cameraRight * cameraSpeed;
-		cout << "pressed d button, moving camera to the right" << endl;
+		LOG_DEBUG("pressed d button, moving camera to the right");	// movement happens in simulateStep() while held
 	}
 	if (key == GLFW_KEY_A && action == GLFW_PRESS && !orbital) {
-		cameraPos -= cameraRight * cameraSpeed;
-		cout << "pressed a button, moving camera to the left" << endl;
+		LOG_DEBUG("pressed a button, moving camera to the left");	// movement happens in simulateStep() while held
 	}
 	if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS) {
 		g_light.x += 1.0f;
-		cout << "pressed right button, g_light.x = " << g_light.x << endl;
+		LOG_DEBUG("pressed right button, g_light.x = {}", g_light.x);
 	}
 	if (key == GLFW_KEY_LEFT && action == GLFW_PRESS) {
 		g_light.x -= 1.0f;
-		cout << "pressed left button, g_light.x = " << g_light.x << endl;
+		LOG_DEBUG("pressed left button, g_light.x = {}", g_light.x);
 	}
 	if (key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
 		g_light.z += 1.0f;
-		cout << "pressed down button, g_light.z = " << g_light.z << endl;
+		LOG_DEBUG("pressed down button, g_light.z = {}", g_light.z);
 	}
 	if (key == GLFW_KEY_UP && action == GLFW_PRESS) {
 		g_light.z -= 1.0f;
-		cout << "pressed up button, g_light.z = " << g_light.z << endl;
+		LOG_DEBUG("pressed up button, g_light.z = {}", g_light.z);
 	}
 	if (key == GLFW_KEY_RIGHT_BRACKET && action == GLFW_PRESS) {
 		g_light.y += 1.0f;
-		cout << "pressed right bracket button, g_light.y = " << g_light.y << endl;
+		LOG_DEBUG("pressed right bracket button, g_light.y = {}", g_light.y);
 	}
 	if (key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS) {
 		g_light.y -= 1.0f;
-		cout << "pressed left bracket button, g_light.y = " << g_light.y << endl;
+		LOG_DEBUG("pressed left bracket button, g_light.y = {}", g_light.y);
 	}
 	if (key == GLFW_KEY_N && action == GLFW_PRESS) {
 		light_intensity -= 1.0f;
-		cout << "pressed n button, light intensity decreases" << endl;
+		LOG_DEBUG("pressed n button, light intensity decreases");
 	}
 	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
 		light_intensity += 1.0f;
-		cout << "pressed m button, light intensity increases" << endl;
+		LOG_DEBUG("pressed m button, light intensity increases");
 	}
 	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
 		//toggle persp / ortho
@@ -1100,18 +2181,61 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		else {
 			orthographic = true;
 		}
-		cout << "pressed p button, orthographic = " << orthographic << endl;
+		LOG_DEBUG("pressed p button, orthographic = {}", orthographic);
 	}
 	if (key == GLFW_KEY_Q && action == GLFW_PRESS && !orbital) {
-		cameraPos += cameraUp * cameraSpeed;
-		cout << "pressed q button, moving camera upward" << endl;
+		LOG_DEBUG("pressed q button, moving camera upward");	// movement happens in simulateStep() while held
 	}
 	if (key == GLFW_KEY_Z && action == GLFW_PRESS && !orbital) {
-		cameraPos -= cameraUp * cameraSpeed;
-		cout << "pressed z button, moving camera downward" << endl;
+		LOG_DEBUG("pressed z button, moving camera downward");	// movement happens in simulateStep() while held
 	}
 	if (key == GLFW_KEY_T && action == GLFW_PRESS) {
-		cout << "pressed t button, glfwGetTime() = " << glfwGetTime() << endl;
+		LOG_DEBUG("pressed t button, glfwGetTime() = {}, sim time = {}", glfwGetTime(), sim_steps * (double)SIM_TIMESTEP);
+	}
+	if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+		deferred_shading = !deferred_shading;
+		LOG_DEBUG("pressed g button, deferred shading = {}", deferred_shading);
+	}
+	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		sky_cubemap = !sky_cubemap;
+		LOG_DEBUG("pressed b button, cube map skybox = {}", sky_cubemap);
+	}
+	if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+		static const char* const mode_names[3] = { "auto", "on", "off" };
+		depth_prepass_mode = (DepthPrepassMode)((depth_prepass_mode + 1) % 3);
+		LOG_DEBUG("pressed e button, depth pre-pass = {}", mode_names[depth_prepass_mode]);
+	}
+	if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+		overdraw_view = !overdraw_view;
+		LOG_DEBUG("pressed x button, overdraw view = {}", overdraw_view);
+		frame_pipeline.runOnRenderThread([] { LOG_INFO("overdraw: {} fragments per covered pixel", overdraw_meter.overdraw()); });
+	}
+	if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+		dynamic_scaling = !dynamic_scaling;
+		LOG_DEBUG("pressed h button, dynamic resolution = {}", dynamic_scaling);
+		frame_pipeline.runOnRenderThread([] { LOG_INFO("resolution: scale {}, gpu {} ms", dynamic_resolution.scale(), dynamic_resolution.gpuTime()); });
+	}
+	if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+		transparency_divisor = transparency_divisor >= 4 ? 1 : transparency_divisor * 2;
+		LOG_DEBUG("pressed u button, transparency at 1/{} size", transparency_divisor);
+	}
+	if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+		LOG_INFO("pressed c button, {} allocations last frame, frame arena {} KB", last_frame_allocations, frame_arena.capacity() / 1024);
+	}
+	if (key == GLFW_KEY_Y && action == GLFW_PRESS) {
+		// measured again from here, for the other setting
+		LOG_INFO("pressed y button, input to swap {} ms (worst {} ms) with late latching = {}", camera_latch.latency(), camera_latch.worstLatency(), late_latch);
+		late_latch = !late_latch;
+		camera_latch.resetLatency();
+	}
+	if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+		weighted_transparency = !weighted_transparency;
+		LOG_DEBUG("pressed f button, weighted blended transparency = {}", weighted_transparency);
+	}
+	if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+		vsync = !vsync;
+		frame_pipeline.runOnRenderThread([] { glfwSwapInterval(vsync ? 1 : 0); });
+		LOG_DEBUG("pressed v button, vsync = {}", vsync);
 	}
 	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
 		if (orbital) {
@@ -1120,23 +2244,23 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		else {
 			orbital = true;
 		}
-		cout << "pressed o button, orbital = " << orbital << endl;
+		LOG_DEBUG("pressed o button, orbital = {}", orbital);
 	}
 	if (key == GLFW_KEY_I && action == GLFW_PRESS) {
 		earthZ += -0.25f;
-		cout << "pressed i button, earthZ = " << earthZ << endl;
+		LOG_DEBUG("pressed i button, earthZ = {}", earthZ);
 	}
 	if (key == GLFW_KEY_K && action == GLFW_PRESS) {
 		earthZ += 0.25f;
-		cout << "pressed k button, earthZ = " << earthZ << endl;
+		LOG_DEBUG("pressed k button, earthZ = {}", earthZ);
 	}
 	if (key == GLFW_KEY_J && action == GLFW_PRESS) {
 		earthX += -0.25f;
-		cout << "pressed j button, earthX = " << earthX << endl;
+		LOG_DEBUG("pressed j button, earthX = {}", earthX);
 	}
 	if (key == GLFW_KEY_L && action == GLFW_PRESS) {
 		earthX += 0.25f;
-		cout << "pressed l button, earthX = " << earthX << endl;
+		LOG_DEBUG("pressed l button, earthX = {}", earthX);
 	}
 }
 
@@ -1145,7 +2269,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 // ------------------------------------------------------------------------------------------
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
-        cout << "Left mouse down at" << mouse_x << ", " << mouse_y << endl;
+        LOG_DEBUG("Left mouse down at{}, {}", mouse_x, mouse_y);
 		//xAxis = (mouse_x - 255) / 256.0f;
 		//yAxis = -(mouse_y - 255) / 256.0f;
 		// ^ old code about clicking to screen to move objects to that position
@@ -1183,16 +2307,27 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 		if (camera_pitch < -89.0f)
 			camera_pitch = -89.0f;
 
-		cameraTarget = glm::normalize(
-			vec3(
-				cos(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch)),
-				sin(glm::radians(camera_pitch)),
-				sin(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch))
-			)
-		);
+		updateCameraDirection();
 	}
 }
 
+// ------------------------------------------------------------------------------------------
+// This function points the fps camera along camera_yaw / camera_pitch, right away so the frame
+// recorded next and the late latch both see it
+// ------------------------------------------------------------------------------------------
+void updateCameraDirection()
+{
+	cameraTarget = glm::normalize(
+		vec3(
+			cos(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch)),
+			sin(glm::radians(camera_pitch)),
+			sin(glm::radians(camera_yaw)) * cos(glm::radians(camera_pitch))
+		)
+	);
+
+	cameraRight = glm::normalize(glm::cross(cameraTarget, cameraUp));
+}
+
 // ------------------------------------------------------------------------------------------
 // This function is called every time the mouse is scrolled
 // ------------------------------------------------------------------------------------------
@@ -1203,23 +2338,51 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 		fov = 20.0f;
 	if (fov > 160.0f)
 		fov = 160.0f;
-	cout << "fov = " << fov << endl;
+	LOG_DEBUG("fov = {}", fov);
 }
 
-int main(void)
+// ------------------------------------------------------------------------------------------
+// This function is called every time the window's framebuffer is resized, in pixels
+// the next recorded frame picks the size up, 0 x 0 while minimized
+// ------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+	g_ViewportWidth = width;
+	g_ViewportHeight = height;
+}
+
+int main(int argc, char** argv)
+{
+	// log records are written out by their own thread from here on
+	startLogging();
+
+	// worker threads, the main and render threads take the remaining cores
+	jobs.start(JobSystem::defaultWorkerCount());
+
+	// scaling benchmark of the per-frame workloads over 1..N threads, no window needed
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--bench-jobs") {
+			bool allocation_free = runJobBenchmark(std::thread::hardware_concurrency());
+			jobs.stop();
+			stopLogging();
+			return allocation_free ? 0 : 1;
+		}
+	}
+
 	//setup window and other stuff, defined in glfunctions.cpp
 	GLFWwindow* window;
-	if (!glfwInit())return -1;
+	if (!glfwInit()) {stopLogging(); return -1;}
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	window = glfwCreateWindow(g_ViewportWidth, g_ViewportHeight, "Hello OpenGL!", NULL, NULL);
-	if (!window) {glfwTerminate();	return -1;}
+	if (!window) {glfwTerminate(); stopLogging(); return -1;}
 	glfwMakeContextCurrent(window);
 	glewExperimental = GL_TRUE;
 	glewInit();
+	glfwSwapInterval(vsync ? 1 : 0);
+	g_window = window;
 
 	//input callbacks
 	glfwSetKeyCallback(window, key_callback);
@@ -1229,28 +2392,56 @@ int main(void)
 	glfwSetScrollCallback(window, scroll_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 
+	// in pixels, not the window's screen coordinates (they differ on high-dpi displays)
+	glfwGetFramebufferSize(window, &g_ViewportWidth, &g_ViewportHeight);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
 	glClearColor(g_backgroundColor.x, g_backgroundColor.y, g_backgroundColor.z, 1.0f);
 
+	// the render thread owns the context from here on
+	glfwMakeContextCurrent(NULL);
+	frame_pipeline.start(window, draw, presentFrame);
+
 	//load all the resources
-	load();
+	frame_pipeline.runOnRenderThread(createStreamBuffers);
+	frame_pipeline.runOnRenderThread(load);
+	lastTime = glfwGetTime();
+	updateCameraDirection();
 
     // Loop until the user closes the window
     while (!glfwWindowShouldClose(window))
     {
-		draw();
+		AllocationScope frame_allocations;
+
+		// fixed-step simulation, then record a frame in between the last two steps
+		advanceSimulation();
 
-        // Swap front and back buffers
-        glfwSwapBuffers(window);
+		// recording frame N+1 here overlaps with the render thread drawing and swapping frame N
+		buildFrame(frame_pipeline.beginFrame());
+		frame_pipeline.submitFrame();
         
         // Poll for and process events
         glfwPollEvents();
         
         //mouse position must be tracked constantly (callbacks do not give accurate delta)
         glfwGetCursorPos(window, &mouse_x, &mouse_y);
+
+		// the direction just polled, for the render thread to turn the frame it draws next to
+		input_time = glfwGetTime();
+		CameraSample sample;
+		sample.forward = cameraTarget;
+		sample.input_time = input_time;
+		camera_latch.publish(sample);
+
+		last_frame_allocations = frame_allocations.count();
     }
 
-    //terminate glfw and exit
+    //finish the frame in flight, then terminate glfw and exit
+	frame_pipeline.runOnRenderThread(destroyStreamBuffers);
+	frame_pipeline.stop();
+	jobs.stop();
     glfwTerminate();
+	stopLogging();
     return 0;
 }
 
@@ -4,24 +4,67 @@ in vec3 v_vertex;
 in vec3 v_color;
 in vec2 v_uv;
 in vec3 v_normal;
+flat in int v_draw;
 
-out vec4 fragColor;
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec4 oitWeight;	// weighted blending only, alpha * weight summed in r
 
 uniform vec3 u_color;
-uniform sampler2D u_texture;
-uniform sampler2D u_texture_normal;
-uniform sampler2D u_texture_spec;
-uniform sampler2D u_texture_night;
-uniform bool u_has_multitextures;
-
-uniform vec3 u_light;
-uniform float u_light_intensity;
-uniform vec3 u_cam_pos;
-uniform vec3 u_ambient;
-uniform vec3 u_diffuse;
-uniform vec3 u_specular;
-uniform float u_shininess;
-uniform float u_alpha;
+uniform sampler2D u_texture;				// skybox
+uniform sampler2DArray u_texture_array;		// every other texture, one layer each
+
+// per-frame values, streamed once per frame
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;			// what the light grid was binned with, u_view may be latched later
+	mat4 u_cluster_projection;
+};
+
+// per-draw values, streamed into a ring buffer in pages of DRAW_SLOTS draws
+// a draw finds its slot through a_draw_id (its base instance) plus u_draw_offset
+#define DRAW_SLOTS 64
+
+struct DrawBlock {
+	mat4 model;
+	mat3 normal_matrix;	// inverse-transpose of model, computed on the cpu
+	vec3 ambient;
+	float shininess;
+	vec3 diffuse;
+	float alpha;
+	vec3 specular;
+	bool has_multitextures;
+	ivec4 layers;		// texture array layers: albedo, normal, specular, night; albedo -1 = skybox
+};
+
+layout(std140) uniform DrawData {
+	DrawBlock u_draws[DRAW_SLOTS];
+};
+
+// point lights, binned per froxel on the cpu (LightGrid) so a fragment only loops over the lights
+// of its own cluster; same grid size as LIGHT_GRID_X / Y / Z there
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 16
+#define LIGHT_GRID_Z 24
+
+uniform samplerBuffer u_lights;				// two texels per light: position, radius / color, intensity
+uniform usamplerBuffer u_light_clusters;	// first index, count per cluster
+uniform usamplerBuffer u_light_indices;
+uniform ivec3 u_light_base;					// this frame's first texel in each of the three
+uniform int u_light_count;					// 0 when there are no lights this frame
+uniform vec4 u_light_slicing;				// slice = (log) view depth * x + y, z = 1 for log
+
+// weighted blended transparency: fragments are accumulated in any order instead of blended over
+// each other, nearer ones weighted more (McGuire and Bavoil 2013, eq. 9)
+uniform bool u_weighted_blend;
+
+float oitWeightAt(float distance, float alpha)
+{
+	return alpha * clamp(10.0 / (1e-5 + pow(distance / 5.0, 2.0) + pow(distance / 200.0, 6.0)), 1e-2, 3e3);
+}
 
 mat3 cotangent_frame(vec3 N, vec3 p, vec2 uv)
 {
@@ -51,15 +94,61 @@ vec3 perturbNormal( vec3 N, vec3 V, vec2 texcoord, vec3 normal_pixel )
 	return normalize(TBN * normal_pixel);
 }
 
+// blinn-phong of the cluster's point lights, with a falloff to zero at each light's radius
+vec3 pointLights(vec3 normal, vec3 eye, vec3 diffuse_color, vec3 specular_color, float shininess)
+{
+	vec3 total = vec3(0.0);
+	if (u_light_count == 0)
+		return total;
+
+	// the cluster is looked up the way the lights were binned, not with the latched view
+	vec4 view_position = u_cluster_view * vec4(v_vertex, 1.0);
+	vec4 clip = u_cluster_projection * view_position;
+	vec2 tile = (clip.xy / clip.w * 0.5 + 0.5) * vec2(LIGHT_GRID_X, LIGHT_GRID_Y);
+	float depth = u_light_slicing.z > 0.5 ? log(max(-view_position.z, 1e-4)) : -view_position.z;
+	ivec3 cell = clamp(ivec3(floor(vec3(tile, depth * u_light_slicing.x + u_light_slicing.y))), ivec3(0), ivec3(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1, LIGHT_GRID_Z - 1));
+
+	int cluster = (cell.z * LIGHT_GRID_Y + cell.y) * LIGHT_GRID_X + cell.x;
+	uvec2 range = texelFetch(u_light_clusters, u_light_base.y + cluster).xy;
+	for (uint i = 0u; i < range.y; i++) {
+		int light = u_light_base.x + 2 * int(texelFetch(u_light_indices, u_light_base.z + int(range.x + i)).r);
+		vec4 sphere = texelFetch(u_lights, light);
+		vec4 color = texelFetch(u_lights, light + 1);
+
+		vec3 to_light = sphere.xyz - v_vertex;
+		float light_distance = length(to_light);
+		if (light_distance >= sphere.w)
+			continue;
+
+		float falloff = 1.0 - light_distance / sphere.w;
+		falloff *= falloff;
+
+		vec3 light_dir = to_light / light_distance;
+		float n_dot_l = max(dot(normal, light_dir), 0.0f);
+		float n_dot_h = max(dot(normal, normalize(light_dir + eye)), 0.0f);
+		total += (diffuse_color * n_dot_l + specular_color * pow(n_dot_h, shininess)) * color.rgb * color.a * falloff;
+	}
+	return total;
+}
+
+vec4 sampleLayer(int layer)
+{
+	if (layer < 0)
+		return texture(u_texture, v_uv);
+	return texture(u_texture_array, vec3(v_uv, layer));
+}
+
 void main(void)
 {
+	DrawBlock d = u_draws[v_draw];
+
 	vec3 normal;
 	vec3 texture_normal;
 	vec3 texture_spec;
 	vec3 texture_night;
 
-	if(u_has_multitextures) {
-		texture_normal = texture(u_texture_normal, v_uv).xyz;
+	if(d.has_multitextures) {
+		texture_normal = sampleLayer(d.layers.y).xyz;
 		vec3 N = normalize(v_normal);
 		vec3 N_orig = N;   // original normal
 		// call function to modify normal
@@ -67,58 +156,71 @@ void main(void)
 		// mix original normal with new normal
 		N = mix(N_orig, N, 2.0f);
 
-		texture_spec = texture(u_texture_spec, v_uv).xyz;
-		texture_night = texture(u_texture_night, v_uv).xyz;
+		texture_spec = sampleLayer(d.layers.z).xyz;
+		texture_night = sampleLayer(d.layers.w).xyz;
 
 		normal = N;
 	}
 
 	// material color
-	vec3 material = texture(u_texture, v_uv).rgb;
+	vec3 material = sampleLayer(d.layers.x).rgb;
 
 	// ambient
-	vec3 ambient = material * u_ambient * u_light_intensity;
+	vec3 ambient = material * d.ambient * u_light_intensity;
 
 	// diffuse
-	if(!u_has_multitextures) {
+	if(!d.has_multitextures) {
 		normal = normalize(v_normal);
 	}
 	
 	vec3 light = normalize(u_light - v_vertex);
 	float n_dot_l = max(dot(normal, light), 0.0f);
-	vec3 diffuse = material * n_dot_l * u_diffuse * u_light_intensity;
+	vec3 diffuse = material * n_dot_l * d.diffuse * u_light_intensity;
 
 	// specular (phong)
 	vec3 reflection = normalize(-reflect(light, normal));
 	vec3 eye = normalize(u_cam_pos - v_vertex);			// view, sometimes v (r_dot_v)
 	float r_dot_e = max(dot(reflection, eye), 0.0f);
-	vec3 specular = material * pow(r_dot_e, u_shininess) * u_specular * u_light_intensity;
+	vec3 specular = material * pow(r_dot_e, d.shininess) * d.specular * u_light_intensity;
 
 	// specular (blinn-phong)
 	vec3 half_vector = normalize(light + eye);			// half-vector between light-vector and eye-vector
 	float n_dot_h = max(dot(normal, half_vector), 0.0f);
-	vec3 specular_blinn = material * pow(n_dot_h, u_shininess) * u_specular * u_light_intensity;
+	vec3 specular_blinn = material * pow(n_dot_h, d.shininess) * d.specular * u_light_intensity;
 
-	if(!u_has_multitextures) {
+	if(!d.has_multitextures) {
 		texture_spec = vec3(1.0, 1.0, 1.0);
 	}
 	// blinn-phong
 	vec3 final_color = ambient + diffuse + specular_blinn * texture_spec;
 	// replace specular_blinn with specular for phong reflectance equation
 
-	if(n_dot_l < 0.001 && u_has_multitextures) {
+	if(n_dot_l < 0.001 && d.has_multitextures) {
 		final_color = texture_night;
 	}
 
-	fragColor = vec4(final_color, u_alpha);
+	// point lights on top, night side included (not for the skybox and alpha maps, overwritten below)
+	if(d.alpha != -1.0f) {
+		final_color += pointLights(normal, eye, material * d.diffuse, material * d.specular * texture_spec, d.shininess);
+	}
+
+	fragColor = vec4(final_color, d.alpha);
 
 	// special case of alpha map and skybox
-	if(u_alpha == -1.0f) {
-		fragColor = texture(u_texture, v_uv);
+	if(d.alpha == -1.0f) {
+		fragColor = sampleLayer(d.layers.x);
+	}
+
+	// premultiplied and weighted into the accumulation target; alpha multiplies into its revealage
+	// through the blend function, the weights sum in the second target
+	if (u_weighted_blend) {
+		float weight = oitWeightAt(length(u_cam_pos - v_vertex), fragColor.a);
+		fragColor = vec4(fragColor.rgb * weight, fragColor.a);
+		oitWeight = vec4(weight);
 	}
 
 	// TEST CODES
-	//fragColor = vec4(texture(u_texture, v_uv).rgb, 1.0);
+	//fragColor = vec4(sampleLayer(d.layers.x).rgb, 1.0);
 	//fragColor = vec4(v_uv, 0.0f, 1.0f);
 
 }
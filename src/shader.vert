@@ -4,26 +4,62 @@ in vec3 a_vertex;
 in vec3 a_color;
 in vec2 a_uv;
 in vec3 a_normal;
+in uint a_draw_id;		// instanced, 0 on the non-indirect path
 
 out vec3 v_vertex;
 out vec3 v_color;
 out vec2 v_uv;
 out vec3 v_normal;
+flat out int v_draw;
 
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_projection;
+// the depth pre-pass computes the same position; this keeps both bit-identical for GL_EQUAL
+invariant gl_Position;
+
+uniform int u_draw_offset;	// slot of the draw on the non-indirect path, 0 otherwise
+
+// per-frame values, streamed once per frame
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
+
+// per-draw values, streamed into a ring buffer in pages of DRAW_SLOTS draws
+// a draw finds its slot through a_draw_id (its base instance) plus u_draw_offset
+#define DRAW_SLOTS 64
+
+struct DrawBlock {
+	mat4 model;
+	mat3 normal_matrix;	// inverse-transpose of model, computed on the cpu
+	vec3 ambient;
+	float shininess;
+	vec3 diffuse;
+	float alpha;
+	vec3 specular;
+	bool has_multitextures;
+	ivec4 layers;		// texture array layers: albedo, normal, specular, night; albedo -1 = skybox
+};
+
+layout(std140) uniform DrawData {
+	DrawBlock u_draws[DRAW_SLOTS];
+};
 
 void main()
 {
-	// translate vertex position using u_model transform matrix: 4x4 * 4x1 matrix operation
-	gl_Position = u_projection * u_view * u_model * vec4( a_vertex , 1.0 );
+	v_draw = u_draw_offset + int(a_draw_id);
+	mat4 model = u_draws[v_draw].model;
+
+	// translate vertex position using model transform matrix: 4x4 * 4x1 matrix operation
+	gl_Position = u_projection * u_view * model * vec4( a_vertex , 1.0 );
 	// M V P - but here it's the opposite since it's multiplied right to left
 
-	mat4 normal_matrix = transpose(inverse(u_model));
-	v_normal = (normal_matrix * vec4(a_normal, 1.0)).xyz;
+	v_normal = u_draws[v_draw].normal_matrix * a_normal;
 
-	v_vertex = (u_model * vec4(a_vertex, 1.0)).xyz;
+	v_vertex = (model * vec4(a_vertex, 1.0)).xyz;
 
 	// pass the colour to the fragment shader
 	v_color = a_color;
@@ -0,0 +1,45 @@
+#version 330
+
+// depth pre-pass: position only, the same expression as shader.vert so GL_EQUAL matches
+// exactly; also draws the overdraw view with shader_overdraw.frag
+
+in vec3 a_vertex;
+in uint a_draw_id;		// instanced, 0 on the non-indirect path
+
+invariant gl_Position;
+
+uniform int u_draw_offset;	// slot of the draw on the non-indirect path, 0 otherwise
+
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
+
+#define DRAW_SLOTS 64
+
+struct DrawBlock {
+	mat4 model;
+	mat3 normal_matrix;
+	vec3 ambient;
+	float shininess;
+	vec3 diffuse;
+	float alpha;
+	vec3 specular;
+	bool has_multitextures;
+	ivec4 layers;
+};
+
+layout(std140) uniform DrawData {
+	DrawBlock u_draws[DRAW_SLOTS];
+};
+
+void main()
+{
+	mat4 model = u_draws[u_draw_offset + int(a_draw_id)].model;
+	gl_Position = u_projection * u_view * model * vec4( a_vertex , 1.0 );
+}
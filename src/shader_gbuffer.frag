@@ -0,0 +1,109 @@
+#version 330
+
+// geometry pass of the deferred path (with shader.vert): the material terms shader.frag lights,
+// written to the G-buffer instead, deferred_sun.frag and deferred_light.frag light them per pixel
+
+in vec3 v_vertex;
+in vec3 v_color;
+in vec2 v_uv;
+in vec3 v_normal;
+flat in int v_draw;
+
+layout(location = 0) out vec4 g_diffuse;	// material * diffuse
+layout(location = 1) out vec4 g_normal;		// world normal, shininess
+layout(location = 2) out vec4 g_specular;	// material * specular * specular map
+layout(location = 3) out vec4 g_emissive;	// material * ambient, or the night map with a = 1
+
+uniform sampler2D u_texture;				// skybox
+uniform sampler2DArray u_texture_array;		// every other texture, one layer each
+
+// per-frame values, streamed once per frame (same layout as in shader.frag)
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
+
+#define DRAW_SLOTS 64
+
+struct DrawBlock {
+	mat4 model;
+	mat3 normal_matrix;	// inverse-transpose of model, computed on the cpu
+	vec3 ambient;
+	float shininess;
+	vec3 diffuse;
+	float alpha;
+	vec3 specular;
+	bool has_multitextures;
+	ivec4 layers;		// texture array layers: albedo, normal, specular, night; albedo -1 = skybox
+};
+
+layout(std140) uniform DrawData {
+	DrawBlock u_draws[DRAW_SLOTS];
+};
+
+mat3 cotangent_frame(vec3 N, vec3 p, vec2 uv)
+{
+	// get edge vectors of the pixel triangle
+	vec3 dp1 = dFdx( p );
+	vec3 dp2 = dFdy( p );
+	vec2 duv1 = dFdx( uv );
+	vec2 duv2 = dFdy( uv );
+	// solve the linear system
+	vec3 dp2perp = cross( dp2, N );
+	vec3 dp1perp = cross( N, dp1 );
+	vec3 T = dp2perp * duv1.x + dp1perp * duv2.x;
+	vec3 B = dp2perp * duv1.y + dp1perp * duv2.y;
+
+	// construct a scale-invariant frame
+	float invmax = inversesqrt( max( dot(T,T), dot(B,B) ) );
+	return mat3( T * invmax, B * invmax, N );
+}
+
+vec3 perturbNormal( vec3 N, vec3 V, vec2 texcoord, vec3 normal_pixel )
+{
+	normal_pixel = normal_pixel * 2.0 - 1.0;
+	mat3 TBN = cotangent_frame(N, V, texcoord);
+	return normalize(TBN * normal_pixel);
+}
+
+vec4 sampleLayer(int layer)
+{
+	if (layer < 0)
+		return texture(u_texture, v_uv);
+	return texture(u_texture_array, vec3(v_uv, layer));
+}
+
+void main(void)
+{
+	DrawBlock d = u_draws[v_draw];
+
+	vec3 normal = normalize(v_normal);
+	vec3 texture_spec = vec3(1.0, 1.0, 1.0);
+
+	// multi-texturing, same as shader.frag
+	if(d.has_multitextures) {
+		vec3 N = perturbNormal(normal, v_vertex, v_uv, sampleLayer(d.layers.y).xyz);
+		normal = mix(normal, N, 2.0f);
+		texture_spec = sampleLayer(d.layers.z).xyz;
+	}
+
+	// material color
+	vec3 material = sampleLayer(d.layers.x).rgb;
+
+	g_diffuse = vec4(material * d.diffuse, 1.0);
+	g_normal = vec4(normalize(normal), d.shininess);
+	g_specular = vec4(material * d.specular * texture_spec, 1.0);
+
+	// the night map replaces all lighting where the scene light doesn't reach; decided here so
+	// one target holds either it or the ambient color
+	float n_dot_l = dot(normal, normalize(u_light - v_vertex));
+	if(d.has_multitextures && n_dot_l < 0.001)
+		g_emissive = vec4(sampleLayer(d.layers.w).rgb, 1.0);
+	else
+		g_emissive = vec4(material * d.ambient, 0.0);
+}
@@ -0,0 +1,11 @@
+#version 330
+
+// overdraw view: every fragment that passes the depth test adds the same amount, blended
+// GL_ONE, GL_ONE, so brightness counts the times a pixel was shaded
+
+out vec4 fragColor;
+
+void main()
+{
+	fragColor = vec4(0.15, 0.06, 0.02, 1.0);
+}
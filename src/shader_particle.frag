@@ -1,14 +1,30 @@
-#version 330 core
+#version 330
 
-in vec2 tex_coords;
-in vec4 particle_color;
+in vec4 v_color;
+in float v_distance;
 
-out vec4 color;
+layout(location = 0) out vec4 color;
+layout(location = 1) out vec4 oitWeight;	// weighted blending only, as in shader.frag
 
-uniform sampler2D sprite;
+uniform bool u_weighted_blend;
+
+float oitWeightAt(float distance, float alpha)
+{
+	return alpha * clamp(10.0 / (1e-5 + pow(distance / 5.0, 2.0) + pow(distance / 200.0, 6.0)), 1e-2, 3e3);
+}
 
 void main() {
 
-	color = particle_color;
+	// round stars instead of squares
+	if (length(gl_PointCoord - vec2(0.5)) > 0.5)
+		discard;
+
+	color = v_color;
+
+	if (u_weighted_blend) {
+		float weight = oitWeightAt(v_distance, color.a);
+		color = vec4(color.rgb * weight, color.a);
+		oitWeight = vec4(weight);
+	}
 
 }
@@ -1,21 +1,29 @@
-#version 330 core
+#version 330
 
-layout (location = 0) in vec4 vertex;
-// vec position, vec2 tex_coords
+in vec3 a_position;
+in float a_size;
+in vec4 a_color;
 
-out vec2 tex_coords;
-out vec4 particle_color;
+out vec4 v_color;
+out float v_distance;	// from the camera, for weighted blending
 
-uniform mat4 projection;
-uniform vec2 offset;
-uniform vec4 color;
+uniform float u_point_scale;	// scene target size over the window's
+
+// per-frame values, streamed once per frame (same layout as in shader.vert)
+layout(std140) uniform FrameData {
+	mat4 u_view;
+	mat4 u_projection;
+	vec3 u_light;
+	float u_light_intensity;
+	vec3 u_cam_pos;
+	mat4 u_cluster_view;
+	mat4 u_cluster_projection;
+};
 
 void main()
 {
-	float scale = 10.0f;
-	tex_coords = vertex.zw;
-	particle_color = color;
-	gl_Position = vec4((vertex.xy * scale) + offset, 0.0, 1.0);
-	//gl_Position = projection * vec4((vertex.xy * scale) + offset, 0.0, 1.0);
+	gl_Position = u_projection * u_view * vec4(a_position, 1.0);
+	gl_PointSize = a_size * 10.0 * u_point_scale;	// scale size for visibility
+	v_color = a_color;
+	v_distance = gl_Position.w;
 }
-
@@ -0,0 +1,20 @@
+#version 330
+
+// cube map sky for the pixels no geometry covered, looked up along the view ray through the pixel
+
+in vec2 v_ndc;
+
+out vec4 fragColor;
+
+uniform samplerCube u_skybox;
+uniform mat4 u_inverse_view_projection;
+
+void main(void)
+{
+	// near and far points of the ray, so orthographic projections work too
+	vec4 near_point = u_inverse_view_projection * vec4(v_ndc, -1.0, 1.0);
+	vec4 far_point = u_inverse_view_projection * vec4(v_ndc, 1.0, 1.0);
+	vec3 direction = far_point.xyz / far_point.w - near_point.xyz / near_point.w;
+
+	fragColor = vec4(texture(u_skybox, direction).rgb, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 330
+
+// full-screen triangle on the far plane (depth 1, drawn with GL_LEQUAL), no vertex buffer
+
+out vec2 v_ndc;
+
+void main()
+{
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	v_ndc = position;
+	gl_Position = vec4(position, 1.0, 1.0);
+}
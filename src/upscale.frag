@@ -0,0 +1,28 @@
+#version 330
+
+// scene target up to the window: bilinear, then sharpened against the four neighbouring source
+// texels (an unsharp mask, clamped to their range so edges don't ring); drawn with hiz.vert
+
+uniform sampler2D u_scene;
+uniform vec2 u_output_size;	// window size in pixels
+uniform float u_sharpness;	// 0 = plain bilinear
+
+out vec4 fragColor;
+
+void main()
+{
+	vec2 uv = gl_FragCoord.xy / u_output_size;
+	vec2 texel = 1.0 / vec2(textureSize(u_scene, 0));
+
+	vec3 center = texture(u_scene, uv).rgb;
+	vec3 left = texture(u_scene, uv - vec2(texel.x, 0.0)).rgb;
+	vec3 right = texture(u_scene, uv + vec2(texel.x, 0.0)).rgb;
+	vec3 down = texture(u_scene, uv - vec2(0.0, texel.y)).rgb;
+	vec3 up = texture(u_scene, uv + vec2(0.0, texel.y)).rgb;
+
+	vec3 blur = (left + right + down + up) * 0.25;
+	vec3 low = min(center, min(min(left, right), min(down, up)));
+	vec3 high = max(center, max(max(left, right), max(down, up)));
+
+	fragColor = vec4(clamp(center + (center - blur) * u_sharpness, low, high), 1.0);
+}